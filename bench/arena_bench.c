@@ -0,0 +1,543 @@
+/*
+ * Benchmarks for nu_arena
+ *
+ * Compares nu_arena against general-purpose allocators on the allocation
+ * patterns arenas are meant for:
+ *
+ *   - small_allocs: many small allocations of one size, then all released
+ *   - aligned_allocs: mixed sizes at mixed alignments up to the swept
+ *     maximum, through nu_arena_alloc_aligned and aligned_alloc
+ *   - mark_restore: scopes of short-lived temporaries, released with
+ *     nu_arena_restore or freed in reverse order
+ *   - request_churn: per-request allocations of mixed sizes released all
+ *     at once at the end of each request, with nu_arena_reset or free
+ *   - fragmentation: long- and short-lived objects interleaved, the short
+ *     ones freed, then larger objects allocated that cannot reuse the
+ *     holes; the arena keeps the two lifetimes in separate arenas
+ *   - mt_alloc_*: independent per-thread allocate/release cycles on 1..N
+ *     threads, each thread with its own arena
+ *
+ * Each pattern is an A/B group with glibc (the system) malloc as the
+ * baseline. jemalloc and mimalloc are added as further variants when their
+ * shared libraries can be loaded with dlopen, so no build dependency is
+ * needed; they are used only through the pointers resolved from their own
+ * libraries, so the process allocator is unaffected. System malloc is
+ * called past nu/bench's allocation counting wrappers and every allocator
+ * is counted here instead, with nu_bench_record_alloc and its own usable
+ * size, so all of them are timed and reported (--allocs) the same way.
+ *
+ * Release is part of every timed region: free for the allocators, and the
+ * reset or restore for the arena. Every allocation's first byte is written
+ * so allocators that defer work to first touch are not flattered.
+ */
+
+#include <nu/bench.h>
+#include <dlfcn.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/arena.h"
+
+#ifdef NU_BENCH_WRAP_MALLOC
+#define system_malloc __real_malloc
+#define system_free __real_free
+#else
+#define system_malloc malloc
+#define system_free free
+#endif
+
+/* A general-purpose allocator under test; malloc is NULL when not loaded */
+typedef struct {
+  const char* name;
+  void* (*malloc)(size_t size);
+  void (*free)(void* ptr);
+  void* (*aligned_alloc)(size_t alignment, size_t size);
+  size_t (*usable_size)(void* ptr);
+} allocator_t;
+
+enum { SYSTEM, JEMALLOC, MIMALLOC, ALLOCATOR_COUNT };
+
+static allocator_t allocators[ALLOCATOR_COUNT] = {
+  [SYSTEM]   = {"malloc", NULL, NULL, NULL, NULL},
+  [JEMALLOC] = {"jemalloc", NULL, NULL, NULL, NULL},
+  [MIMALLOC] = {"mimalloc", NULL, NULL, NULL, NULL},
+};
+
+/* Resolve a symbol from a loaded library as a function pointer */
+static bool
+load_symbol(void* library, const char* name, void* fn, size_t size) {
+  void* symbol = dlsym(library, name);
+  if (!symbol) {
+    return false;
+  }
+  memcpy(fn, &symbol, size);
+  return true;
+}
+
+/* Load an allocator from the first of `libraries` that opens and exports
+ * all four functions; leaves it unloaded otherwise */
+static void
+load_allocator(allocator_t* a, const char* const* libraries, const char* malloc_name,
+               const char* free_name, const char* aligned_name, const char* usable_name) {
+  for (; *libraries; libraries++) {
+    void* library = dlopen(*libraries, RTLD_NOW | RTLD_LOCAL);
+    if (!library) {
+      continue;
+    }
+    if (load_symbol(library, malloc_name, &a->malloc, sizeof(a->malloc)) &&
+        load_symbol(library, free_name, &a->free, sizeof(a->free)) &&
+        load_symbol(library, aligned_name, &a->aligned_alloc, sizeof(a->aligned_alloc)) &&
+        load_symbol(library, usable_name, &a->usable_size, sizeof(a->usable_size))) {
+      return;
+    }
+    a->malloc = NULL;
+    dlclose(library);
+  }
+}
+
+static void
+allocation_failed(const char* name) {
+  fprintf(stderr, "%s: allocation failed\n", name);
+  exit(1);
+}
+
+/* Deterministic pseudo-random size in [low, high] for the i-th object */
+static inline size_t
+size_for(size_t i, size_t low, size_t high) {
+  uint32_t mixed = ((uint32_t)i * 2654435761u) >> 8;
+  return low + mixed % (high - low + 1);
+}
+
+/* Allocate and touch an object */
+static inline void*
+allocate(const allocator_t* a, size_t size) {
+  char* ptr = a->malloc(size);
+  if (!ptr) {
+    allocation_failed(a->name);
+  }
+  if (nu_bench_counting_allocs()) {
+    nu_bench_record_alloc(size, a->usable_size(ptr));
+  }
+  ptr[0] = (char)size;
+  return ptr;
+}
+
+/* Allocate and touch an object at `alignment` */
+static inline void*
+allocate_aligned(const allocator_t* a, size_t alignment, size_t size) {
+  char* ptr = a->aligned_alloc(alignment, size);
+  if (!ptr) {
+    allocation_failed(a->name);
+  }
+  if (nu_bench_counting_allocs()) {
+    nu_bench_record_alloc(size, a->usable_size(ptr));
+  }
+  ptr[0] = (char)size;
+  return ptr;
+}
+
+static inline void
+release(const allocator_t* a, void* ptr) {
+  if (nu_bench_counting_allocs()) {
+    nu_bench_record_free(a->usable_size(ptr));
+  }
+  a->free(ptr);
+}
+
+static inline void*
+arena_allocate(nu_arena* arena, size_t size) {
+  char* ptr = nu_arena_alloc(arena, size);
+  if (!ptr) {
+    allocation_failed("nu_arena");
+  }
+  ptr[0] = (char)size;
+  return ptr;
+}
+
+/* Backing memory for the single-threaded arenas, grown to the largest
+ * need of any group and kept for the rest of the run */
+static struct {
+  char* data;
+  size_t size;
+} arena_memory;
+
+static nu_arena arena;
+static nu_arena scratch;
+
+/* Make sure `size` bytes of arena memory exist; split between the main
+ * arena and, when `scratch_size` is nonzero, the scratch arena */
+static void
+arenas_prepare(size_t size, size_t scratch_size) {
+  if (arena_memory.size < size + scratch_size) {
+    free(arena_memory.data);
+    arena_memory.size = size + scratch_size;
+    arena_memory.data = malloc(arena_memory.size);
+    if (!arena_memory.data) {
+      allocation_failed("arena memory");
+    }
+    memset(arena_memory.data, 0, arena_memory.size);
+  }
+  nu_arena_init(&arena, arena_memory.data, size);
+  if (scratch_size) {
+    nu_arena_init(&scratch, arena_memory.data + size, scratch_size);
+  }
+}
+
+/* Object pointers kept by the allocator variants */
+#define MAX_SLOTS (3 << 14)
+static void* slots[MAX_SLOTS];
+
+/* Define the allocator variants of a group, each running group##_run */
+#define ALLOCATOR_VARIANTS(group) \
+        static void group##_malloc(int64_t param) { group##_run(&allocators[SYSTEM], param); } \
+        static void group##_jemalloc(int64_t param) { group##_run(&allocators[JEMALLOC], param); } \
+        static void group##_mimalloc(int64_t param) { group##_run(&allocators[MIMALLOC], param); }
+
+/* Pattern: SMALL_COUNT allocations of `param` bytes, then all released */
+#define SMALL_COUNT 1024
+
+NU_BENCH_GROUP(small_allocs, NU_BENCH_VALUES(8, 32, 128, 512)) {
+  arenas_prepare(SMALL_COUNT * (size_t)param, 0);
+}
+
+NU_BENCH_VARIANT(small_allocs, arena) {
+  size_t size = (size_t)param;
+  nu_bench_set_items(SMALL_COUNT);
+  NU_BENCH_START();
+  for (size_t i = 0; i < SMALL_COUNT; i++) {
+    slots[i] = arena_allocate(&arena, size);
+  }
+  nu_arena_reset(&arena);
+  NU_BENCH_END();
+  nu_bench_do_not_optimize(slots);
+}
+
+static void
+small_allocs_run(const allocator_t* a, int64_t param) {
+  size_t size = (size_t)param;
+  nu_bench_set_items(SMALL_COUNT);
+  NU_BENCH_START();
+  for (size_t i = 0; i < SMALL_COUNT; i++) {
+    slots[i] = allocate(a, size);
+  }
+  for (size_t i = 0; i < SMALL_COUNT; i++) {
+    release(a, slots[i]);
+  }
+  NU_BENCH_END();
+}
+
+ALLOCATOR_VARIANTS(small_allocs)
+
+/* Pattern: ALIGNED_COUNT allocations of 8-256 bytes, cycling through the
+ * power-of-two alignments from 8 up to `param` */
+#define ALIGNED_COUNT 256
+
+static inline size_t
+alignment_for(size_t i, size_t max_alignment) {
+  size_t classes = 1;
+  while ((size_t)8 << classes <= max_alignment) {
+    classes++;
+  }
+  return (size_t)8 << (i % classes);
+}
+
+NU_BENCH_GROUP(aligned_allocs, NU_BENCH_VALUES(16, 64, 4096)) {
+  arenas_prepare(ALIGNED_COUNT * (256 + (size_t)param), 0);
+}
+
+NU_BENCH_VARIANT(aligned_allocs, arena) {
+  nu_bench_set_items(ALIGNED_COUNT);
+  NU_BENCH_START();
+  for (size_t i = 0; i < ALIGNED_COUNT; i++) {
+    size_t size = size_for(i, 8, 256);
+    char* ptr   = nu_arena_alloc_aligned(&arena, size, alignment_for(i, (size_t)param));
+    if (!ptr) {
+      allocation_failed("nu_arena");
+    }
+    ptr[0]   = (char)size;
+    slots[i] = ptr;
+  }
+  nu_arena_reset(&arena);
+  NU_BENCH_END();
+  nu_bench_do_not_optimize(slots);
+}
+
+static void
+aligned_allocs_run(const allocator_t* a, int64_t param) {
+  nu_bench_set_items(ALIGNED_COUNT);
+  NU_BENCH_START();
+  for (size_t i = 0; i < ALIGNED_COUNT; i++) {
+    slots[i] = allocate_aligned(a, alignment_for(i, (size_t)param), size_for(i, 8, 256));
+  }
+  for (size_t i = 0; i < ALIGNED_COUNT; i++) {
+    release(a, slots[i]);
+  }
+  NU_BENCH_END();
+}
+
+ALLOCATOR_VARIANTS(aligned_allocs)
+
+/* Pattern: SCOPES scopes, each allocating `param` temporaries of 16-256
+ * bytes and releasing them on exit */
+#define SCOPES 64
+
+NU_BENCH_GROUP(mark_restore, NU_BENCH_VALUES(1, 8, 64)) {
+  arenas_prepare((size_t)param * 256, 0);
+}
+
+NU_BENCH_VARIANT(mark_restore, arena) {
+  size_t count = (size_t)param;
+  nu_bench_set_items(SCOPES * count);
+  NU_BENCH_START();
+  for (size_t s = 0; s < SCOPES; s++) {
+    nu_arena_mark mark = nu_arena_get_mark(&arena);
+    for (size_t i = 0; i < count; i++) {
+      slots[i] = arena_allocate(&arena, size_for(s + i, 16, 256));
+    }
+    nu_bench_do_not_optimize(slots);
+    nu_arena_restore(&arena, mark);
+  }
+  NU_BENCH_END();
+}
+
+static void
+mark_restore_run(const allocator_t* a, int64_t param) {
+  size_t count = (size_t)param;
+  nu_bench_set_items(SCOPES * count);
+  NU_BENCH_START();
+  for (size_t s = 0; s < SCOPES; s++) {
+    for (size_t i = 0; i < count; i++) {
+      slots[i] = allocate(a, size_for(s + i, 16, 256));
+    }
+    for (size_t i = count; i > 0; i--) {
+      release(a, slots[i - 1]);
+    }
+  }
+  NU_BENCH_END();
+}
+
+ALLOCATOR_VARIANTS(mark_restore)
+
+/* Pattern: REQUESTS requests, each allocating `param` objects of 16-1024
+ * bytes that all live until the request completes */
+#define REQUESTS 8
+
+NU_BENCH_GROUP(request_churn, NU_BENCH_VALUES(16, 256, 4096)) {
+  arenas_prepare((size_t)param * 1024, 0);
+}
+
+NU_BENCH_VARIANT(request_churn, arena) {
+  size_t count = (size_t)param;
+  nu_bench_set_items(REQUESTS * count);
+  NU_BENCH_START();
+  for (size_t r = 0; r < REQUESTS; r++) {
+    for (size_t i = 0; i < count; i++) {
+      slots[i] = arena_allocate(&arena, size_for(r * count + i, 16, 1024));
+    }
+    nu_bench_do_not_optimize(slots);
+    nu_arena_reset(&arena);
+  }
+  NU_BENCH_END();
+}
+
+static void
+request_churn_run(const allocator_t* a, int64_t param) {
+  size_t count = (size_t)param;
+  nu_bench_set_items(REQUESTS * count);
+  NU_BENCH_START();
+  for (size_t r = 0; r < REQUESTS; r++) {
+    for (size_t i = 0; i < count; i++) {
+      slots[i] = allocate(a, size_for(r * count + i, 16, 1024));
+    }
+    for (size_t i = 0; i < count; i++) {
+      release(a, slots[i]);
+    }
+  }
+  NU_BENCH_END();
+}
+
+ALLOCATOR_VARIANTS(request_churn)
+
+/* Pattern: `param` long-lived objects of 32-80 bytes interleaved with as
+ * many short-lived ones of 64-1024 bytes; the short-lived ones are freed,
+ * leaving holes between the long-lived ones, and `param` objects of
+ * 1088-1536 bytes, too large for any hole, are allocated before
+ * everything is released. Items are the 3 * param allocations. */
+NU_BENCH_GROUP(fragmentation, NU_BENCH_VALUES(256, 2048, 16384)) {
+  arenas_prepare((size_t)param * (80 + 1536), (size_t)param * 1024);
+}
+
+NU_BENCH_VARIANT(fragmentation, arena) {
+  size_t n      = (size_t)param;
+  void** longs  = slots;
+  void** shorts = slots + n;
+  void** larges = slots + 2 * n;
+  nu_bench_set_items(3 * n);
+  NU_BENCH_START();
+  for (size_t i = 0; i < n; i++) {
+    longs[i]  = arena_allocate(&arena, size_for(i, 32, 80));
+    shorts[i] = arena_allocate(&scratch, size_for(n + i, 64, 1024));
+  }
+  nu_bench_do_not_optimize(slots);
+  nu_arena_reset(&scratch);
+  for (size_t i = 0; i < n; i++) {
+    larges[i] = arena_allocate(&arena, size_for(2 * n + i, 1088, 1536));
+  }
+  nu_bench_do_not_optimize(slots);
+  nu_arena_reset(&arena);
+  NU_BENCH_END();
+}
+
+static void
+fragmentation_run(const allocator_t* a, int64_t param) {
+  size_t n      = (size_t)param;
+  void** longs  = slots;
+  void** shorts = slots + n;
+  void** larges = slots + 2 * n;
+  nu_bench_set_items(3 * n);
+  NU_BENCH_START();
+  for (size_t i = 0; i < n; i++) {
+    longs[i]  = allocate(a, size_for(i, 32, 80));
+    shorts[i] = allocate(a, size_for(n + i, 64, 1024));
+  }
+  for (size_t i = 0; i < n; i++) {
+    release(a, shorts[i]);
+  }
+  for (size_t i = 0; i < n; i++) {
+    larges[i] = allocate(a, size_for(2 * n + i, 1088, 1536));
+  }
+  for (size_t i = 0; i < n; i++) {
+    release(a, longs[i]);
+    release(a, larges[i]);
+  }
+  NU_BENCH_END();
+}
+
+ALLOCATOR_VARIANTS(fragmentation)
+
+/* Multi-threaded: every thread allocates MT_COUNT objects of 16-512 bytes
+ * and releases them, through its own arena or a shared allocator */
+#define MT_COUNT 1024
+#define MT_ARENA_SIZE (MT_COUNT * 512)
+
+static char* mt_memory[NU_BENCH_MAX_THREADS];
+static nu_arena mt_arenas[NU_BENCH_MAX_THREADS];
+static void* mt_slots[NU_BENCH_MAX_THREADS][MT_COUNT];
+
+NU_BENCH_SETUP(mt_alloc_arena) {
+  for (int64_t t = 0; t < param; t++) {
+    mt_memory[t] = malloc(MT_ARENA_SIZE);
+    if (!mt_memory[t]) {
+      allocation_failed("arena memory");
+    }
+    memset(mt_memory[t], 0, MT_ARENA_SIZE);
+    nu_arena_init(&mt_arenas[t], mt_memory[t], MT_ARENA_SIZE);
+  }
+}
+
+NU_BENCH_TEARDOWN(mt_alloc_arena) {
+  for (int64_t t = 0; t < param; t++) {
+    free(mt_memory[t]);
+    mt_memory[t] = NULL;
+  }
+}
+
+NU_BENCH_MT(mt_alloc_arena) {
+  nu_arena* own = &mt_arenas[thread];
+  void** own_slots = mt_slots[thread];
+  nu_bench_set_items(MT_COUNT);
+  NU_BENCH_START();
+  for (size_t i = 0; i < MT_COUNT; i++) {
+    own_slots[i] = arena_allocate(own, size_for(i, 16, 512));
+  }
+  nu_arena_reset(own);
+  NU_BENCH_END();
+  nu_bench_do_not_optimize(own_slots);
+}
+
+static void
+mt_alloc_run(const allocator_t* a, int32_t thread) {
+  void** own_slots = mt_slots[thread];
+  nu_bench_set_items(MT_COUNT);
+  NU_BENCH_START();
+  for (size_t i = 0; i < MT_COUNT; i++) {
+    own_slots[i] = allocate(a, size_for(i, 16, 512));
+  }
+  for (size_t i = 0; i < MT_COUNT; i++) {
+    release(a, own_slots[i]);
+  }
+  NU_BENCH_END();
+}
+
+static void
+mt_alloc_malloc(int32_t thread, int32_t threads) {
+  (void)threads;
+  mt_alloc_run(&allocators[SYSTEM], thread);
+}
+
+static void
+mt_alloc_jemalloc(int32_t thread, int32_t threads) {
+  (void)threads;
+  mt_alloc_run(&allocators[JEMALLOC], thread);
+}
+
+static void
+mt_alloc_mimalloc(int32_t thread, int32_t threads) {
+  (void)threads;
+  mt_alloc_run(&allocators[MIMALLOC], thread);
+}
+
+/* Load the allocators and register their variants of every group, with
+ * system malloc as the baseline; runs with the other variants, after the
+ * groups are registered */
+__attribute__((constructor(301)))
+static void
+register_allocators(void) {
+  static const char* const jemalloc_libraries[] = {
+    "libjemalloc.so.2", "libjemalloc.so", "libjemalloc.2.dylib", "libjemalloc.dylib", NULL
+  };
+  static const char* const mimalloc_libraries[] = {
+    "libmimalloc.so.2", "libmimalloc.so", "libmimalloc.2.dylib", "libmimalloc.dylib", NULL
+  };
+  static const struct {
+    const char* group;
+    nu_bench_param_fn fns[ALLOCATOR_COUNT];
+  } groups[] = {
+    {"small_allocs", {small_allocs_malloc, small_allocs_jemalloc, small_allocs_mimalloc}},
+    {"aligned_allocs", {aligned_allocs_malloc, aligned_allocs_jemalloc, aligned_allocs_mimalloc}},
+    {"mark_restore", {mark_restore_malloc, mark_restore_jemalloc, mark_restore_mimalloc}},
+    {"request_churn", {request_churn_malloc, request_churn_jemalloc, request_churn_mimalloc}},
+    {"fragmentation", {fragmentation_malloc, fragmentation_jemalloc, fragmentation_mimalloc}},
+  };
+  static const struct {
+    const char* name;
+    nu_bench_mt_fn fn;
+  } mt[ALLOCATOR_COUNT] = {
+    {"mt_alloc_malloc", mt_alloc_malloc},
+    {"mt_alloc_jemalloc", mt_alloc_jemalloc},
+    {"mt_alloc_mimalloc", mt_alloc_mimalloc},
+  };
+
+  allocators[SYSTEM].malloc        = system_malloc;
+  allocators[SYSTEM].free          = system_free;
+  allocators[SYSTEM].aligned_alloc = aligned_alloc;
+  allocators[SYSTEM].usable_size   = nu_bench_usable_size;
+  load_allocator(&allocators[JEMALLOC], jemalloc_libraries, "malloc", "free", "aligned_alloc",
+                 "malloc_usable_size");
+  load_allocator(&allocators[MIMALLOC], mimalloc_libraries, "mi_malloc", "mi_free", "mi_aligned_alloc",
+                 "mi_usable_size");
+
+  for (int32_t a = 0; a < ALLOCATOR_COUNT; a++) {
+    if (!allocators[a].malloc) {
+      continue;
+    }
+    for (size_t g = 0; g < sizeof(groups) / sizeof(groups[0]); g++) {
+      nu_bench_register_variant(groups[g].group, allocators[a].name, groups[g].fns[a], a == SYSTEM);
+    }
+    nu_bench_register_mt_impl(mt[a].name, mt[a].fn);
+  }
+}
+
+/* Main function - runs all benchmarks */
+NU_BENCH_MAIN()
@@ -0,0 +1,285 @@
+/*
+ * Benchmarks for nu/error
+ *
+ * Measures what the Result-based error handling costs compared with plain
+ * errno-style integer returns, on both the path where nothing fails and
+ * the path where an error is built and propagated:
+ *
+ *   - try_success: a call chain of the given depth where every level
+ *     checks its callee with TRY, against `if (rc != 0) return rc;`
+ *   - try_error: the same chain with the deepest call failing. TRY copies
+ *     the whole nu_error_t (code, location and 128-byte message) into its
+ *     static _err_copy at every level; the pass_through variant returns the
+ *     callee's result unchanged, isolating the cost of those copies
+ *   - error_make: building a single error with ERR, whose vsnprintf into
+ *     the embedded message buffer is swept over message lengths, against
+ *     returning a code and against formatting with snprintf alone
+ *   - thread_result: a worker returning through OK_T/ERR_T (a heap
+ *     allocated nu_thread_result_t) collected with COLLECT_THREAD, against
+ *     a worker returning its error code through pthread_join's void*
+ *   - thread_result_make: the allocation, formatting and free of a thread
+ *     result without the thread, which is what OK_T/ERR_T add to each join
+ *
+ * Each group is an A/B comparison with the errno style (the errcode
+ * variant) as the baseline.
+ * Single operations take nanoseconds, so each invocation performs OPS of
+ * them and the items/s rate is per operation. Chain levels and error
+ * constructors are out-of-line so the compiler cannot collapse them.
+ */
+
+#include <nu/bench.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/error.h"
+
+/* Operations per timed invocation */
+#define OPS 256
+
+/* Message text the formatting benchmarks take prefixes of */
+static const char text[] =
+  "the quick brown fox jumps over the lazy dog while the sorted run at "
+  "index 1234 overflowed its scratch buffer and had to be merged again";
+
+/* errno style: 0 on success or an error code; each level does a little
+ * work after its callee succeeds so the call cannot become a tail call */
+static __attribute__((noinline)) int
+chain_errno(int32_t depth, bool fail, int32_t* count) {
+  if (depth == 0) {
+    return fail ? EINVAL : 0;
+  }
+  int rc = chain_errno(depth - 1, fail, count);
+  if (rc != 0) {
+    return rc;
+  }
+  (*count)++;
+  return 0;
+}
+
+/* The same chain with nu_result_t and TRY */
+static __attribute__((noinline)) nu_result_t
+chain_try(int32_t depth, bool fail, int32_t* count) {
+  if (depth == 0) {
+    if (fail) {
+      return ERR(INVALID_ARG, "invalid value at depth %d", depth);
+    }
+    return OK(count);
+  }
+  TRY(chain_try(depth - 1, fail, count));
+  (*count)++;
+  return OK(count);
+}
+
+/* The same chain returning the callee's error without TRY's copy */
+static __attribute__((noinline)) nu_result_t
+chain_pass_through(int32_t depth, bool fail, int32_t* count) {
+  if (depth == 0) {
+    if (fail) {
+      return ERR(INVALID_ARG, "invalid value at depth %d", depth);
+    }
+    return OK(count);
+  }
+  nu_result_t result = chain_pass_through(depth - 1, fail, count);
+  if (result.is_err) {
+    return result;
+  }
+  (*count)++;
+  return OK(count);
+}
+
+/* Run OPS calls of a chain of depth `param`, timing all of them */
+#define CHAIN_BODY(check) \
+        do { \
+          int32_t count = 0; \
+          nu_bench_set_items(OPS); \
+          NU_BENCH_START(); \
+          for (int32_t i = 0; i < OPS; i++) { \
+            check; \
+          } \
+          NU_BENCH_END(); \
+          nu_bench_do_not_optimize(&count); \
+        } while (0)
+
+NU_BENCH_GROUP(try_success, NU_BENCH_VALUES(1, 4, 16, 64)) {
+}
+
+NU_BENCH_BASELINE(try_success, errcode) {
+  CHAIN_BODY({
+    int rc = chain_errno((int32_t)param, false, &count);
+    nu_bench_do_not_optimize(&rc);
+  });
+}
+
+NU_BENCH_VARIANT(try_success, try) {
+  CHAIN_BODY({
+    nu_result_t result = chain_try((int32_t)param, false, &count);
+    nu_bench_do_not_optimize(&result);
+  });
+}
+
+NU_BENCH_GROUP(try_error, NU_BENCH_VALUES(1, 4, 16, 64)) {
+}
+
+NU_BENCH_BASELINE(try_error, errcode) {
+  CHAIN_BODY({
+    int rc = chain_errno((int32_t)param, true, &count);
+    nu_bench_do_not_optimize(&rc);
+  });
+}
+
+NU_BENCH_VARIANT(try_error, try) {
+  CHAIN_BODY({
+    nu_result_t result = chain_try((int32_t)param, true, &count);
+    nu_bench_do_not_optimize(&result);
+  });
+}
+
+NU_BENCH_VARIANT(try_error, pass_through) {
+  CHAIN_BODY({
+    nu_result_t result = chain_pass_through((int32_t)param, true, &count);
+    nu_bench_do_not_optimize(&result);
+  });
+}
+
+/* Error constructors for a message of `len` characters */
+static __attribute__((noinline)) int
+make_errno(int32_t len) {
+  return len >= 0 ? EINVAL : 0;
+}
+
+static __attribute__((noinline)) int
+make_snprintf(char* buf, size_t size, int32_t len) {
+  return snprintf(buf, size, "%.*s", (int)len, text) >= (int)size ? ERANGE : EINVAL;
+}
+
+static __attribute__((noinline)) nu_result_t
+make_err(int32_t len) {
+  return ERR(INVALID_ARG, "%.*s", (int)len, text);
+}
+
+/* Build OPS errors with a message of `param` characters */
+#define MAKE_BODY(call) \
+        do { \
+          nu_bench_set_items(OPS); \
+          NU_BENCH_START(); \
+          for (int32_t i = 0; i < OPS; i++) { \
+            call; \
+          } \
+          NU_BENCH_END(); \
+        } while (0)
+
+NU_BENCH_GROUP(error_make, NU_BENCH_VALUES(0, 16, 64, 127)) {
+}
+
+NU_BENCH_BASELINE(error_make, errcode) {
+  MAKE_BODY({
+    int rc = make_errno((int32_t)param);
+    nu_bench_do_not_optimize(&rc);
+  });
+}
+
+NU_BENCH_VARIANT(error_make, snprintf) {
+  char buf[128];
+  MAKE_BODY({
+    int rc = make_snprintf(buf, sizeof(buf), (int32_t)param);
+    nu_bench_do_not_optimize(&rc);
+    nu_bench_do_not_optimize(buf);
+  });
+}
+
+NU_BENCH_VARIANT(error_make, err) {
+  MAKE_BODY({
+    nu_result_t result = make_err((int32_t)param);
+    nu_bench_do_not_optimize(&result);
+  });
+}
+
+/* Thread workers; the argument selects success or failure */
+static void*
+worker_errno(void* arg) {
+  return (void*)(intptr_t)(arg ? EINVAL : 0);
+}
+
+static void*
+worker_result(void* arg) {
+  if (arg) {
+    ERR_T(INVALID_ARG, "worker failed with %d", EINVAL);
+  }
+  OK_T(NULL);
+}
+
+/* Start and join `param` workers per invocation */
+#define THREAD_BODY(worker, fail, collect) \
+        do { \
+          pthread_t threads[8]; \
+          size_t n = (size_t)param; \
+          nu_bench_set_items(n); \
+          NU_BENCH_START(); \
+          for (size_t i = 0; i < n; i++) { \
+            if (pthread_create(&threads[i], NULL, worker, (fail) ? threads : NULL) != 0) { \
+              fprintf(stderr, "pthread_create failed\n"); \
+              exit(1); \
+            } \
+          } \
+          for (size_t i = 0; i < n; i++) { \
+            collect; \
+          } \
+          NU_BENCH_END(); \
+        } while (0)
+
+NU_BENCH_GROUP(thread_result, NU_BENCH_VALUES(1, 4, 8)) {
+}
+
+NU_BENCH_BASELINE(thread_result, errcode) {
+  THREAD_BODY(worker_errno, true, {
+    void* rc;
+    pthread_join(threads[i], &rc);
+    nu_bench_do_not_optimize(&rc);
+  });
+}
+
+NU_BENCH_VARIANT(thread_result, ok_t) {
+  THREAD_BODY(worker_result, false, {
+    nu_result_t result = COLLECT_THREAD(threads[i]);
+    nu_bench_do_not_optimize(&result);
+  });
+}
+
+NU_BENCH_VARIANT(thread_result, err_t) {
+  THREAD_BODY(worker_result, true, {
+    nu_result_t result = COLLECT_THREAD(threads[i]);
+    nu_bench_do_not_optimize(&result);
+  });
+}
+
+NU_BENCH_GROUP(thread_result_make, NU_BENCH_VALUES(1)) {
+}
+
+NU_BENCH_BASELINE(thread_result_make, errcode) {
+  MAKE_BODY({
+    void* rc = worker_errno(&param);
+    nu_bench_do_not_optimize(&rc);
+  });
+}
+
+NU_BENCH_VARIANT(thread_result_make, ok) {
+  MAKE_BODY({
+    nu_thread_result_t* result = _nu_make_thread_ok(NULL);
+    nu_bench_do_not_optimize(&result);
+    free(result);
+  });
+}
+
+NU_BENCH_VARIANT(thread_result_make, error) {
+  MAKE_BODY({
+    nu_thread_result_t* result = _nu_make_thread_error(NU_ERR_INVALID_ARG, __FILE__, __LINE__,
+                                                       "worker failed with %d", EINVAL);
+    nu_bench_do_not_optimize(&result);
+    free(result);
+  });
+}
+
+NU_BENCH_MAIN()
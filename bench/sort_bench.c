@@ -1,18 +1,38 @@
 /*
  * Benchmarks for nu_sort
  *
- * Tests performance across different input patterns that affect
- * introsort's behavior:
- * - Random data (typical case)
- * - Already sorted (best case for many algorithms)
- * - Reverse sorted (worst case for naive quicksort)
- * - Many duplicates (tests pivot selection effectiveness)
+ * Runs nu_sort over the nu_datagen corpus: every input distribution
+ * (random, sorted, reversed, Zipf, organ pipe, sorted with random swaps,
+ * ascending runs, all-equal with outliers, and McIlroy's antiqsort
+ * adversary) in int32 and 256-byte records, the narrowest and widest
+ * element types. Real inputs are rarely uniformly random, and the
+ * distributions that stress pivot selection, run detection and duplicate
+ * handling are where introsort variants differ most. Building with
+ * -DSORT_BENCH_FULL_MATRIX (SORT_BENCH_FULL=1 make) adds the other element
+ * types (int64, double, 16-byte strings and 64-byte records) for the full
+ * cross-product, which takes several times longer to run.
+ *
+ * Each distribution and type is an A/B group: nu_sort is compared against
+ * glibc qsort on the same inputs, run interleaved in randomized order, and
+ * reported relative to qsort with significance markers. int32 groups also
+ * include a specialized integer radix sort. Each group is swept over a
+ * range of sizes so the report includes the fitted growth rate; small
+ * sizes exercise the insertion sort cutoff, and larger element types stop
+ * at smaller sizes to keep the working set comparable.
+ *
+ * Inputs are generated once per size into a pristine buffer and copied
+ * into the work buffer before every invocation, so only the sort itself
+ * is timed and every invocation of every variant sorts the same data. The
+ * work buffer is registered so --cache=cold flushes it before each sort.
  */
 
 #include <nu/bench.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include "../src/sort.h"
+#include "../src/datagen.h"
 
 /* Comparator for integers */
 static int
@@ -22,118 +42,157 @@ compare_ints(const void* a, const void* b) {
   return (ia > ib) - (ia < ib);
 }
 
-/* Benchmark: 100k random elements */
-NU_BENCH(sort_random_100k) {
-  const size_t n = 100000;
-
-  // Setup: Create random array
-  NU_BENCH_ARRAY_SETUP(int, arr, n, rand() % 10000);
-
-  // Benchmark the sort
-  NU_BENCH_START();
-  nu_sort(arr, n, sizeof(int), compare_ints);
-  NU_BENCH_END();
-
-  // Cleanup
-  NU_BENCH_ARRAY_CLEANUP(arr);
-}
-
-/* Benchmark: 50k already sorted elements */
-NU_BENCH(sort_already_sorted_50k) {
-  const size_t n = 50000;
-
-  // Setup: Create already sorted array
-  NU_BENCH_ARRAY_SETUP(int, arr, n, (int)i);
-
-  // Benchmark the sort
-  NU_BENCH_START();
-  nu_sort(arr, n, sizeof(int), compare_ints);
-  NU_BENCH_END();
-
-  // Cleanup
-  NU_BENCH_ARRAY_CLEANUP(arr);
-}
-
-/* Benchmark: 50k reverse sorted elements */
-NU_BENCH(sort_reverse_sorted_50k) {
-  const size_t n = 50000;
-
-  // Setup: Create reverse sorted array
-  NU_BENCH_ARRAY_SETUP(int, arr, n, (int)(n - i));
-
-  // Benchmark the sort
-  NU_BENCH_START();
-  nu_sort(arr, n, sizeof(int), compare_ints);
-  NU_BENCH_END();
-
-  // Cleanup
-  NU_BENCH_ARRAY_CLEANUP(arr);
+/* LSD radix sort of int32s, one byte per pass, skipping bytes every key
+ * shares; tmp must hold n int32s. The specialized alternative to a generic
+ * comparison sort when the key is a plain integer. */
+static void
+radix_sort_ints(int32_t* a, int32_t* tmp, size_t n) {
+  int32_t* src = a;
+  int32_t* dst = tmp;
+  for (unsigned shift = 0; shift < 32; shift += 8) {
+    size_t count[257] = {0};
+    for (size_t i = 0; i < n; i++) {
+      count[((((uint32_t)src[i] ^ 0x80000000u) >> shift) & 0xFF) + 1]++;
+    }
+    bool trivial = false;
+    for (size_t d = 1; d <= 256; d++) {
+      trivial = trivial || count[d] == n;
+      count[d] += count[d - 1];
+    }
+    if (trivial) {
+      continue;
+    }
+    for (size_t i = 0; i < n; i++) {
+      dst[count[(((uint32_t)src[i] ^ 0x80000000u) >> shift) & 0xFF]++] = src[i];
+    }
+    int32_t* t = src;
+    src = dst;
+    dst = t;
+  }
+  if (src != a) {
+    memcpy(a, src, n * sizeof(int32_t));
+  }
 }
 
-/* Benchmark: 50k elements with many duplicates (only 10 unique values) */
-NU_BENCH(sort_many_duplicates_50k) {
-  const size_t n = 50000;
-
-  // Setup: Create array with only 10 unique values
-  srand(42);  // Fixed seed for reproducibility
-  NU_BENCH_ARRAY_SETUP(int, arr, n, rand() % 10);
-
-  // Benchmark the sort
-  NU_BENCH_START();
-  nu_sort(arr, n, sizeof(int), compare_ints);
-  NU_BENCH_END();
-
-  // Cleanup
-  NU_BENCH_ARRAY_CLEANUP(arr);
+/* Shared fixture buffers; benchmarks run one at a time */
+static unsigned char* pristine;
+static unsigned char* work;
+static unsigned char* scratch;
+
+/* Allocate the fixture buffers and generate n elements of `type` following
+ * `dist` into the pristine buffer, with a fixed seed for reproducibility */
+static void
+sort_fixture_alloc(size_t n, nu_datagen_dist_t dist, nu_datagen_type_t type) {
+  size_t size = nu_datagen_type_size(type);
+  pristine = malloc(n * size);
+  work     = malloc(n * size);
+  scratch  = malloc(n * size);
+  if (!pristine || !work || !scratch || !nu_datagen_generate(pristine, n, dist, type, 42)) {
+    fprintf(stderr, "Benchmark allocation failed\n");
+    exit(1);
+  }
+  nu_bench_cache_region(work, n * size);
 }
 
-/* Benchmark: Small array (16 elements) - triggers insertion sort */
-NU_BENCH(sort_small_16) {
-  const size_t n = 16;
-
-  // Setup: Small random array
-  NU_BENCH_ARRAY_SETUP(int, arr, n, rand() % 100);
-
-  // Benchmark the sort
+/* Sort the work buffer with `call`, timing only the sort */
+#define SORT_BENCH_BODY(n, size, call) \
+        do { \
+          nu_bench_set_items((n)); \
+          nu_bench_set_bytes((n) * (size)); \
+          NU_BENCH_START(); \
+          call; \
+          NU_BENCH_END(); \
+          nu_bench_do_not_optimize(work); \
+        } while (0)
+
+/* Declare the group sort_<dist>_<type>: the pristine input is generated
+ * once per size and copied into the work buffer before each invocation of
+ * every variant. glibc qsort is the baseline; nu_sort is compared against
+ * it on identical data. */
+#define SORT_GROUP(dist, DIST, type, TYPE, high) \
+        NU_BENCH_GROUP(sort_##dist##_##type, NU_BENCH_RANGE(1 << 4, (high), 8)) { \
+          sort_fixture_alloc((size_t)param, DIST, TYPE); \
+        } \
+        NU_BENCH_RESET(sort_##dist##_##type) { \
+          memcpy(work, pristine, (size_t)param * nu_datagen_type_size(TYPE)); \
+        } \
+        NU_BENCH_TEARDOWN(sort_##dist##_##type) { \
+          free(pristine); \
+          free(work); \
+          free(scratch); \
+        } \
+        NU_BENCH_BASELINE(sort_##dist##_##type, qsort) { \
+          SORT_BENCH_BODY((size_t)param, nu_datagen_type_size(TYPE), \
+            qsort(work, (size_t)param, nu_datagen_type_size(TYPE), nu_datagen_comparator(TYPE))); \
+        } \
+        NU_BENCH_VARIANT(sort_##dist##_##type, nu_sort) { \
+          SORT_BENCH_BODY((size_t)param, nu_datagen_type_size(TYPE), \
+            nu_sort(work, (size_t)param, nu_datagen_type_size(TYPE), nu_datagen_comparator(TYPE))); \
+        }
+
+/* The element types between int32 and 256-byte records, for the full
+ * matrix only */
+#ifdef SORT_BENCH_FULL_MATRIX
+#define SORT_MATRIX_MORE_TYPES(dist, DIST) \
+        SORT_GROUP(dist, DIST, int64, NU_DATAGEN_INT64, 1 << 20) \
+        SORT_GROUP(dist, DIST, double, NU_DATAGEN_DOUBLE, 1 << 20) \
+        SORT_GROUP(dist, DIST, string16, NU_DATAGEN_STRING16, 1 << 20) \
+        SORT_GROUP(dist, DIST, record64, NU_DATAGEN_RECORD64, 1 << 18)
+#else
+#define SORT_MATRIX_MORE_TYPES(dist, DIST)
+#endif
+
+/* One distribution in each element type; larger elements stop at smaller
+ * sizes. The int32 group also compares the radix sort. */
+#define SORT_MATRIX(dist, DIST) \
+        SORT_GROUP(dist, DIST, int32, NU_DATAGEN_INT32, 1 << 20) \
+        SORT_MATRIX_MORE_TYPES(dist, DIST) \
+        SORT_GROUP(dist, DIST, record256, NU_DATAGEN_RECORD256, 1 << 16) \
+        NU_BENCH_VARIANT(sort_##dist##_int32, radix) { \
+          SORT_BENCH_BODY((size_t)param, sizeof(int32_t), \
+            radix_sort_ints((int32_t*)(void*)work, (int32_t*)(void*)scratch, (size_t)param)); \
+        }
+
+SORT_MATRIX(random, NU_DATAGEN_RANDOM)
+SORT_MATRIX(sorted, NU_DATAGEN_SORTED)
+SORT_MATRIX(reversed, NU_DATAGEN_REVERSED)
+SORT_MATRIX(zipf, NU_DATAGEN_ZIPF)
+SORT_MATRIX(organ_pipe, NU_DATAGEN_ORGAN_PIPE)
+SORT_MATRIX(sorted_swaps, NU_DATAGEN_SORTED_SWAPS)
+SORT_MATRIX(runs, NU_DATAGEN_RUNS)
+SORT_MATRIX(equal_outliers, NU_DATAGEN_EQUAL_OUTLIERS)
+SORT_MATRIX(antiqsort, NU_DATAGEN_ANTIQSORT)
+
+/* Benchmark: independent 64k random sorts on 1..N threads (nu_sort is
+ * reentrant, so this measures how well it shares memory bandwidth) */
+NU_BENCH_MT(sort_random_64k_mt) {
+  const size_t n = 1 << 16;
+  NU_BENCH_ARRAY_SETUP(int, arr, n, (int)(i * 2654435761u % 10000));
+  nu_bench_set_items(n);
   NU_BENCH_START();
   nu_sort(arr, n, sizeof(int), compare_ints);
   NU_BENCH_END();
-
-  // Cleanup
+  nu_bench_do_not_optimize(arr);
   NU_BENCH_ARRAY_CLEANUP(arr);
 }
 
-/* Benchmark: Medium array (1000 elements) */
-NU_BENCH(sort_medium_1k) {
-  const size_t n = 1000;
-
-  // Setup: Medium random array
-  NU_BENCH_ARRAY_SETUP(int, arr, n, rand() % 1000);
+/* Benchmark: sorting 1k elements as a request arriving at a fixed rate.
+ * Latency is measured from each request's scheduled start, so it includes
+ * the time spent queued behind earlier, slower requests. */
+static int request_input[1 << 10];
+static int request_work[1 << 10];
 
-  // Benchmark the sort
-  NU_BENCH_START();
-  nu_sort(arr, n, sizeof(int), compare_ints);
-  NU_BENCH_END();
-
-  // Cleanup
-  NU_BENCH_ARRAY_CLEANUP(arr);
+NU_BENCH_SETUP(sort_1k_open_loop) {
+  for (size_t i = 0; i < 1 << 10; i++) {
+    request_input[i] = (int)(i * 2654435761u % 10000);
+  }
 }
 
-/* Benchmark: Sawtooth pattern (partially sorted sequences) */
-NU_BENCH(sort_sawtooth_10k) {
-  const size_t n = 10000;
-
-  // Setup: Create sawtooth pattern (0,1,2,3,4, 0,1,2,3,4, ...)
-  NU_BENCH_ARRAY_SETUP(int, arr, n, (int)(i % 5));
-
-  // Benchmark the sort
-  NU_BENCH_START();
-  nu_sort(arr, n, sizeof(int), compare_ints);
-  NU_BENCH_END();
-
-  // Cleanup
-  NU_BENCH_ARRAY_CLEANUP(arr);
+NU_BENCH_OPEN_LOOP(sort_1k_open_loop) {
+  memcpy(request_work, request_input, sizeof(request_work));
+  nu_sort(request_work, 1 << 10, sizeof(int), compare_ints);
+  nu_bench_do_not_optimize(request_work);
 }
 
 /* Main function - runs all benchmarks */
-NU_BENCH_MAIN()
\ No newline at end of file
+NU_BENCH_MAIN()
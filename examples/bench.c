@@ -18,10 +18,16 @@
  *
  * The nu/bench.h framework provides:
  * - NU_BENCH(name) to define benchmarks
+ * - NU_BENCH_PARAM(name, sweep) to run one body over a range of sizes
+ * - NU_BENCH_MT(name) to run one body on several threads at once
+ * - NU_BENCH_SETUP/RESET/TEARDOWN(name) fixtures that are never timed
+ * - NU_BENCH_GROUP(name, sweep) to compare variants on the same input
+ * - NU_BENCH_OPEN_LOOP(name) to measure latency at a fixed arrival rate
  * - NU_BENCH_START() to start timing
  * - NU_BENCH_END() to stop timing
  * - Automatic registration and execution
- * - Statistical analysis (mean, min, max)
+ * - Statistical analysis (median with confidence interval, percentiles,
+ *   mean/stddev, outlier detection)
  * - Warmup runs to stabilize performance
  */
 
@@ -154,12 +160,17 @@ NU_BENCH(search_binary_10k) {
 /*
  * Example 4: Benchmarking different input sizes
  *
- * Create multiple benchmarks with different sizes to understand
- * how performance scales.
+ * NU_BENCH_PARAM runs the body once per value of a sweep, passing it as
+ * `param`. NU_BENCH_POW2(lo, hi) sweeps powers of two, NU_BENCH_RANGE(lo,
+ * hi, mult) a geometric range and NU_BENCH_VALUES(...) an explicit list.
+ * Each size is reported as "name/size", followed by the growth rate that
+ * best fits the sweep (here O(n^2)). nu_bench_set_items() adds items/s to
+ * the report; nu_bench_set_bytes() does the same for bytes/s.
  */
-NU_BENCH(bubble_sort_100) {
-  const size_t n = 100;
+NU_BENCH_PARAM(bubble_sort, NU_BENCH_VALUES(100, 200, 400, 800)) {
+  const size_t n = (size_t)param;
   NU_BENCH_ARRAY_SETUP(int, arr, n, rand() % 1000);
+  nu_bench_set_items(n);
 
   NU_BENCH_START();
 
@@ -179,33 +190,12 @@ NU_BENCH(bubble_sort_100) {
   NU_BENCH_ARRAY_CLEANUP(arr);
 }
 
-NU_BENCH(bubble_sort_500) {
-  const size_t n = 500;
-  NU_BENCH_ARRAY_SETUP(int, arr, n, rand() % 1000);
-
-  NU_BENCH_START();
-
-  // Same bubble sort, larger input
-  for (size_t i = 0; i < n-1; i++) {
-    for (size_t j = 0; j < n-i-1; j++) {
-      if (arr[j] > arr[j+1]) {
-        int32_t temp = arr[j];
-        arr[j]   = arr[j+1];
-        arr[j+1] = temp;
-      }
-    }
-  }
-
-  NU_BENCH_END();
-
-  NU_BENCH_ARRAY_CLEANUP(arr);
-}
-
 /*
  * Example 5: Micro-benchmarks
  *
- * For very fast operations, benchmark a loop of operations
- * to get measurable times.
+ * Very fast operations are batched automatically: the framework repeats
+ * the body until one sample is long enough to time, then reports the time
+ * per invocation. An explicit loop is still useful to amortize setup.
  */
 NU_BENCH(string_length_micro) {
   const char* test_strings[] = {
@@ -229,7 +219,172 @@ NU_BENCH(string_length_micro) {
 
   NU_BENCH_END();
 
-  (void)total;    // Prevent optimization
+  // Without a barrier the compiler may drop the loop, since total is unused
+  nu_bench_do_not_optimize(&total);
+}
+
+/*
+ * Example 6: Multi-threaded benchmarks
+ *
+ * NU_BENCH_MT runs the body concurrently on 1, 2, 4, ... pinned threads
+ * (or the counts given with --threads 1,2,8). All threads are released
+ * together for every sample. The body receives `thread` (0..threads-1) and
+ * `threads`. Each run reports the per-thread latency distribution, the
+ * aggregate throughput and the scaling efficiency relative to the first
+ * thread count.
+ *
+ * Here every thread increments the same atomic counter, so throughput
+ * stops scaling once the cache line starts bouncing between cores.
+ */
+static _Atomic uint64_t shared_counter;
+
+NU_BENCH_MT(atomic_increment_shared) {
+  NU_BENCH_START();
+  for (int32_t i = 0; i < 1000; i++) {
+    shared_counter++;
+  }
+  NU_BENCH_END();
+}
+
+/*
+ * Example 7: Fixtures and multi-phase bodies
+ *
+ * Work that is not being measured belongs in fixtures, which run outside
+ * the timed region and receive the same `param` as the body:
+ * - NU_BENCH_SETUP(name) once before measuring (e.g. build the input)
+ * - NU_BENCH_RESET(name) before every invocation (e.g. restore the input)
+ * - NU_BENCH_TEARDOWN(name) once afterwards
+ *
+ * Within a body, NU_BENCH_PAUSE()/NU_BENCH_RESUME() exclude a phase from
+ * the timed region.
+ */
+static int32_t* reverse_input;
+static int32_t* reverse_work;
+
+NU_BENCH_PARAM(reverse_then_sum, NU_BENCH_VALUES(1000, 10000)) {
+  const size_t n = (size_t)param;
+
+  // Phase 1 (timed): reverse in place
+  NU_BENCH_START();
+  for (size_t i = 0; i < n / 2; i++) {
+    int32_t temp            = reverse_work[i];
+    reverse_work[i]         = reverse_work[n - 1 - i];
+    reverse_work[n - 1 - i] = temp;
+  }
+  NU_BENCH_PAUSE();
+
+  // Not timed: check the result
+  if (reverse_work[0] != reverse_input[n - 1]) {
+    fprintf(stderr, "reverse failed\n");
+  }
+
+  // Phase 2 (timed): sum
+  NU_BENCH_RESUME();
+  int64_t sum = 0;
+  for (size_t i = 0; i < n; i++) {
+    sum += reverse_work[i];
+  }
+  NU_BENCH_END();
+
+  nu_bench_do_not_optimize(&sum);
+}
+
+NU_BENCH_SETUP(reverse_then_sum) {
+  reverse_input = malloc((size_t)param * sizeof(int32_t));
+  reverse_work  = malloc((size_t)param * sizeof(int32_t));
+  for (int64_t i = 0; i < param; i++) {
+    reverse_input[i] = (int32_t)i;
+  }
+}
+
+NU_BENCH_RESET(reverse_then_sum) {
+  memcpy(reverse_work, reverse_input, (size_t)param * sizeof(int32_t));
+}
+
+NU_BENCH_TEARDOWN(reverse_then_sum) {
+  free(reverse_input);
+  free(reverse_work);
+}
+
+/*
+ * Example 8: A/B comparison groups
+ *
+ * Comparing implementations with separate benchmarks is fragile: they run
+ * minutes apart, on inputs built separately, and any drift in clock speed
+ * or background load in between shows up as a difference. A group runs its
+ * variants interleaved instead, one sample each per round in a shuffled
+ * order, all on the input built by the group body (the shared generator,
+ * run once per sweep point like NU_BENCH_SETUP).
+ *
+ * After the usual per-variant results ("<group>/<variant>/<param>"), a
+ * table gives each variant's speedup relative to the NU_BENCH_BASELINE
+ * variant, marked *, ** or *** when a Mann-Whitney U test finds the
+ * difference significant at p < 0.05, 0.01 or 0.001 (ns otherwise).
+ */
+static int32_t* search_input;
+
+NU_BENCH_GROUP(search, NU_BENCH_VALUES(1000, 100000)) {
+  search_input = malloc((size_t)param * sizeof(int32_t));
+  for (int64_t i = 0; i < param; i++) {
+    search_input[i] = (int32_t)i * 2;
+  }
+}
+
+NU_BENCH_TEARDOWN(search) {
+  free(search_input);
+}
+
+NU_BENCH_BASELINE(search, linear) {
+  int32_t target = (int32_t)param;  // Halfway through the input
+  size_t found   = 0;
+  NU_BENCH_START();
+  while (search_input[found] != target) {
+    found++;
+  }
+  NU_BENCH_END();
+  nu_bench_do_not_optimize(&found);
+}
+
+NU_BENCH_VARIANT(search, binary) {
+  int32_t target = (int32_t)param;
+  size_t lo      = 0, hi = (size_t)param;
+  NU_BENCH_START();
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (search_input[mid] < target) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  NU_BENCH_END();
+  nu_bench_do_not_optimize(&lo);
+}
+
+/*
+ * Example 9: Latency under load (open loop)
+ *
+ * Every other benchmark here is closed-loop: the next invocation starts when
+ * the previous one ends, so a slow invocation delays the ones behind it
+ * without that delay ever being measured. Callers of a service or a shared
+ * queue do not wait politely like that. An open-loop benchmark issues its
+ * body (one operation, no START/END) on a fixed schedule instead, and
+ * measures each latency from when the operation was due, queueing included.
+ *
+ * The closed-loop capacity is measured first; the body is then offered at
+ * 10%, 25%, ... of it (or the --load percentages) until it saturates. The
+ * final table is the latency-vs-throughput curve: here one request in 64
+ * is 20x slower, and the tail grows sharply well before 100% load.
+ */
+static uint32_t request_count;
+
+NU_BENCH_OPEN_LOOP(request_service) {
+  uint32_t work = ++request_count % 64 == 0 ? 20000 : 1000;
+  uint64_t hash = 14695981039346656037ULL;
+  for (uint32_t i = 0; i < work; i++) {
+    hash = (hash ^ i) * 1099511628211ULL;
+  }
+  nu_bench_do_not_optimize(&hash);
 }
 
 /*
@@ -238,9 +393,11 @@ NU_BENCH(string_length_micro) {
  * Use NU_BENCH_MAIN() to create a main function that runs all benchmarks.
  * The framework provides command-line options:
  *   -v           Verbose output with detailed statistics
- *   -n <count>   Number of iterations (default: 100)
- *   -w <count>   Number of warmup runs (default: 5)
+ *   -n <count>   Fixed number of samples (default: adaptive)
+ *   -w <count>   Number of warmup samples (default: 5)
+ *   --time <s>   Time budget per benchmark (default: 1)
  *   -f <filter>  Run only benchmarks matching filter
+ *   --clock <c>  Time source: wall (default), cpu, or tsc
  *   -h           Show help
  */
 
@@ -259,16 +416,29 @@ print_tutorial_header (void)
   printf("  3. Algorithm comparison\n");
   printf("  4. Performance scaling analysis\n");
   printf("  5. Micro-benchmarking techniques\n");
+  printf("  6. Multi-threaded scaling\n");
+  printf("  7. Fixtures and multi-phase bodies\n");
+  printf("  8. A/B comparison of variants on a shared input\n");
+  printf("  9. Open-loop latency under load\n");
   printf("\nKey concepts:\n");
-  printf("  - Benchmarks run multiple iterations for statistical accuracy\n");
+  printf("  - Fast bodies are batched so each sample is long enough to time\n");
+  printf("  - Samples are collected until the mean is stable or time runs out\n");
   printf("  - Warmup runs eliminate cold-start effects\n");
-  printf("  - Times are reported as mean of all iterations\n");
+  printf("  - Times are reported as the median of all iterations\n");
   printf("  - Smaller times are better (faster execution)\n");
   printf("\nCommand-line options:\n");
   printf("  ./bench           Run all benchmarks\n");
   printf("  ./bench -v        Show detailed statistics\n");
-  printf("  ./bench -n 1000   Run 1000 iterations\n");
+  printf("  ./bench -n 1000   Take exactly 1000 samples\n");
   printf("  ./bench -f sort   Run only 'sort' benchmarks\n");
+  printf("  ./bench --clock=tsc  Time with the CPU timestamp counter\n");
+  printf("  ./bench --threads 1,2,8  Thread counts for NU_BENCH_MT\n");
+  printf("  ./bench --cpu 2 --mlock  Pin to CPU 2 and lock memory\n");
+  printf("  ./bench --isolate --repetitions 3  Each benchmark in a fresh process, 3 times\n");
+  printf("  ./bench --profile prof  Write flame graph stacks to prof/\n");
+  printf("  ./bench --allocs  Count allocations (build with -DNU_MALLOC=nu_bench_malloc)\n");
+  printf("  ./bench --roofline  Rate bytes/s against measured cache and DRAM bandwidth\n");
+  printf("  ./bench --load 50,90,99  Offered loads for open-loop benchmarks, %% of capacity\n");
   printf("\n");
 }
 
@@ -0,0 +1,134 @@
+/**
+ * nu_histogram Tutorial Example
+ *
+ * This example records simulated request latencies from several worker
+ * threads, each into its own histogram, merges them, and prints a latency
+ * report. It then serializes the result, as a service would to ship its
+ * histogram to a collector.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <nu/histogram.h>
+
+#define WORKERS 4
+#define REQUESTS 250000
+
+/*
+ * Step 1: Choose range and precision
+ *
+ * Latencies are recorded in nanoseconds, from 1 ns up to 10 s, with 3
+ * significant digits: a 1.234 ms request is told apart from 1.236 ms. The
+ * memory needed depends only on these three numbers, never on how many
+ * values are recorded.
+ */
+#define LOWEST 1
+#define HIGHEST (10LL * 1000000000LL)
+#define DIGITS 3
+
+typedef struct {
+  nu_histogram latencies;
+  uint32_t seed;
+} worker_t;
+
+// Simulated latency: mostly ~100us, with a slow tail
+static int64_t
+simulated_latency (uint32_t* seed)
+{
+  *seed = *seed * 1103515245u + 12345u;
+  uint32_t r = (*seed >> 8) % 10000;
+  if (r < 9000)return 80000 + r * 5;           // 80-125 us
+  if (r < 9990)return 500000 + (r - 9000) * 2000;  // 0.5-2.5 ms
+  return 50000000;                               // 50 ms stall
+}
+
+/*
+ * Step 2: Record on each thread without locks
+ *
+ * Each worker owns a histogram, so it uses the plain single-writer
+ * nu_histogram_record(). (Workers could instead share one histogram with
+ * nu_histogram_record_atomic().)
+ */
+static void*
+worker_main (void* arg)
+{
+  worker_t* worker = arg;
+  for (int32_t i = 0; i < REQUESTS; i++) {
+    nu_histogram_record(&worker->latencies, simulated_latency(&worker->seed));
+  }
+  return NULL;
+}
+
+int
+main (void)
+{
+  worker_t workers[WORKERS];
+  pthread_t threads[WORKERS];
+  nu_histogram total;
+
+  if (!nu_histogram_init(&total, LOWEST, HIGHEST, DIGITS)) {
+    fprintf(stderr, "Failed to create histogram\n");
+    return 1;
+  }
+  for (int32_t i = 0; i < WORKERS; i++) {
+    workers[i].seed = (uint32_t)i + 1;
+    if (!nu_histogram_init(&workers[i].latencies, LOWEST, HIGHEST, DIGITS)) {
+      fprintf(stderr, "Failed to create histogram\n");
+      return 1;
+    }
+    pthread_create(&threads[i], NULL, worker_main, &workers[i]);
+  }
+
+  /*
+   * Step 3: Merge
+   *
+   * Histograms with the same configuration merge bucket by bucket, so the
+   * merged percentiles are exactly those of all values recorded.
+   */
+  for (int32_t i = 0; i < WORKERS; i++) {
+    pthread_join(threads[i], NULL);
+    nu_histogram_add(&total, &workers[i].latencies);
+    nu_histogram_free(&workers[i].latencies);
+  }
+
+  /*
+   * Step 4: Query
+   */
+  printf("%llu requests\n", (unsigned long long)nu_histogram_count(&total));
+  printf("  min    %10.3f us\n", (double)nu_histogram_min(&total) / 1e3);
+  printf("  mean   %10.3f us\n", nu_histogram_mean(&total) / 1e3);
+  printf("  stddev %10.3f us\n", nu_histogram_stddev(&total) / 1e3);
+  const double percentiles[] = {50.0, 90.0, 99.0, 99.9, 99.99};
+  for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+    printf("  p%-5g %10.3f us\n", percentiles[i],
+      (double)nu_histogram_value_at_percentile(&total, percentiles[i]) / 1e3);
+  }
+  printf("  max    %10.3f us\n", (double)nu_histogram_max(&total) / 1e3);
+
+  /*
+   * Step 5: Serialize
+   *
+   * nu_histogram_encode() works like snprintf: call it with no buffer to
+   * get the size. Empty buckets are run-length encoded, so the encoding is
+   * usually far smaller than the histogram in memory.
+   */
+  size_t size     = nu_histogram_encode(&total, NULL, 0);
+  uint8_t* buffer = malloc(size);
+  if (buffer) {
+    nu_histogram_encode(&total, buffer, size);
+
+    nu_histogram copy;
+    if (nu_histogram_decode(&copy, buffer, size)) {
+      printf("\nEncoded in %zu bytes (%zu in memory); decoded p99 %.3f us\n",
+        size, total.counts_len * sizeof(uint64_t),
+        (double)nu_histogram_value_at_percentile(&copy, 99.0) / 1e3);
+      nu_histogram_free(&copy);
+    }
+    free(buffer);
+  }
+
+  nu_histogram_free(&total);
+  return 0;
+}
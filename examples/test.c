@@ -6,11 +6,12 @@
  * types provide consistent error handling even in test code.
  *
  * Compile (after installing libnu):
- *   gcc -o test test.c -lnu
+ *   gcc -pthread -o test test.c -lnu
  *   ./test
  */
 
 #include <stdint.h>
+#include <stdatomic.h>
 #include <nu/test.h>
 #include <nu/error.h>
 
@@ -171,6 +172,26 @@ NU_TEST(test_common_patterns) {
   return nu_ok(NULL);
 }
 
+/*
+ * Example 6: Stress Tests
+ *
+ * NU_STRESS_TEST(name, threads, iterations) runs its body on several
+ * threads at once, released together and randomly delayed before each
+ * call, to shake out races in concurrent code. The body sees its `thread`
+ * index and the `iteration`. Build with -pthread; adding
+ * -fsanitize=thread reports races even when the assertions pass.
+ */
+static atomic_int_fast64_t tickets;
+static atomic_bool issued[4 * 10000];
+
+NU_STRESS_TEST(test_tickets_are_unique, 4, 10000) {
+  // Every fetch-and-add hands out a ticket no other thread gets
+  int_fast64_t ticket = atomic_fetch_add(&tickets, 1);
+  NU_ASSERT_LT(ticket, 4 * 10000);
+  NU_ASSERT_FALSE(atomic_exchange(&issued[ticket], true));
+  return nu_ok(NULL);
+}
+
 /*
  * Main Function
  *
@@ -179,6 +200,13 @@ NU_TEST(test_common_patterns) {
  * 2. Reports results (PASS/FAIL)
  * 3. Shows file:line for failures
  * 4. Returns 0 on success, 1 if any test failed
+ *
+ * It also parses the command line: ./test -j 4 runs the tests in four
+ * worker processes, --timeout 10 fails any test taking over 10 seconds,
+ * and --slowest 3 lists the three slowest tests. For CI, --shard 2/4 runs
+ * the second quarter of the tests and --junit report.xml (or --json)
+ * records each test's result and duration. Run ./test --help for all
+ * options.
  */
 NU_TEST_MAIN()
 
@@ -199,14 +227,13 @@ NU_TEST_MAIN()
  * Failed: 1
  *
  * Key Features of nu/test.h:
- * - Zero dynamic allocation
+ * - No dynamic allocation while tests run in-process
  * - Automatic test discovery via __attribute__((constructor))
  * - Tests return nu_result_t for consistent error handling
- * - ~250 lines of readable code you can understand
+ * - Header-only; performance contracts need -lm and stress tests -pthread
  * - No external dependencies
  *
  * Limitations:
- * - Maximum 512 tests per executable
  * - Linux/macOS only (uses constructor attributes)
  * - No fixtures (use static/local variables instead)
  * - No mocking (test real code)
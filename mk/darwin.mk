@@ -57,5 +57,12 @@ TEST_CFLAGS := $(DISTRO_CFLAGS)
 # Test-specific linker flags (includes all libraries needed for tests)
 TEST_LDFLAGS := $(DISTRO_LDFLAGS)
 
+# ld64 has no --wrap, so benchmarks count allocations through NU_MALLOC only
+BENCH_ALLOC_CFLAGS := -DNU_MALLOC=nu_bench_malloc -DNU_FREE=nu_bench_free -DNU_BENCH_TRACK_ALLOCS
+BENCH_ALLOC_LDFLAGS :=
+
+# ld64 has no --wrap, so tests count allocations through NU_MALLOC only
+TEST_ALLOC_FLAGS :=
+
 DEV_PACKAGES := libpng jpeg pkg-config uncrustify ctags
 INSTALL_DEPS_CMD := xcode-select --install; brew install $(DEV_PACKAGES)
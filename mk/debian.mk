@@ -44,5 +44,12 @@ DISTRO_LDFLAGS := -Wl,-z,relro -Wl,-z,now -Wl,-z,noexecstack -Wl,--as-needed -pi
 TEST_CFLAGS := $(DISTRO_CFLAGS)
 TEST_LDFLAGS := $(DISTRO_LDFLAGS)
 
+# benchmarks count allocations by wrapping the system allocator at link time
+BENCH_ALLOC_CFLAGS := -DNU_MALLOC=malloc -DNU_FREE=free -DNU_BENCH_WRAP_MALLOC
+BENCH_ALLOC_LDFLAGS := -Wl,--wrap=malloc -Wl,--wrap=calloc -Wl,--wrap=realloc -Wl,--wrap=free
+
+# sort_test counts allocations by wrapping the system allocator at link time
+TEST_ALLOC_FLAGS := -DTEST_WRAP_MALLOC $(BENCH_ALLOC_LDFLAGS)
+
 DEV_PACKAGES := build-essential libpng-dev libjpeg-dev pkg-config cppcheck uncrustify clang universal-ctags
 INSTALL_DEPS_CMD := sudo apt-get install $(DEV_PACKAGES)
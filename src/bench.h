@@ -1,15 +1,74 @@
 /*
- * nu/bench.h - Minimal benchmarking framework for libnu
+ * nu/bench.h - Benchmarking framework for libnu
  *
- * This framework provides simple performance benchmarking for libnu modules.
- * It measures execution time, handles multiple iterations, and reports statistics.
+ * Benchmarks register themselves and run under NU_BENCH_MAIN(), which
+ * calibrates each one, times it until its statistics are stable, and reports
+ * them as text, JSON or CSV, optionally against a saved baseline and with
+ * hardware counters, allocation counts and sampled profiles.
  *
  * Features:
  * - Automatic benchmark registration via __attribute__((constructor))
  * - Warmup runs to stabilize cache/CPU state
- * - Statistical reporting (min/max/mean)
- * - No dynamic allocation in the framework
- * - ~250 lines of focused benchmarking code
+ * - Automatic batching: the body is repeated until one sample is long enough
+ *   to time accurately, then samples are taken until the mean is known to a
+ *   target relative error or a time budget is spent
+ * - Nanosecond timing from CLOCK_MONOTONIC_RAW, process CPU time, or a
+ *   serialized TSC calibrated to nanoseconds (x86 only)
+ * - Timer overhead measured at startup and subtracted from every sample
+ * - Environment control: --cpu pinning and --mlock, warnings for frequency
+ *   scaling, turbo, SMT and load, and a spin-loop probe around every result
+ *   that flags noisy measurements
+ * - Optional hardware counters (--perf, Linux perf_event_open) read around
+ *   each timed region: cycles, instructions, IPC, branch/cache/TLB misses
+ * - Sampling profiler (--profile <dir>): SIGPROF samples of the timed
+ *   regions, written per benchmark (and per A/B group variant) as folded
+ *   stacks for flame graphs
+ * - Allocation tracking (--allocs, off by default): allocations, bytes and
+ *   peak live bytes per iteration inside timed regions, through
+ *   NU_MALLOC=nu_bench_malloc or by wrapping the system allocator
+ *   (-DNU_BENCH_WRAP_MALLOC with
+ *   -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free);
+ *   nu_bench_record_alloc/nu_bench_record_free count other allocators.
+ *   Until --allocs is given the hooks only test a flag.
+ * - Statistical reporting: median with a bootstrap confidence interval,
+ *   mean/stddev, MAD, p90/p99/p99.9 and Tukey outlier counts
+ * - Multi-threaded benchmarks (NU_BENCH_MT) run on pinned threads released
+ *   together, reporting aggregate throughput, per-thread latency and scaling
+ *   efficiency across thread counts
+ * - Fixtures (NU_BENCH_SETUP/RESET/TEARDOWN) run outside the timed region,
+ *   NU_BENCH_PAUSE/RESUME for multi-phase bodies, and optimization barriers
+ *   (nu_bench_do_not_optimize, nu_bench_clobber)
+ * - Cold-cache mode (--cache=cold|both): caches are evicted before every
+ *   invocation by clflush over registered regions or by streaming over a
+ *   buffer larger than the LLC, optionally with a TLB-flush approximation
+ * - Roofline calibration (--roofline): L1/L2/L3/DRAM latency and read/write/
+ *   copy bandwidth measured at startup and stored in the report, with each
+ *   result's bytes/s given as a fraction of the bandwidth of the level its
+ *   data fits in
+ * - Parameter sweeps (NU_BENCH_PARAM) with items/s, bytes/s and a fitted
+ *   complexity across the sweep
+ * - A/B groups (NU_BENCH_GROUP): variants run interleaved in a randomized
+ *   order on one shared input, reported relative to a baseline variant with
+ *   Mann-Whitney significance markers
+ * - Open-loop benchmarks (NU_BENCH_OPEN_LOOP): operations issued at a fixed
+ *   rate, latency measured from the scheduled start (correcting coordinated
+ *   omission), swept over offered load up to saturation
+ * - Process isolation (--isolate): each benchmark runs in a forked child
+ *   that reports back over a pipe, with a per-benchmark timeout, so results
+ *   do not depend on run order and a crash loses one benchmark; and
+ *   --repetitions to run the suite several times
+ * - JSON/CSV output with per-sample data and environment metadata, and
+ *   --baseline comparison (Mann-Whitney U) that fails on regressions
+ * - Constant memory per benchmark: every sample goes into an HDR histogram
+ *   (nu/histogram.h) and a fixed-size reservoir, so runs of millions of
+ *   samples keep exact percentiles to 3 significant digits
+ * - No dynamic allocation while benchmarks are being timed
+ *
+ * Linking: the framework is this header alone, but it sorts samples with
+ * nu_sort and records them in a nu_histogram, so benchmarks link against
+ * libnu and need libm and pthreads; -rdynamic lets --profile name the
+ * benchmark's own functions:
+ *   cc -std=c17 -D_DEFAULT_SOURCE -pthread -rdynamic my_bench.c -lnu -lm
  *
  * Usage:
  *   #include <nu/bench.h>
@@ -22,6 +81,29 @@
  *     NU_BENCH_END();
  *   }
  *
+ *   NU_BENCH_PARAM(sort_sweep, NU_BENCH_POW2(4, 20)) {
+ *     size_t n = (size_t)param;
+ *     // setup...
+ *     nu_bench_set_items(n);
+ *     NU_BENCH_START();
+ *     sort(arr, n);
+ *     NU_BENCH_END();
+ *   }
+ *
+ *   // Fixtures: fill a pristine input once, copy it before every invocation
+ *   NU_BENCH_SETUP(sort_sweep) { pristine = make_input(param); }
+ *   NU_BENCH_RESET(sort_sweep) { memcpy(arr, pristine, param * sizeof(int)); }
+ *   NU_BENCH_TEARDOWN(sort_sweep) { free(pristine); }
+ *
+ *   // A/B comparison: the group body generates the input shared by variants
+ *   NU_BENCH_GROUP(sort_ab, NU_BENCH_POW2(10, 16)) { pristine = make_input(param); }
+ *   NU_BENCH_RESET(sort_ab) { memcpy(arr, pristine, param * sizeof(int)); }
+ *   NU_BENCH_BASELINE(sort_ab, qsort) { NU_BENCH_START(); qsort(...); NU_BENCH_END(); }
+ *   NU_BENCH_VARIANT(sort_ab, nu_sort) { NU_BENCH_START(); nu_sort(...); NU_BENCH_END(); }
+ *
+ *   // Open loop: one operation per call, latency under increasing load
+ *   NU_BENCH_OPEN_LOOP(queue_push) { queue_push(q, item); }
+ *
  *   NU_BENCH_MAIN()
  */
 
@@ -34,7 +116,73 @@
 #include <stdbool.h>
 #include <string.h>
 #include <float.h>
+#include <math.h>
 #include <stdint.h>
+#include <inttypes.h>
+#include <errno.h>
+
+#include <unistd.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/utsname.h>
+#include <sys/wait.h>
+#ifdef __APPLE__
+#include <sys/sysctl.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#define NU_BENCH_HAVE_PERF 1
+#else
+#define NU_BENCH_HAVE_PERF 0
+#endif
+
+// Sampling profiler: SIGPROF plus backtrace(), named by backtrace_symbols()
+#include <signal.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#if defined(__GLIBC__) || defined(__APPLE__)
+#include <execinfo.h>
+#define NU_BENCH_HAVE_PROFILE 1
+#else
+#define NU_BENCH_HAVE_PROFILE 0
+#endif
+
+#include "sort.h"
+#include "histogram.h"
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#endif
+
+// Build metadata recorded in machine-readable reports; the Makefile bench
+// rule defines these, other builds may pass their own
+#ifndef NU_BENCH_GIT_REV
+#define NU_BENCH_GIT_REV "unknown"
+#endif
+#ifndef NU_BENCH_CFLAGS
+#define NU_BENCH_CFLAGS "unknown"
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#include <cpuid.h>
+#define NU_BENCH_HAVE_TSC 1
+#else
+#define NU_BENCH_HAVE_TSC 0
+#endif
+
+#ifdef CLOCK_MONOTONIC_RAW
+#define NU_BENCH_CLOCK_MONOTONIC CLOCK_MONOTONIC_RAW
+#else
+#define NU_BENCH_CLOCK_MONOTONIC CLOCK_MONOTONIC
+#endif
 
 /* For internal library builds, use NU_MALLOC/NU_FREE macros if defined */
 /* For end users, use standard malloc/free */
@@ -47,16 +195,150 @@ extern void NU_FREE(void* ptr);
 #define NU_FREE free
 #endif
 
-// Benchmark function signature
+// Time source used for NU_BENCH_START/NU_BENCH_END
+typedef enum {
+  NU_BENCH_CLOCK_WALL,  // CLOCK_MONOTONIC_RAW - elapsed wall time
+  NU_BENCH_CLOCK_CPU,   // CLOCK_PROCESS_CPUTIME_ID - CPU time consumed by the process
+  NU_BENCH_CLOCK_TSC,   // Serialized rdtsc/rdtscp, calibrated to ns at startup
+} nu_bench_clock_t;
+
+// Cache state each invocation starts from
+typedef enum {
+  NU_BENCH_CACHE_HOT,   // Warmed up; data left in cache by the previous run
+  NU_BENCH_CACHE_COLD,  // Evicted before every invocation
+  NU_BENCH_CACHE_BOTH,  // Hot then cold, reported side by side
+} nu_bench_cache_t;
+
+// Result output format
+typedef enum {
+  NU_BENCH_FORMAT_TEXT,
+  NU_BENCH_FORMAT_JSON,
+  NU_BENCH_FORMAT_CSV,
+} nu_bench_format_t;
+
+// Samples of one benchmark loaded from a --baseline file
+typedef struct {
+  char name[128];
+  double* samples;
+  size_t count;
+  size_t capacity;
+} nu_bench_baseline_t;
+
+// One level of the memory hierarchy measured by --roofline
+typedef struct {
+  const char* name;          // "L1", "L2", "L3" or "DRAM"
+  size_t size;               // Capacity in bytes, 0 for DRAM
+  size_t working_set;        // Buffer the measurements ran over
+  double latency_ns;         // Dependent load, by pointer chasing
+  double read_bw;            // Streaming bandwidth in bytes/s
+  double write_bw;
+  double copy_bw;            // Bytes read plus bytes written, as STREAM counts
+} nu_bench_roofline_t;
+
+// Benchmark function signatures
 typedef void (* nu_bench_fn)(void);
+typedef void (* nu_bench_param_fn)(int64_t param);
+typedef void (* nu_bench_mt_fn)(int32_t thread, int32_t threads);
+
+// Parameter sweep for NU_BENCH_PARAM: either an explicit list of values or
+// a geometric range lo, lo*mult, lo*mult^2, ... up to hi
+#define NU_BENCH_MAX_PARAMS 64
+
+typedef struct {
+  int64_t values[NU_BENCH_MAX_PARAMS];
+  size_t count;
+  int64_t lo;
+  int64_t hi;
+  int64_t mult;
+} nu_bench_params_t;
+
+// Variant of an NU_BENCH_GROUP
+#define NU_BENCH_MAX_VARIANTS 8
+
+typedef struct {
+  const char* name;
+  nu_bench_param_fn fn;
+} nu_bench_variant_t;
 
 // Benchmark registration entry
 typedef struct {
   const char* name;
   nu_bench_fn fn;
   double last_time;  // Last recorded time for current benchmark
+
+  // Parameterized and multi-threaded benchmarks (fn NULL)
+  nu_bench_param_fn param_fn;
+  nu_bench_mt_fn mt_fn;
+
+  // Fixtures, called with the current param (0 for plain benchmarks).
+  // setup/teardown run once per result, reset before every invocation.
+  nu_bench_param_fn setup;
+  nu_bench_param_fn reset;
+  nu_bench_param_fn teardown;
+  int64_t params[NU_BENCH_MAX_PARAMS];
+  size_t param_count;
+
+  // Groups (NU_BENCH_GROUP): variants measured interleaved on the input
+  // prepared by the group's setup
+  bool group;
+  nu_bench_variant_t variants[NU_BENCH_MAX_VARIANTS];
+  int32_t variant_count;
+  int32_t baseline_variant;  // -1 = the first variant
+
+  // Open-loop benchmarks (NU_BENCH_OPEN_LOOP): fn is one operation, issued
+  // on a fixed schedule
+  bool open_loop;
 } nu_bench_entry_t;
 
+// Hardware events counted by --perf, in perf group order
+typedef enum {
+  NU_BENCH_PERF_CYCLES,
+  NU_BENCH_PERF_INSTRUCTIONS,
+  NU_BENCH_PERF_BRANCH_MISSES,
+  NU_BENCH_PERF_L1D_MISSES,
+  NU_BENCH_PERF_LLC_MISSES,
+  NU_BENCH_PERF_DTLB_MISSES,
+  NU_BENCH_PERF_COUNT,
+} nu_bench_perf_event_t;
+
+// Growth rates considered when fitting a parameter sweep
+typedef enum {
+  NU_BENCH_O_1,
+  NU_BENCH_O_LOG_N,
+  NU_BENCH_O_N,
+  NU_BENCH_O_N_LOG_N,
+  NU_BENCH_O_N2,
+  NU_BENCH_O_N3,
+  NU_BENCH_O_COUNT,
+} nu_bench_complexity_t;
+
+// Per-thread timing context. NU_BENCH_START/NU_BENCH_END and the
+// nu_bench_set_* calls only touch the calling thread's copy, so bodies can
+// run on several threads at once.
+typedef struct {
+  uint64_t start_ticks;
+  double region_ns;          // Timed-region total for the current batch
+  bool perf_counting;        // Counters are read around regions (main thread)
+  uint64_t items;
+  uint64_t bytes;
+
+  // Allocation tracking, counted only between NU_BENCH_START and NU_BENCH_END
+  bool in_region;
+  uint64_t allocs;
+  uint64_t alloc_bytes;      // Bytes requested
+  int64_t live_bytes;        // Usable bytes live since the invocation began
+  int64_t peak_bytes;        // Highest live_bytes of any invocation
+} nu_bench_local_t;
+
+static _Thread_local nu_bench_local_t nu_bench_local;
+
+#define NU_BENCH_MAX_THREADS 256
+
+// Samples retained for statistics that need raw values (MAD, bootstrap,
+// outliers, Mann-Whitney, per-sample output); the rest are counted in the
+// histogram only
+#define NU_BENCH_RESERVOIR 10000
+
 // Global benchmark state
 static struct {
   nu_bench_entry_t benches[128];  // Max 128 benchmarks per file
@@ -64,205 +346,4325 @@ static struct {
 
   // Current benchmark being run
   int32_t current_bench;
-  size_t current_iteration;
-  size_t total_iterations;
+  int64_t current_param;
+  uint64_t items;            // Per-invocation work set by nu_bench_set_items()
+  uint64_t bytes;            // Per-invocation work set by nu_bench_set_bytes()
+  int32_t current_threads;   // Thread count of an NU_BENCH_MT run, else 0
+  size_t current_iteration;  // Invocations of the body so far
+  size_t total_iterations;   // Fixed sample count from -n, 0 = adaptive
   size_t warmup_runs;
+  size_t batch;              // Body invocations per sample
+  nu_bench_param_fn variant; // Group variant being invoked, else NULL
+
+  // Timing data for current benchmark, in nanoseconds per invocation.
+  // All samples are recorded into the histogram (in picoseconds) and the
+  // running mean; times holds a uniform random subset once more than
+  // NU_BENCH_RESERVOIR samples have been taken.
+  nu_histogram histogram;
+  double times[NU_BENCH_RESERVOIR];
+  size_t time_count;         // Samples held in times
+  size_t time_seen;          // Samples taken
+  double time_mean;          // Welford running mean and M2 of all samples
+  double time_m2;
+  uint64_t reservoir_seed;
+
+  // Timer calibration
+  double ns_per_tick;       // Only meaningful for NU_BENCH_CLOCK_TSC
+  double timer_overhead;    // Cost of an empty START/END pair, in ns
+
+  // Hardware counters. Each event's fd is -1 if it could not be opened;
+  // counts are only accumulated while samples are being collected.
+  bool perf;                 // --perf requested and the group is open
+  int perf_fd[NU_BENCH_PERF_COUNT];
+  int32_t perf_slot[NU_BENCH_PERF_COUNT];  // Position in the group read
+  size_t perf_members;
+  uint64_t perf_start[NU_BENCH_PERF_COUNT + 3];
+  double perf_total[NU_BENCH_PERF_COUNT];
+  double perf_enabled;       // Multiplexing: time enabled vs. running
+  double perf_running;
+  size_t perf_iterations;    // Body invocations the totals cover
+
+  // Sampling profiler: folded stacks per result are written here
+  const char* profile_dir;
+
+  // Comparison of the group variant being reported with the group's
+  // baseline (variant_name is NULL outside groups)
+  const char* variant_name;
+  int32_t variant_index;     // Position of the variant in its group
+  bool variant_is_baseline;
+  double variant_speedup;    // Baseline median / variant median
+  double variant_p;          // Mann-Whitney p-value against the baseline
+
+  // Allocation tracking (--allocs), per invocation of the current result
+  bool allocs;
+  double allocs_per_iteration;
+  double alloc_bytes_per_iteration;
+  int64_t alloc_peak_bytes;
+
+  // Multi-threaded runs
+  int32_t threads[32];       // Thread counts from --threads, 0 = powers of 2
+  size_t thread_runs;
+  double mt_throughput;      // Aggregate invocations/s of the current run
+  double mt_efficiency;      // Throughput per thread relative to the first run
+
+  // Open-loop runs. Offered loads are fractions of the closed-loop capacity
+  // measured first; open_offered is 0 outside open-loop runs.
+  double loads[16];          // From --load, empty = default sweep
+  size_t load_count;
+  double open_capacity;      // Closed-loop operations/s
+  double open_offered;       // Operations/s scheduled at the current point
+  double open_achieved;      // Operations/s completed
+  double open_service;       // Mean service time in ns, queueing excluded
+  bool open_saturated;       // Completions fell behind the schedule
+
+  // Cold-cache runs. Regions registered by the benchmark are flushed line by
+  // line; otherwise an eviction buffer larger than the LLC is streamed over.
+  nu_bench_cache_t cache;
+  bool cold;                 // The current collection evicts caches
+  bool tlb_flush;            // Also touch one line per page of a large buffer
+  struct {
+    const char* ptr;
+    size_t size;
+  } cache_regions[16];
+  int32_t cache_region_count;
+  unsigned char* evict;
+  size_t evict_size;
 
-  // Timing data for current benchmark
-  double times[1000];  // Support up to 1000 iterations
-  size_t time_count;
-  clock_t start_time;
+  // Memory hierarchy measured at startup (--roofline), smallest level first
+  bool roofline;
+  nu_bench_roofline_t levels[4];
+  int32_t level_count;
+
+  // Environment control and noise detection
+  int32_t cpus[NU_BENCH_MAX_THREADS];  // CPUs usable at startup, before --cpu
+  int32_t cpu_count;
+  int32_t cpu;               // --cpu: pin the main thread here, -1 = unpinned
+  bool mlock;
+  char warnings[8][192];     // Environment problems found at startup
+  int32_t warning_count;
+  double probe_ns;           // Spin-probe reference time measured at startup
+  double noise;              // Worst probe deviation around the current result
+  double noise_threshold;
+  int32_t noisy;
+
+  // Process isolation (--isolate): each benchmark runs in a forked child
+  bool isolate;
+  double timeout;      // Seconds before an isolated child is killed, 0 = never
+  int32_t failed;      // Isolated children that crashed or timed out
+  int32_t repetitions; // Runs of every benchmark (--repetitions)
+  int32_t repetition;  // Current run, from 0
 
   // Configuration
   bool verbose;
   const char* filter;  // Run only benchmarks matching this
+  nu_bench_clock_t clock;
+  double sample_time;  // Target timed duration of one sample, in ns
+  double time_budget;  // Wall-clock budget per benchmark, in ns
+  double rel_error;    // Stop early once stderr/mean drops below this
+  size_t min_samples;
+
+  // Reporting
+  nu_bench_format_t format;
+  FILE* out;           // Machine-readable results (--output, default stdout)
+  FILE* log;           // Human-readable progress; stderr if out is stdout
+  int32_t reported;
+
+  // Baseline comparison
+  nu_bench_baseline_t baseline[128];
+  int32_t baseline_count;
+  double alpha;        // Significance level of the Mann-Whitney test
+  double threshold;    // Smallest relative change worth flagging
+  int32_t regressions;
 } nu_bench_state = {
-  .total_iterations = 100,
+  .total_iterations = 0,
   .warmup_runs      = 5,
-  .verbose          = false
+  .verbose          = false,
+  .ns_per_tick      = 1.0,
+  .clock            = NU_BENCH_CLOCK_WALL,
+  .sample_time      = 1e6,
+  .time_budget      = 1e9,
+  .rel_error        = 0.01,
+  .min_samples      = 10,
+  .format           = NU_BENCH_FORMAT_TEXT,
+  .alpha            = 0.01,
+  .threshold        = 0.05,
+  .cpu              = -1,
+  .noise_threshold  = 0.05,
+  .timeout          = 300.0,
+  .repetitions      = 1,
 };
 
-// Register a benchmark
+// Usable size of a heap block, so frees can be matched to allocations
+static inline size_t
+nu_bench_usable_size (void* ptr)
+{
+#if defined(__GLIBC__)
+  return malloc_usable_size(ptr);
+#elif defined(__APPLE__)
+  return malloc_size(ptr);
+#else
+  (void)ptr;
+  return 0;
+#endif
+}
+
+// Whether allocations are being counted right now; lets callers skip
+// working out a block's usable size when they are not
+static inline bool
+nu_bench_counting_allocs (void)
+{
+  return nu_bench_local.in_region && nu_bench_state.allocs;
+}
+
+// Count an allocation of `size` bytes in a block of `usable` bytes. For
+// allocators the hooks below cannot see, such as ones loaded with dlopen.
 static inline void
-nu_bench_register_impl (
-  const char* name,
-  nu_bench_fn fn)
+nu_bench_record_alloc (
+  size_t size,
+  size_t usable)
 {
-  if (nu_bench_state.count >= 128) {
-    fprintf(stderr, "ERROR: Too many benchmarks registered (max 128)\n");
-    exit(1);
+  if (nu_bench_counting_allocs()) {
+    nu_bench_local.allocs++;
+    nu_bench_local.alloc_bytes += size;
+    nu_bench_local.live_bytes  += (int64_t)usable;
+    if (nu_bench_local.live_bytes > nu_bench_local.peak_bytes) {
+      nu_bench_local.peak_bytes = nu_bench_local.live_bytes;
+    }
   }
-  nu_bench_state.benches[nu_bench_state.count].name = name;
-  nu_bench_state.benches[nu_bench_state.count].fn   = fn;
-  nu_bench_state.count++;
 }
 
-// Define and register a benchmark
-#define NU_BENCH(name) \
-        static void nu_bench_ ## name(void); \
-        __attribute__((constructor(300))) \
-        static void nu_bench_register_ ## name(void) { \
-          nu_bench_register_impl(#name, nu_bench_ ## name); \
-        } \
-        static void nu_bench_ ## name(void)
+// Count the release of a block of `usable` bytes
+static inline void
+nu_bench_record_free (size_t usable)
+{
+  if (nu_bench_counting_allocs()) {
+    nu_bench_local.live_bytes -= (int64_t)usable;
+  }
+}
 
-// Start timing
-#define NU_BENCH_START() \
-        nu_bench_state.start_time = clock()
+static inline void
+nu_bench_count_alloc (
+  void* ptr,
+  size_t size)
+{
+  if (ptr && nu_bench_counting_allocs()) {
+    nu_bench_record_alloc(size, nu_bench_usable_size(ptr));
+  }
+}
 
-// End timing and record
-#define NU_BENCH_END() \
-        do { \
-          clock_t end    = clock(); \
-          double elapsed = ((double)(end - nu_bench_state.start_time)) / CLOCKS_PER_SEC; \
-          if (nu_bench_state.current_iteration >= nu_bench_state.warmup_runs) { \
-            nu_bench_state.times[nu_bench_state.time_count++] = elapsed; \
-          } \
-        } while (0)
+static inline void
+nu_bench_count_free (void* ptr)
+{
+  if (ptr && nu_bench_counting_allocs()) {
+    nu_bench_record_free(nu_bench_usable_size(ptr));
+  }
+}
 
-// Helper for array setup
-#define NU_BENCH_ARRAY_SETUP(type, arr, size, init_expr) \
-        type* arr = NU_MALLOC((size) * sizeof(type)); \
-        if (!arr) { \
-          fprintf(stderr, "Benchmark allocation failed\n"); \
-          exit(1); \
-        } \
-        for (size_t i = 0; i < (size); i++) { \
-          arr[i] = (init_expr); \
-        }
+// Allocator hooks for code built with -DNU_MALLOC=nu_bench_malloc
+// -DNU_FREE=nu_bench_free. Weak, so several translation units may include
+// this header.
+void* nu_bench_malloc(size_t size);
+void nu_bench_free(void* ptr);
 
-#define NU_BENCH_ARRAY_CLEANUP(arr) \
-        NU_FREE(arr)
+__attribute__((weak)) void*
+nu_bench_malloc (size_t size)
+{
+  void* ptr = malloc(size);
+#ifndef NU_BENCH_WRAP_MALLOC
+  nu_bench_count_alloc(ptr, size);
+#endif
+  return ptr;
+}
 
-// Calculate statistics for current benchmark
-static inline void
-nu_bench_calculate_stats (
-  double* min,
-  double* max,
-  double* mean,
-  double* median)
+__attribute__((weak)) void
+nu_bench_free (void* ptr)
 {
-  if (nu_bench_state.time_count == 0) {
-    *min = *max = *mean = *median = 0.0;
-    return;
+#ifndef NU_BENCH_WRAP_MALLOC
+  nu_bench_count_free(ptr);
+#endif
+  free(ptr);
+}
+
+// System allocator wrappers, for binaries linked with
+// -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free. Only calls
+// from the objects being linked are redirected, not those inside libc.
+#ifdef NU_BENCH_WRAP_MALLOC
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+void* __wrap_malloc(size_t size);
+void* __wrap_calloc(size_t count, size_t size);
+void* __wrap_realloc(void* ptr, size_t size);
+void __wrap_free(void* ptr);
+
+__attribute__((weak)) void*
+__wrap_malloc (size_t size)
+{
+  void* ptr = __real_malloc(size);
+  nu_bench_count_alloc(ptr, size);
+  return ptr;
+}
+
+__attribute__((weak)) void*
+__wrap_calloc (
+  size_t count,
+  size_t size)
+{
+  if (size != 0 && count > SIZE_MAX / size) {
+    errno = ENOMEM;
+    return NULL;
   }
+  void* ptr = __real_calloc(count, size);
+  nu_bench_count_alloc(ptr, count * size);
+  return ptr;
+}
 
-  *min = DBL_MAX;
-  *max = 0.0;
-  double sum = 0.0;
+__attribute__((weak)) void*
+__wrap_realloc (
+  void* ptr,
+  size_t size)
+{
+  bool counted  = nu_bench_counting_allocs();
+  size_t old    = counted && ptr ? nu_bench_usable_size(ptr) : 0;
+  void* resized = __real_realloc(ptr, size);
+  if (resized && counted) {
+    nu_bench_local.live_bytes -= (int64_t)old;
+    nu_bench_count_alloc(resized, size);
+  }
+  return resized;
+}
 
-  // Calculate min, max, sum
-  for (size_t i = 0; i < nu_bench_state.time_count; i++) {
-    double t = nu_bench_state.times[i];
-    if (t < *min)*min = t;
-    if (t > *max)*max = t;
-    sum += t;
+__attribute__((weak)) void
+__wrap_free (void* ptr)
+{
+  nu_bench_count_free(ptr);
+  __real_free(ptr);
+}
+#endif
+
+// Read a POSIX clock as nanoseconds
+static inline uint64_t
+nu_bench_clock_ns (clockid_t id)
+{
+  struct timespec ts;
+  clock_gettime(id, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Read the timer at the start of a timed region. The TSC read is fenced so
+// that earlier instructions retire before it and later ones cannot start
+// ahead of it.
+static inline uint64_t
+nu_bench_ticks_begin (void)
+{
+#if NU_BENCH_HAVE_TSC
+  if (nu_bench_state.clock == NU_BENCH_CLOCK_TSC) {
+    _mm_lfence();
+    uint64_t t = __rdtsc();
+    _mm_lfence();
+    return t;
+  }
+#endif
+  if (nu_bench_state.clock == NU_BENCH_CLOCK_CPU) {
+    return nu_bench_clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+  }
+  return nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC);
+}
+
+// Read the timer at the end of a timed region. rdtscp waits for the timed
+// code to finish; the trailing fence keeps later code out of the region.
+static inline uint64_t
+nu_bench_ticks_end (void)
+{
+#if NU_BENCH_HAVE_TSC
+  if (nu_bench_state.clock == NU_BENCH_CLOCK_TSC) {
+    uint32_t aux;
+    uint64_t t = __rdtscp(&aux);
+    _mm_lfence();
+    return t;
+  }
+#endif
+  if (nu_bench_state.clock == NU_BENCH_CLOCK_CPU) {
+    return nu_bench_clock_ns(CLOCK_PROCESS_CPUTIME_ID);
   }
+  return nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC);
+}
 
-  *mean = sum / (double)nu_bench_state.time_count;
+// Convert a tick delta to nanoseconds
+static inline double
+nu_bench_ticks_to_ns (uint64_t ticks)
+{
+  return (double)ticks * nu_bench_state.ns_per_tick;
+}
 
-  // Simple median (would need to sort for true median)
-  // For now, just use mean as approximation
-  *median = *mean;
+// Check for an invariant TSC (constant rate across P-states and C-states)
+static inline bool
+nu_bench_tsc_usable (void)
+{
+#if NU_BENCH_HAVE_TSC
+  uint32_t eax, ebx, ecx, edx;
+  if (!__get_cpuid(0x80000001u, &eax, &ebx, &ecx, &edx) || !(edx & (1u << 27))) {
+    return false;  // No rdtscp
+  }
+  if (!__get_cpuid(0x80000007u, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  return (edx & (1u << 8)) != 0;
+#else
+  return false;
+#endif
 }
 
-// Run a single benchmark
+// Calibrate the TSC against CLOCK_MONOTONIC_RAW over ~50ms
 static inline void
-nu_bench_run_one (int32_t idx)
+nu_bench_calibrate_tsc (void)
 {
-  nu_bench_entry_t* bench = &nu_bench_state.benches[idx];
+  uint64_t ns0    = nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC);
+  uint64_t ticks0 = nu_bench_ticks_begin();
+  uint64_t ns1    = ns0;
+  while (ns1 - ns0 < 50000000u) {
+    ns1 = nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC);
+  }
+  uint64_t ticks1 = nu_bench_ticks_end();
 
-  // Reset timing data
-  nu_bench_state.current_bench = idx;
-  nu_bench_state.time_count    = 0;
+  nu_bench_state.ns_per_tick = (double)(ns1 - ns0) / (double)(ticks1 - ticks0);
+}
+
+// Measure the cost of an empty timed region. The minimum over many pairs is
+// used so that the subtraction never removes time the code actually spent.
+static inline void
+nu_bench_calibrate_overhead (void)
+{
+  double best = DBL_MAX;
+  for (int32_t i = 0; i < 10000; i++) {
+    uint64_t t0 = nu_bench_ticks_begin();
+    uint64_t t1 = nu_bench_ticks_end();
+    double ns   = nu_bench_ticks_to_ns(t1 - t0);
+    if (ns < best)best = ns;
+  }
+  nu_bench_state.timer_overhead = best;
+}
 
-  // Run warmup + actual iterations
-  size_t total_runs = nu_bench_state.warmup_runs + nu_bench_state.total_iterations;
+// Fixed amount of dependent integer work; its time only changes when the CPU
+// is shared, throttled or running at a different frequency
+static volatile uint64_t nu_bench_probe_sink;
 
-  for (size_t i = 0; i < total_runs; i++) {
-    nu_bench_state.current_iteration = i;
-    bench->fn();
+static inline double
+nu_bench_spin_probe (void)
+{
+  double best = DBL_MAX;
+  for (int32_t r = 0; r < 3; r++) {
+    uint64_t t0 = nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC);
+    uint64_t x  = 88172645463325252ULL;
+    for (int32_t i = 0; i < (1 << 18); i++) {
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+    }
+    nu_bench_probe_sink = x;
+    best = fmin(best, (double)(nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC) - t0));
   }
+  return best;
+}
 
-  // Calculate and display stats
-  double min, max, mean, median;
-  nu_bench_calculate_stats(&min, &max, &mean, &median);
+// Relative deviation of the probe from the startup reference
+static inline double
+nu_bench_probe_noise (void)
+{
+  if (nu_bench_state.probe_ns <= 0.0) {
+    return 0.0;
+  }
+  return fabs(nu_bench_spin_probe() / nu_bench_state.probe_ns - 1.0);
+}
 
-  // Format time with proper padding (12 chars total for time + unit)
-  char time_buf[32];
-  if (mean < 0.001) {
-    snprintf(time_buf, sizeof(time_buf), "%9.3f μs", mean * 1000000);
-  } else if (mean < 1.0) {
-    snprintf(time_buf, sizeof(time_buf), "%9.3f ms", mean * 1000);
-  } else {
-    snprintf(time_buf, sizeof(time_buf), "%9.3f s", mean);
+// CPUs this process may run on, in ascending order; returns the count
+static inline int32_t
+nu_bench_allowed_cpus (
+  int32_t* cpus,
+  int32_t max)
+{
+  int32_t count = 0;
+#ifdef __linux__
+  unsigned long mask[16] = {0};
+  long bytes = syscall(SYS_sched_getaffinity, 0, sizeof(mask), mask);
+  int32_t bits = (int32_t)(8 * sizeof(unsigned long));
+  for (int32_t cpu = 0; bytes > 0 && cpu < (int32_t)bytes * 8 && count < max; cpu++) {
+    if (mask[cpu / bits] & (1UL << (cpu % bits))) {
+      cpus[count++] = cpu;
+    }
+  }
+#endif
+  if (count == 0) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int32_t cpu = 0; cpu < (online > 0 ? online : 1) && count < max; cpu++) {
+      cpus[count++] = cpu;
+    }
   }
+  return count;
+}
 
-  printf("  %s  %s", time_buf, bench->name);
+// Pin the calling thread to one CPU; a no-op where affinity is unsupported
+static inline bool
+nu_bench_pin_thread (int32_t cpu)
+{
+#ifdef __linux__
+  unsigned long mask[16] = {0};
+  int32_t bits = (int32_t)(8 * sizeof(unsigned long));
+  if (cpu < 0 || cpu >= (int32_t)sizeof(mask) * 8) {
+    return false;
+  }
+  mask[cpu / bits] |= 1UL << (cpu % bits);
+  return syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask) == 0;
+#else
+  (void)cpu;
+  return false;
+#endif
+}
 
-  if (nu_bench_state.verbose) {
-    printf(" (min: %.3fs, max: %.3fs, %zu iterations)",
-      min, max, nu_bench_state.total_iterations);
+// Set up the selected clock; falls back to wall time if the TSC is unusable
+static inline void
+nu_bench_init_clock (void)
+{
+  nu_bench_state.ns_per_tick = 1.0;
+
+  if (nu_bench_state.clock == NU_BENCH_CLOCK_TSC) {
+    if (nu_bench_tsc_usable()) {
+      nu_bench_calibrate_tsc();
+    } else {
+      fprintf(stderr, "WARNING: invariant TSC not available, using wall clock\n");
+      nu_bench_state.clock = NU_BENCH_CLOCK_WALL;
+    }
   }
 
-  printf("\n");
+  nu_bench_calibrate_overhead();
 }
 
-// Run all benchmarks
+static inline const char*
+nu_bench_clock_name (nu_bench_clock_t clock)
+{
+  switch (clock) {
+    case NU_BENCH_CLOCK_CPU: return "cpu (CLOCK_PROCESS_CPUTIME_ID)";
+    case NU_BENCH_CLOCK_TSC: return "tsc (rdtscp)";
+    case NU_BENCH_CLOCK_WALL:
+    default:                 return "wall (CLOCK_MONOTONIC_RAW)";
+  }
+}
+
+static inline const char*
+nu_bench_perf_name (nu_bench_perf_event_t event)
+{
+  switch (event) {
+    case NU_BENCH_PERF_CYCLES:        return "cycles";
+    case NU_BENCH_PERF_INSTRUCTIONS:  return "instructions";
+    case NU_BENCH_PERF_BRANCH_MISSES: return "branch_misses";
+    case NU_BENCH_PERF_L1D_MISSES:    return "l1d_misses";
+    case NU_BENCH_PERF_LLC_MISSES:    return "llc_misses";
+    case NU_BENCH_PERF_DTLB_MISSES:   return "dtlb_misses";
+    case NU_BENCH_PERF_COUNT:
+    default:                          return "unknown";
+  }
+}
+
+#if NU_BENCH_HAVE_PERF
 static inline int
-nu_bench_run_all (
-  int32_t argc,
-  char** argv)
+nu_bench_perf_open_event (
+  uint32_t type,
+  uint64_t config,
+  int group)
 {
-  // Parse simple command line args
-  for (int32_t i = 1; i < argc; i++) {
-    if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--verbose") == 0) {
-      nu_bench_state.verbose = true;
-    } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
-      nu_bench_state.total_iterations = (size_t)atoi(argv[++i]);
-    } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
-      nu_bench_state.warmup_runs = (size_t)atoi(argv[++i]);
-    } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
-      nu_bench_state.filter = argv[++i];
-    } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
-      printf("Usage: %s [options]\n", argv[0]);
-      printf("Options:\n");
-      printf("  -v, --verbose    Show detailed statistics\n");
-      printf("  -n <iterations>  Number of iterations (default: 100)\n");
-      printf("  -w <warmups>     Number of warmup runs (default: 5)\n");
-      printf("  -f <filter>      Run only benchmarks containing this string\n");
-      printf("  -h, --help       Show this help\n");
-      return 0;
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size           = sizeof(attr);
+  attr.type           = type;
+  attr.config         = config;
+  attr.disabled       = group == -1 ? 1 : 0;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv     = 1;
+  attr.read_format    = PERF_FORMAT_GROUP
+                        | PERF_FORMAT_TOTAL_TIME_ENABLED
+                        | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+// Open the counter group; cycles leads, other events join if the PMU has them
+static inline bool
+nu_bench_perf_open (void)
+{
+  #define NU_BENCH_CACHE_MISS(cache) \
+          ((uint64_t)(cache) | ((uint64_t)PERF_COUNT_HW_CACHE_OP_READ << 8) \
+           | ((uint64_t)PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+  static const struct {
+    uint32_t type;
+    uint64_t config;
+  } events[NU_BENCH_PERF_COUNT] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HW_CACHE, NU_BENCH_CACHE_MISS(PERF_COUNT_HW_CACHE_L1D)},
+    {PERF_TYPE_HW_CACHE, NU_BENCH_CACHE_MISS(PERF_COUNT_HW_CACHE_LL)},
+    {PERF_TYPE_HW_CACHE, NU_BENCH_CACHE_MISS(PERF_COUNT_HW_CACHE_DTLB)},
+  };
+  #undef NU_BENCH_CACHE_MISS
+
+  nu_bench_state.perf_members = 0;
+  for (int32_t e = 0; e < NU_BENCH_PERF_COUNT; e++) {
+    int leader = e == 0 ? -1 : nu_bench_state.perf_fd[0];
+    nu_bench_state.perf_fd[e]   = nu_bench_perf_open_event(events[e].type, events[e].config, leader);
+    nu_bench_state.perf_slot[e] = -1;
+    if (nu_bench_state.perf_fd[e] >= 0) {
+      nu_bench_state.perf_slot[e] = (int32_t)nu_bench_state.perf_members++;
+    } else if (e == 0) {
+      fprintf(stderr, "WARNING: hardware counters unavailable (%s), timing only\n", strerror(errno));
+      return false;
     }
   }
 
-  printf("Running benchmarks");
-  if (nu_bench_state.verbose) {
-    printf(" (%zu iterations, %zu warmups)",
-      nu_bench_state.total_iterations,
-      nu_bench_state.warmup_runs);
+  ioctl(nu_bench_state.perf_fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(nu_bench_state.perf_fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  return true;
+}
+
+static inline void
+nu_bench_perf_close (void)
+{
+  for (int32_t e = 0; e < NU_BENCH_PERF_COUNT; e++) {
+    if (nu_bench_state.perf_fd[e] >= 0)close(nu_bench_state.perf_fd[e]);
+    nu_bench_state.perf_fd[e] = -1;
   }
-  printf("...\n");
+  nu_bench_state.perf = false;
+}
 
-  int32_t run_count = 0;
-  for (int32_t i = 0; i < nu_bench_state.count; i++) {
-    // Apply filter if specified
-    if (nu_bench_state.filter) {
-      if (!strstr(nu_bench_state.benches[i].name, nu_bench_state.filter)) {
-        continue;
-      }
-    }
+// Group read layout: nr, time_enabled, time_running, value[nr]
+static inline bool
+nu_bench_perf_read (uint64_t* values)
+{
+  size_t size = (nu_bench_state.perf_members + 3) * sizeof(uint64_t);
+  return read(nu_bench_state.perf_fd[0], values, size) == (ssize_t)size;
+}
 
-    nu_bench_run_one(i);
-    run_count++;
+static inline void
+nu_bench_perf_begin (void)
+{
+  if (!nu_bench_perf_read(nu_bench_state.perf_start)) {
+    nu_bench_local.perf_counting = false;
   }
+}
 
-  if (run_count == 0) {
-    printf("  No benchmarks matched filter.\n");
+static inline void
+nu_bench_perf_end (void)
+{
+  uint64_t now[NU_BENCH_PERF_COUNT + 3];
+  if (!nu_bench_perf_read(now)) {
+    nu_bench_local.perf_counting = false;
+    return;
+  }
+  nu_bench_state.perf_enabled += (double)(now[1] - nu_bench_state.perf_start[1]);
+  nu_bench_state.perf_running += (double)(now[2] - nu_bench_state.perf_start[2]);
+  for (int32_t e = 0; e < NU_BENCH_PERF_COUNT; e++) {
+    int32_t slot = nu_bench_state.perf_slot[e];
+    if (slot >= 0) {
+      nu_bench_state.perf_total[e] += (double)(now[3 + slot] - nu_bench_state.perf_start[3 + slot]);
+    }
   }
+}
+#else
+static inline bool
+nu_bench_perf_open (void)
+{
+  fprintf(stderr, "WARNING: hardware counters are only supported on Linux, timing only\n");
+  return false;
+}
 
-  printf("\nBenchmarks completed.\n");
-  return 0;
+static inline void
+nu_bench_perf_close (void)
+{
+  nu_bench_state.perf = false;
+}
+
+static inline void
+nu_bench_perf_begin (void)
+{
+}
+
+static inline void
+nu_bench_perf_end (void)
+{
+}
+#endif
+
+// Average count of an event per body invocation, scaled up if the kernel
+// multiplexed the group; negative if the event is unavailable
+static inline double
+nu_bench_perf_per_iteration (nu_bench_perf_event_t event)
+{
+  if (nu_bench_state.perf_slot[event] < 0 || nu_bench_state.perf_iterations == 0) {
+    return -1.0;
+  }
+  double scale = nu_bench_state.perf_running > 0.0
+                 ? nu_bench_state.perf_enabled / nu_bench_state.perf_running : 1.0;
+  return nu_bench_state.perf_total[event] * scale / (double)nu_bench_state.perf_iterations;
+}
+
+// Format a duration given in ns with a unit suited to its magnitude,
+// right-aligning the number in width characters
+static inline void
+nu_bench_format_time (
+  char* buf,
+  size_t size,
+  double ns,
+  int32_t width)
+{
+  if (ns < 1000.0) {
+    snprintf(buf, size, "%*.3f ns", width, ns);
+  } else if (ns < 1000000.0) {
+    snprintf(buf, size, "%*.3f μs", width, ns / 1000.0);
+  } else if (ns < 1000000000.0) {
+    snprintf(buf, size, "%*.3f ms", width, ns / 1000000.0);
+  } else {
+    snprintf(buf, size, "%*.3f s", width, ns / 1000000000.0);
+  }
+}
+
+// Register a benchmark
+static inline void
+nu_bench_register_impl (
+  const char* name,
+  nu_bench_fn fn)
+{
+  if (nu_bench_state.count >= 128) {
+    fprintf(stderr, "ERROR: Too many benchmarks registered (max 128)\n");
+    exit(1);
+  }
+  nu_bench_state.benches[nu_bench_state.count].name = name;
+  nu_bench_state.benches[nu_bench_state.count].fn   = fn;
+  nu_bench_state.count++;
+}
+
+// Expand a sweep specification into a list of values
+static inline size_t
+nu_bench_expand_params (
+  nu_bench_params_t spec,
+  int64_t* out)
+{
+  if (spec.count > 0) {
+    size_t count = spec.count < NU_BENCH_MAX_PARAMS ? spec.count : NU_BENCH_MAX_PARAMS;
+    memcpy(out, spec.values, count * sizeof(int64_t));
+    return count;
+  }
+
+  size_t count = 0;
+  int64_t mult = spec.mult > 1 ? spec.mult : 2;
+  for (int64_t v = spec.lo; v > 0 && v <= spec.hi && count < NU_BENCH_MAX_PARAMS; v *= mult) {
+    out[count++] = v;
+    if (v > INT64_MAX / mult)break;
+  }
+  return count;
+}
+
+// Register a parameterized benchmark
+static inline void
+nu_bench_register_param_impl (
+  const char* name,
+  nu_bench_param_fn fn,
+  nu_bench_params_t spec)
+{
+  nu_bench_register_impl(name, NULL);
+  nu_bench_entry_t* entry = &nu_bench_state.benches[nu_bench_state.count - 1];
+  entry->param_fn    = fn;
+  entry->param_count = nu_bench_expand_params(spec, entry->params);
+}
+
+// Sweep generators for NU_BENCH_PARAM
+#define NU_BENCH_VALUES(...) \
+        ((nu_bench_params_t){ \
+    .values = {__VA_ARGS__}, \
+    .count  = sizeof((int64_t[]){__VA_ARGS__}) / sizeof(int64_t) \
+  })
+
+#define NU_BENCH_RANGE(low, high, multiplier) \
+        ((nu_bench_params_t){.lo = (low), .hi = (high), .mult = (multiplier)})
+
+#define NU_BENCH_POW2(low_exp, high_exp) \
+        NU_BENCH_RANGE(INT64_C(1) << (low_exp), INT64_C(1) << (high_exp), 2)
+
+// Record how much work one invocation of the body does, for items/s and
+// bytes/s reporting. Call from the body; the value applies to all samples.
+static inline void
+nu_bench_set_items (uint64_t items)
+{
+  nu_bench_local.items = items;
+}
+
+static inline void
+nu_bench_set_bytes (uint64_t bytes)
+{
+  nu_bench_local.bytes = bytes;
+}
+
+// Define and register a benchmark
+#define NU_BENCH(name) \
+        static void nu_bench_ ## name(void); \
+        __attribute__((constructor(300))) \
+        static void nu_bench_register_ ## name(void) { \
+          nu_bench_register_impl(#name, nu_bench_ ## name); \
+        } \
+        static void nu_bench_ ## name(void)
+
+// Define and register a benchmark run once per value of a sweep; the body
+// receives the current value as `param`
+#define NU_BENCH_PARAM(name, sweep) \
+        static void nu_bench_ ## name(int64_t param); \
+        __attribute__((constructor(300))) \
+        static void nu_bench_register_ ## name(void) { \
+          nu_bench_register_param_impl(#name, nu_bench_ ## name, sweep); \
+        } \
+        static void nu_bench_ ## name(int64_t param)
+
+// Register a multi-threaded benchmark
+static inline void
+nu_bench_register_mt_impl (
+  const char* name,
+  nu_bench_mt_fn fn)
+{
+  nu_bench_register_impl(name, NULL);
+  nu_bench_state.benches[nu_bench_state.count - 1].mt_fn = fn;
+}
+
+// Define and register a benchmark run concurrently on 1..N pinned threads;
+// the body receives its thread index and the thread count
+#define NU_BENCH_MT(name) \
+        static void nu_bench_ ## name(int32_t thread, int32_t threads); \
+        __attribute__((constructor(300))) \
+        static void nu_bench_register_ ## name(void) { \
+          nu_bench_register_mt_impl(#name, nu_bench_ ## name); \
+        } \
+        static void nu_bench_ ## name( \
+          __attribute__((unused)) int32_t thread, \
+          __attribute__((unused)) int32_t threads)
+
+// Register an open-loop benchmark
+static inline void
+nu_bench_register_open_loop_impl (
+  const char* name,
+  nu_bench_fn fn)
+{
+  nu_bench_register_impl(name, fn);
+  nu_bench_state.benches[nu_bench_state.count - 1].open_loop = true;
+}
+
+// Define and register an open-loop benchmark: the body is one operation,
+// issued at a fixed rate at increasing fractions of its capacity, and its
+// latency is measured from when it was scheduled to start (no START/END)
+#define NU_BENCH_OPEN_LOOP(name) \
+        static void nu_bench_ ## name(void); \
+        __attribute__((constructor(300))) \
+        static void nu_bench_register_ ## name(void) { \
+          nu_bench_register_open_loop_impl(#name, nu_bench_ ## name); \
+        } \
+        static void nu_bench_ ## name(void)
+
+// Attach a fixture to a registered benchmark. Fixtures register at a later
+// constructor priority than benchmarks, so they may appear in either order.
+typedef enum {
+  NU_BENCH_FIXTURE_SETUP,
+  NU_BENCH_FIXTURE_RESET,
+  NU_BENCH_FIXTURE_TEARDOWN,
+} nu_bench_fixture_t;
+
+static inline void
+nu_bench_register_fixture (
+  const char* name,
+  nu_bench_fixture_t kind,
+  nu_bench_param_fn fn)
+{
+  for (int32_t i = 0; i < nu_bench_state.count; i++) {
+    nu_bench_entry_t* entry = &nu_bench_state.benches[i];
+    if (strcmp(entry->name, name) == 0) {
+      if (kind == NU_BENCH_FIXTURE_SETUP) {
+        entry->setup = fn;
+      } else if (kind == NU_BENCH_FIXTURE_RESET) {
+        entry->reset = fn;
+      } else {
+        entry->teardown = fn;
+      }
+      return;
+    }
+  }
+  fprintf(stderr, "ERROR: Fixture for unknown benchmark '%s'\n", name);
+  exit(1);
+}
+
+#define NU_BENCH_FIXTURE_(name, kind, tag) \
+        static void nu_bench_ ## tag ## _ ## name(int64_t param); \
+        __attribute__((constructor(301))) \
+        static void nu_bench_register_ ## tag ## _ ## name(void) { \
+          nu_bench_register_fixture(#name, kind, nu_bench_ ## tag ## _ ## name); \
+        } \
+        static void nu_bench_ ## tag ## _ ## name(__attribute__((unused)) int64_t param)
+
+// Runs once before a benchmark (each point of a sweep) is measured; for
+// NU_BENCH_MT, once per thread count with the thread count as param
+#define NU_BENCH_SETUP(name) \
+        NU_BENCH_FIXTURE_(name, NU_BENCH_FIXTURE_SETUP, setup)
+
+// Runs before every invocation of the body, outside the timed region;
+// not called for NU_BENCH_MT benchmarks
+#define NU_BENCH_RESET(name) \
+        NU_BENCH_FIXTURE_(name, NU_BENCH_FIXTURE_RESET, reset)
+
+// Runs once after a benchmark (each point of a sweep) is measured
+#define NU_BENCH_TEARDOWN(name) \
+        NU_BENCH_FIXTURE_(name, NU_BENCH_FIXTURE_TEARDOWN, teardown)
+
+// Register a group of variants compared on a shared input
+static inline void
+nu_bench_register_group_impl (
+  const char* name,
+  nu_bench_param_fn input,
+  nu_bench_params_t spec)
+{
+  nu_bench_register_impl(name, NULL);
+  nu_bench_entry_t* entry = &nu_bench_state.benches[nu_bench_state.count - 1];
+  entry->group            = true;
+  entry->setup            = input;
+  entry->baseline_variant = -1;
+  entry->param_count      = nu_bench_expand_params(spec, entry->params);
+}
+
+// Attach a variant to a registered group (at the fixture priority, so
+// variants may appear before or after their group)
+static inline void
+nu_bench_register_variant (
+  const char* group,
+  const char* name,
+  nu_bench_param_fn fn,
+  bool baseline)
+{
+  for (int32_t i = 0; i < nu_bench_state.count; i++) {
+    nu_bench_entry_t* entry = &nu_bench_state.benches[i];
+    if (!entry->group || strcmp(entry->name, group) != 0) {
+      continue;
+    }
+    if (entry->variant_count >= NU_BENCH_MAX_VARIANTS) {
+      fprintf(stderr, "ERROR: Too many variants in group '%s' (max %d)\n", group, NU_BENCH_MAX_VARIANTS);
+      exit(1);
+    }
+    if (baseline) {
+      entry->baseline_variant = entry->variant_count;
+    }
+    entry->variants[entry->variant_count].name = name;
+    entry->variants[entry->variant_count].fn   = fn;
+    entry->variant_count++;
+    return;
+  }
+  fprintf(stderr, "ERROR: Variant for unknown group '%s'\n", group);
+  exit(1);
+}
+
+// Define a group of variants run once per value of a sweep. The body is the
+// shared input generator: it runs once per sweep point, like NU_BENCH_SETUP,
+// and NU_BENCH_RESET/NU_BENCH_TEARDOWN(name) may be attached as usual.
+#define NU_BENCH_GROUP(name, sweep) \
+        static void nu_bench_input_ ## name(int64_t param); \
+        __attribute__((constructor(300))) \
+        static void nu_bench_register_ ## name(void) { \
+          nu_bench_register_group_impl(#name, nu_bench_input_ ## name, sweep); \
+        } \
+        static void nu_bench_input_ ## name(__attribute__((unused)) int64_t param)
+
+#define NU_BENCH_VARIANT_(group, name, baseline) \
+        static void nu_bench_ ## group ## _ ## name(int64_t param); \
+        __attribute__((constructor(301))) \
+        static void nu_bench_register_ ## group ## _ ## name(void) { \
+          nu_bench_register_variant(#group, #name, nu_bench_ ## group ## _ ## name, baseline); \
+        } \
+        static void nu_bench_ ## group ## _ ## name(__attribute__((unused)) int64_t param)
+
+// Define a variant of a group; the body is timed like an NU_BENCH_PARAM body
+#define NU_BENCH_VARIANT(group, name) \
+        NU_BENCH_VARIANT_(group, name, false)
+
+// Define the variant the others in its group are compared against (default:
+// the first variant registered)
+#define NU_BENCH_BASELINE(group, name) \
+        NU_BENCH_VARIANT_(group, name, true)
+
+// Make the compiler assume the object at ptr is read and may have been
+// modified, so work producing it cannot be optimized away
+static inline void
+nu_bench_do_not_optimize (const void* ptr)
+{
+  __asm__ volatile("" : : "g"(ptr) : "memory");
+}
+
+// Make the compiler assume all memory was read and written here
+static inline void
+nu_bench_clobber (void)
+{
+  __asm__ volatile("" : : : "memory");
+}
+
+// Start timing
+#define NU_BENCH_START() \
+        do { \
+          nu_bench_local.in_region = true; \
+          if (nu_bench_local.perf_counting)nu_bench_perf_begin(); \
+          nu_bench_local.start_ticks = nu_bench_ticks_begin(); \
+        } while (0)
+
+// End timing and add to the current sample, net of the measured timer overhead
+#define NU_BENCH_END() \
+        do { \
+          uint64_t end   = nu_bench_ticks_end(); \
+          double elapsed = nu_bench_ticks_to_ns(end - nu_bench_local.start_ticks) \
+                           - nu_bench_state.timer_overhead; \
+          if (elapsed > 0.0)nu_bench_local.region_ns += elapsed; \
+          if (nu_bench_local.perf_counting)nu_bench_perf_end(); \
+          nu_bench_local.in_region = false; \
+        } while (0)
+
+// Timed regions accumulate, so a body can exclude phases between them
+#define NU_BENCH_PAUSE()  NU_BENCH_END()
+#define NU_BENCH_RESUME() NU_BENCH_START()
+
+// Helper for array setup
+#define NU_BENCH_ARRAY_SETUP(type, arr, size, init_expr) \
+        type* arr = NU_MALLOC((size) * sizeof(type)); \
+        if (!arr) { \
+          fprintf(stderr, "Benchmark allocation failed\n"); \
+          exit(1); \
+        } \
+        for (size_t i = 0; i < (size); i++) { \
+          arr[i] = (init_expr); \
+        }
+
+#define NU_BENCH_ARRAY_CLEANUP(arr) \
+        NU_FREE(arr)
+
+// Summary statistics over the samples of one benchmark, all in ns
+typedef struct {
+  size_t count;
+  double min;
+  double max;
+  double mean;
+  double stddev;
+  double median;
+  double p90;
+  double p99;
+  double p999;
+  double mad;            // Median absolute deviation (unscaled)
+  double ci_low;         // 95% bootstrap confidence interval of the median
+  double ci_high;
+  size_t outliers_low;   // Below Q1 - 1.5 IQR
+  size_t outliers_high;  // Above Q3 + 1.5 IQR
+  size_t outliers_severe;  // Beyond 3 IQR on either side
+} nu_bench_stats_t;
+
+// xorshift64* - small deterministic PRNG for resampling
+static inline uint64_t
+nu_bench_rand (uint64_t* state)
+{
+  uint64_t x = *state;
+  x     ^= x >> 12;
+  x     ^= x << 25;
+  x     ^= x >> 27;
+  *state = x;
+  return x * 0x2545F4914F6CDD1Dull;
+}
+
+static inline int
+nu_bench_compare_doubles (
+  const void* a,
+  const void* b)
+{
+  double da = *(const double*)a;
+  double db = *(const double*)b;
+  return (da > db) - (da < db);
+}
+
+// Percentile of sorted data with linear interpolation between closest ranks
+static inline double
+nu_bench_percentile (
+  const double* sorted,
+  size_t n,
+  double p)
+{
+  if (n == 0) {
+    return 0.0;
+  }
+  double rank = p * (double)(n - 1);
+  size_t lo   = (size_t)rank;
+  size_t hi   = lo + 1 < n ? lo + 1 : lo;
+  double frac = rank - (double)lo;
+  return sorted[lo] + (sorted[hi] - sorted[lo]) * frac;
+}
+
+// Quickselect: partially order data so data[k] holds the k-th smallest value
+static inline double
+nu_bench_select (
+  double* data,
+  size_t n,
+  size_t k)
+{
+  size_t lo = 0, hi = n - 1;
+  while (lo < hi) {
+    double pivot = data[lo + (hi - lo) / 2];
+    size_t i     = lo, j = hi;
+    while (i <= j) {
+      while (data[i] < pivot) i++;
+      while (data[j] > pivot) j--;
+      if (i <= j) {
+        double tmp = data[i];
+        data[i] = data[j];
+        data[j] = tmp;
+        i++;
+        if (j == 0)break;
+        j--;
+      }
+    }
+    if (k <= j) {
+      hi = j;
+    } else if (k >= i) {
+      lo = i;
+    } else {
+      break;
+    }
+  }
+  return data[k];
+}
+
+// Median of data (reordered in place) in O(n)
+static inline double
+nu_bench_select_median (
+  double* data,
+  size_t n)
+{
+  double upper = nu_bench_select(data, n, n / 2);
+  if (n % 2 == 1) {
+    return upper;
+  }
+  // Lower half is now <= upper; its maximum is the other middle value
+  double lower = data[0];
+  for (size_t i = 1; i < n / 2; i++) {
+    if (data[i] > lower)lower = data[i];
+  }
+  return (lower + upper) / 2.0;
+}
+
+// Calculate statistics for current benchmark
+static inline void
+nu_bench_calculate_stats (nu_bench_stats_t* stats)
+{
+  size_t n = nu_bench_state.time_count;
+  memset(stats, 0, sizeof(*stats));
+  stats->count = nu_bench_state.time_seen;
+  if (n == 0) {
+    return;
+  }
+
+  double* sorted  = NU_MALLOC(n * sizeof(double));
+  double* scratch = NU_MALLOC(n * sizeof(double));
+  if (!sorted || !scratch) {
+    fprintf(stderr, "Benchmark allocation failed\n");
+    exit(1);
+  }
+
+  // Mean and standard deviation over every sample (Welford, while recording)
+  size_t seen   = nu_bench_state.time_seen;
+  stats->mean   = nu_bench_state.time_mean;
+  stats->stddev = seen > 1 ? sqrt(nu_bench_state.time_m2 / (double)(seen - 1)) : 0.0;
+
+  // Order statistics: exact while the reservoir holds every sample, from the
+  // histogram (3 significant digits) once it is only a subset
+  memcpy(sorted, nu_bench_state.times, n * sizeof(double));
+  nu_sort(sorted, n, sizeof(double), nu_bench_compare_doubles);
+  if (seen == n) {
+    stats->min    = sorted[0];
+    stats->max    = sorted[n - 1];
+    stats->median = nu_bench_percentile(sorted, n, 0.5);
+    stats->p90    = nu_bench_percentile(sorted, n, 0.90);
+    stats->p99    = nu_bench_percentile(sorted, n, 0.99);
+    stats->p999   = nu_bench_percentile(sorted, n, 0.999);
+  } else {
+    const nu_histogram* h = &nu_bench_state.histogram;
+    stats->min    = (double)nu_histogram_min(h) / 1000.0;
+    stats->max    = (double)nu_histogram_max(h) / 1000.0;
+    stats->median = (double)nu_histogram_value_at_percentile(h, 50.0) / 1000.0;
+    stats->p90    = (double)nu_histogram_value_at_percentile(h, 90.0) / 1000.0;
+    stats->p99    = (double)nu_histogram_value_at_percentile(h, 99.0) / 1000.0;
+    stats->p999   = (double)nu_histogram_value_at_percentile(h, 99.9) / 1000.0;
+  }
+
+  // Median absolute deviation
+  for (size_t i = 0; i < n; i++) {
+    scratch[i] = fabs(sorted[i] - stats->median);
+  }
+  stats->mad = nu_bench_select_median(scratch, n);
+
+  // Tukey fences, counted in the reservoir and scaled to all samples
+  double q1  = nu_bench_percentile(sorted, n, 0.25);
+  double q3  = nu_bench_percentile(sorted, n, 0.75);
+  double iqr = q3 - q1;
+  for (size_t i = 0; i < n; i++) {
+    double t = sorted[i];
+    if (t < q1 - 1.5 * iqr)stats->outliers_low++;
+    if (t > q3 + 1.5 * iqr)stats->outliers_high++;
+    if (t < q1 - 3.0 * iqr || t > q3 + 3.0 * iqr)stats->outliers_severe++;
+  }
+  if (seen > n) {
+    double scale = (double)seen / (double)n;
+    stats->outliers_low    = (size_t)((double)stats->outliers_low * scale + 0.5);
+    stats->outliers_high   = (size_t)((double)stats->outliers_high * scale + 0.5);
+    stats->outliers_severe = (size_t)((double)stats->outliers_severe * scale + 0.5);
+  }
+
+  // Percentile bootstrap of the median. The resample count shrinks for very
+  // large sample sets to bound the cost at roughly 10M element copies.
+  size_t resamples = 10000000 / n;
+  if (resamples > 1000)resamples = 1000;
+  if (resamples < 100)resamples = 100;
+  double* medians = NU_MALLOC(resamples * sizeof(double));
+  if (!medians) {
+    fprintf(stderr, "Benchmark allocation failed\n");
+    exit(1);
+  }
+  uint64_t seed = 0x9E3779B97F4A7C15ull;
+  for (size_t r = 0; r < resamples; r++) {
+    for (size_t i = 0; i < n; i++) {
+      scratch[i] = sorted[nu_bench_rand(&seed) % n];
+    }
+    medians[r] = nu_bench_select_median(scratch, n);
+  }
+  nu_sort(medians, resamples, sizeof(double), nu_bench_compare_doubles);
+  stats->ci_low  = nu_bench_percentile(medians, resamples, 0.025);
+  stats->ci_high = nu_bench_percentile(medians, resamples, 0.975);
+
+  NU_FREE(medians);
+  NU_FREE(scratch);
+  NU_FREE(sorted);
+}
+
+// Two-sided p-value of the Mann-Whitney U test (normal approximation with
+// tie and continuity correction). Small p means the two sample sets are
+// unlikely to come from the same distribution.
+typedef struct {
+  double value;
+  int32_t group;
+} nu_bench_ranked_t;
+
+static inline int
+nu_bench_compare_ranked (
+  const void* a,
+  const void* b)
+{
+  double da = ((const nu_bench_ranked_t*)a)->value;
+  double db = ((const nu_bench_ranked_t*)b)->value;
+  return (da > db) - (da < db);
+}
+
+static inline double
+nu_bench_mann_whitney (
+  const double* a,
+  size_t na,
+  const double* b,
+  size_t nb)
+{
+  size_t n = na + nb;
+  if (na == 0 || nb == 0) {
+    return 1.0;
+  }
+
+  nu_bench_ranked_t* all = NU_MALLOC(n * sizeof(nu_bench_ranked_t));
+  if (!all) {
+    fprintf(stderr, "Benchmark allocation failed\n");
+    exit(1);
+  }
+  for (size_t i = 0; i < na; i++) {
+    all[i] = (nu_bench_ranked_t){a[i], 0};
+  }
+  for (size_t i = 0; i < nb; i++) {
+    all[na + i] = (nu_bench_ranked_t){b[i], 1};
+  }
+  nu_sort(all, n, sizeof(nu_bench_ranked_t), nu_bench_compare_ranked);
+
+  // Sum of (average) ranks of group a, and the tie correction term
+  double rank_sum = 0.0, ties = 0.0;
+  for (size_t i = 0; i < n;) {
+    size_t j = i;
+    while (j + 1 < n && !(all[j + 1].value > all[i].value)) j++;
+    double rank = (double)(i + j) / 2.0 + 1.0;
+    double t    = (double)(j - i + 1);
+    ties += t * t * t - t;
+    for (size_t k = i; k <= j; k++) {
+      if (all[k].group == 0)rank_sum += rank;
+    }
+    i = j + 1;
+  }
+  NU_FREE(all);
+
+  double n1    = (double)na, n2 = (double)nb, nn = (double)n;
+  double u     = rank_sum - n1 * (n1 + 1.0) / 2.0;
+  double mu    = n1 * n2 / 2.0;
+  double var   = n1 * n2 / 12.0 * ((nn + 1.0) - ties / (nn * (nn - 1.0)));
+  if (var <= 0.0) {
+    return 1.0;
+  }
+  double z = (fabs(u - mu) - 0.5) / sqrt(var);
+  if (z < 0.0)z = 0.0;
+  return erfc(z / sqrt(2.0));
+}
+
+// Write s as a JSON string literal
+static inline void
+nu_bench_json_string (
+  FILE* out,
+  const char* s)
+{
+  fputc('"', out);
+  for (; *s; s++) {
+    unsigned char ch = (unsigned char)*s;
+    if (ch == '"' || ch == '\\') {
+      fprintf(out, "\\%c", ch);
+    } else if (ch < 0x20) {
+      fprintf(out, "\\u%04x", ch);
+    } else {
+      fputc(ch, out);
+    }
+  }
+  fputc('"', out);
+}
+
+// Read the first line of a small file into buf, without the newline
+static inline bool
+nu_bench_read_line (
+  const char* path,
+  const char* prefix,
+  char* buf,
+  size_t size)
+{
+  FILE* f = fopen(path, "r");
+  if (!f) {
+    return false;
+  }
+  bool found = false;
+  char line[512];
+  while (fgets(line, sizeof(line), f)) {
+    if (prefix && strncmp(line, prefix, strlen(prefix)) != 0) {
+      continue;
+    }
+    const char* value = line;
+    if (prefix) {
+      value = strchr(line, ':');
+      value = value ? value + 1 + strspn(value + 1, " \t") : line;
+    }
+    snprintf(buf, size, "%.*s", (int)(size - 1), value);
+    buf[strcspn(buf, "\n")] = '\0';
+    found = true;
+    break;
+  }
+  fclose(f);
+  return found;
+}
+
+// Environment the results were produced in
+typedef struct {
+  char date[32];
+  char host[128];
+  char os[192];
+  char cpu[192];
+  char governor[64];
+} nu_bench_env_t;
+
+static inline void
+nu_bench_get_env (nu_bench_env_t* env)
+{
+  memset(env, 0, sizeof(*env));
+
+  time_t now = time(NULL);
+  struct tm tm_utc;
+  gmtime_r(&now, &tm_utc);
+  strftime(env->date, sizeof(env->date), "%Y-%m-%dT%H:%M:%SZ", &tm_utc);
+
+  if (gethostname(env->host, sizeof(env->host) - 1) != 0) {
+    snprintf(env->host, sizeof(env->host), "unknown");
+  }
+
+  struct utsname uts;
+  if (uname(&uts) == 0) {
+    snprintf(env->os, sizeof(env->os), "%.32s %.96s %.32s", uts.sysname, uts.release, uts.machine);
+  }
+
+  snprintf(env->cpu, sizeof(env->cpu), "unknown");
+  snprintf(env->governor, sizeof(env->governor), "unknown");
+#ifdef __APPLE__
+  size_t len = sizeof(env->cpu);
+  sysctlbyname("machdep.cpu.brand_string", env->cpu, &len, NULL, 0);
+#else
+  if (!nu_bench_read_line("/proc/cpuinfo", "model name", env->cpu, sizeof(env->cpu))) {
+    nu_bench_read_line("/proc/cpuinfo", "Model", env->cpu, sizeof(env->cpu));
+  }
+  char path[96];
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/scaling_governor",
+    nu_bench_state.cpu >= 0 ? nu_bench_state.cpu : 0);
+  nu_bench_read_line(path, NULL, env->governor, sizeof(env->governor));
+#endif
+}
+
+static inline void
+nu_bench_warn (const char* message)
+{
+  if (nu_bench_state.warning_count < 8) {
+    snprintf(nu_bench_state.warnings[nu_bench_state.warning_count++],
+      sizeof(nu_bench_state.warnings[0]), "%s", message);
+  }
+}
+
+// Apply --cpu and --mlock, then look for settings known to make results
+// vary between runs. Problems are recorded as warnings, never fatal.
+static inline void
+nu_bench_setup_env (void)
+{
+  char message[192];
+  char value[128];
+
+  nu_bench_state.cpu_count = nu_bench_allowed_cpus(nu_bench_state.cpus, NU_BENCH_MAX_THREADS);
+
+  if (nu_bench_state.cpu >= 0 && !nu_bench_pin_thread(nu_bench_state.cpu)) {
+    snprintf(message, sizeof(message), "cannot pin to CPU %d (%s)", nu_bench_state.cpu, strerror(errno));
+    nu_bench_warn(message);
+    nu_bench_state.cpu = -1;
+  }
+  if (nu_bench_state.mlock && mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    snprintf(message, sizeof(message), "cannot lock memory (%s)", strerror(errno));
+    nu_bench_warn(message);
+  }
+
+  nu_bench_env_t env;
+  nu_bench_get_env(&env);
+  if (strcmp(env.governor, "unknown") != 0 && strcmp(env.governor, "performance") != 0) {
+    snprintf(message, sizeof(message), "CPU frequency governor is '%.64s', not 'performance'", env.governor);
+    nu_bench_warn(message);
+  }
+
+  if (nu_bench_read_line("/sys/devices/system/cpu/intel_pstate/no_turbo", NULL, value, sizeof(value))
+      && strcmp(value, "0") == 0) {
+    nu_bench_warn("turbo boost is enabled (intel_pstate/no_turbo is 0)");
+  } else if (nu_bench_read_line("/sys/devices/system/cpu/cpufreq/boost", NULL, value, sizeof(value))
+             && strcmp(value, "1") == 0) {
+    nu_bench_warn("CPU boost is enabled (cpufreq/boost is 1)");
+  }
+
+  if (nu_bench_state.cpu >= 0) {
+    char path[96];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", nu_bench_state.cpu);
+    if (nu_bench_read_line(path, NULL, value, sizeof(value)) && strpbrk(value, ",-")) {
+      snprintf(message, sizeof(message), "CPU %d shares its core with SMT siblings %.64s",
+        nu_bench_state.cpu, value);
+      nu_bench_warn(message);
+    }
+  } else if (nu_bench_read_line("/sys/devices/system/cpu/smt/active", NULL, value, sizeof(value))
+             && strcmp(value, "1") == 0) {
+    nu_bench_warn("SMT is active; use --cpu with an idle sibling or disable SMT");
+  }
+
+  double load[1];
+  if (getloadavg(load, 1) == 1 && load[0] > 1.0) {
+    snprintf(message, sizeof(message), "load average is %.2f; other work is competing for the CPU", load[0]);
+    nu_bench_warn(message);
+  }
+
+  // Reference for the noise probe, taken after pinning
+  nu_bench_spin_probe();
+  nu_bench_state.probe_ns = nu_bench_spin_probe();
+}
+
+// Opening of a machine-readable report: environment metadata
+static inline void
+nu_bench_report_begin (void)
+{
+  FILE* out = nu_bench_state.out;
+  nu_bench_env_t env;
+  nu_bench_get_env(&env);
+
+  if (nu_bench_state.format == NU_BENCH_FORMAT_JSON) {
+    fprintf(out, "{\n  \"context\": {\n");
+    fprintf(out, "    \"date\": ");
+    nu_bench_json_string(out, env.date);
+    fprintf(out, ",\n    \"host\": ");
+    nu_bench_json_string(out, env.host);
+    fprintf(out, ",\n    \"os\": ");
+    nu_bench_json_string(out, env.os);
+    fprintf(out, ",\n    \"cpu\": ");
+    nu_bench_json_string(out, env.cpu);
+    fprintf(out, ",\n    \"governor\": ");
+    nu_bench_json_string(out, env.governor);
+    fprintf(out, ",\n    \"compiler\": ");
+    nu_bench_json_string(out, __VERSION__);
+    fprintf(out, ",\n    \"cflags\": ");
+    nu_bench_json_string(out, NU_BENCH_CFLAGS);
+    fprintf(out, ",\n    \"git_revision\": ");
+    nu_bench_json_string(out, NU_BENCH_GIT_REV);
+    fprintf(out, ",\n    \"clock\": ");
+    nu_bench_json_string(out, nu_bench_clock_name(nu_bench_state.clock));
+    fprintf(out, ",\n    \"timer_overhead_ns\": %.3f", nu_bench_state.timer_overhead);
+    fprintf(out, ",\n    \"pinned_cpu\": %d", nu_bench_state.cpu);
+    fprintf(out, ",\n    \"probe_ns\": %.3f", nu_bench_state.probe_ns);
+    if (nu_bench_state.level_count > 0) {
+      fprintf(out, ",\n    \"roofline\": [");
+      for (int32_t l = 0; l < nu_bench_state.level_count; l++) {
+        const nu_bench_roofline_t* level = &nu_bench_state.levels[l];
+        fprintf(out, "%s\n      {\"level\": \"%s\", \"size_bytes\": %zu, \"working_set_bytes\": %zu, "
+          "\"latency_ns\": %.3f, \"read_bytes_per_second\": %.0f, \"write_bytes_per_second\": %.0f, "
+          "\"copy_bytes_per_second\": %.0f}", l > 0 ? "," : "", level->name, level->size,
+          level->working_set, level->latency_ns, level->read_bw, level->write_bw, level->copy_bw);
+      }
+      fprintf(out, "\n    ]");
+    }
+    fprintf(out, ",\n    \"warnings\": [");
+    for (int32_t i = 0; i < nu_bench_state.warning_count; i++) {
+      fprintf(out, "%s", i > 0 ? ", " : "");
+      nu_bench_json_string(out, nu_bench_state.warnings[i]);
+    }
+    fprintf(out, "]\n  },\n");
+    fprintf(out, "  \"benchmarks\": [");
+  } else if (nu_bench_state.format == NU_BENCH_FORMAT_CSV) {
+    fprintf(out, "# date: %s\n", env.date);
+    fprintf(out, "# host: %s\n", env.host);
+    fprintf(out, "# os: %s\n", env.os);
+    fprintf(out, "# cpu: %s\n", env.cpu);
+    fprintf(out, "# governor: %s\n", env.governor);
+    fprintf(out, "# compiler: %s\n", __VERSION__);
+    fprintf(out, "# cflags: %s\n", NU_BENCH_CFLAGS);
+    fprintf(out, "# git_revision: %s\n", NU_BENCH_GIT_REV);
+    fprintf(out, "# clock: %s\n", nu_bench_clock_name(nu_bench_state.clock));
+    fprintf(out, "# timer_overhead_ns: %.3f\n", nu_bench_state.timer_overhead);
+    fprintf(out, "# pinned_cpu: %d\n", nu_bench_state.cpu);
+    fprintf(out, "# probe_ns: %.3f\n", nu_bench_state.probe_ns);
+    for (int32_t l = 0; l < nu_bench_state.level_count; l++) {
+      const nu_bench_roofline_t* level = &nu_bench_state.levels[l];
+      fprintf(out, "# roofline: %s size=%zu working_set=%zu latency_ns=%.3f read=%.0f write=%.0f copy=%.0f\n",
+        level->name, level->size, level->working_set, level->latency_ns,
+        level->read_bw, level->write_bw, level->copy_bw);
+    }
+    for (int32_t i = 0; i < nu_bench_state.warning_count; i++) {
+      fprintf(out, "# warning: %s\n", nu_bench_state.warnings[i]);
+    }
+    fprintf(out, "name,batch,sample,ns\n");
+  }
+}
+
+static inline void
+nu_bench_report_end (void)
+{
+  if (nu_bench_state.format == NU_BENCH_FORMAT_JSON) {
+    fprintf(nu_bench_state.out, "\n  ]\n}\n");
+  }
+}
+
+// Index of the baseline entry for name, creating it when create is set;
+// -1 if absent (or if the table is full)
+static inline int32_t
+nu_bench_baseline_index (
+  const char* name,
+  size_t name_len,
+  bool create)
+{
+  for (int32_t i = 0; i < nu_bench_state.baseline_count; i++) {
+    const char* other = nu_bench_state.baseline[i].name;
+    if (strlen(other) == name_len && strncmp(other, name, name_len) == 0) {
+      return i;
+    }
+  }
+  if (!create || nu_bench_state.baseline_count >= 128) {
+    return -1;
+  }
+
+  int32_t idx = nu_bench_state.baseline_count++;
+  memset(&nu_bench_state.baseline[idx], 0, sizeof(nu_bench_baseline_t));
+  snprintf(nu_bench_state.baseline[idx].name, sizeof(nu_bench_state.baseline[idx].name),
+    "%.*s", (int)name_len, name);
+  return idx;
+}
+
+static inline const nu_bench_baseline_t*
+nu_bench_baseline_find (const char* name)
+{
+  int32_t idx = nu_bench_baseline_index(name, strlen(name), false);
+  return idx >= 0 ? &nu_bench_state.baseline[idx] : NULL;
+}
+
+static inline void
+nu_bench_baseline_add (
+  int32_t idx,
+  double ns)
+{
+  if (idx < 0) {
+    return;
+  }
+  nu_bench_baseline_t* b = &nu_bench_state.baseline[idx];
+  if (b->count == b->capacity) {
+    size_t capacity = b->capacity ? b->capacity * 2 : 256;
+    double* samples = NU_MALLOC(capacity * sizeof(double));
+    if (!samples) {
+      fprintf(stderr, "Benchmark allocation failed\n");
+      exit(1);
+    }
+    if (b->samples) {
+      memcpy(samples, b->samples, b->count * sizeof(double));
+      NU_FREE(b->samples);
+    }
+    b->samples  = samples;
+    b->capacity = capacity;
+  }
+  b->samples[b->count++] = ns;
+}
+
+// Load per-sample data from a previous --format=json or --format=csv run.
+// This is a scanner for the files nu/bench writes, not a general parser.
+static inline bool
+nu_bench_load_baseline (const char* path)
+{
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "ERROR: Cannot open baseline '%s'\n", path);
+    return false;
+  }
+  fseek(f, 0, SEEK_END);
+  long len = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  if (len < 0) {
+    fclose(f);
+    return false;
+  }
+  char* text = NU_MALLOC((size_t)len + 1);
+  if (!text) {
+    fclose(f);
+    fprintf(stderr, "Benchmark allocation failed\n");
+    exit(1);
+  }
+  size_t got = fread(text, 1, (size_t)len, f);
+  text[got] = '\0';
+  fclose(f);
+
+  const char* p = text + strspn(text, " \t\r\n");
+  if (*p == '{') {
+    // JSON: each "name" is followed by its "samples_ns" array
+    while ((p = strstr(p, "\"name\": \""))) {
+      const char* name = p + 9;
+      const char* end  = strchr(name, '"');
+      const char* arr  = end ? strstr(end, "\"samples_ns\": [") : NULL;
+      if (!arr) {
+        break;
+      }
+      int32_t idx = nu_bench_baseline_index(name, (size_t)(end - name), true);
+      char* cursor = (char*)(uintptr_t)(arr + 15);
+      for (;;) {
+        cursor += strspn(cursor, " \t\r\n,");
+        if (*cursor == ']' || *cursor == '\0') {
+          break;
+        }
+        char* next = cursor;
+        double ns  = strtod(cursor, &next);
+        if (next == cursor) {
+          break;
+        }
+        nu_bench_baseline_add(idx, ns);
+        cursor = next;
+      }
+      p = cursor;
+    }
+  } else {
+    // CSV: name,batch,sample,ns after '#' metadata and the header row
+    for (char* line = text; line && *line;) {
+      char* next = strchr(line, '\n');
+      if (next)*next++ = '\0';
+      char* c1 = strchr(line, ',');
+      char* c3 = c1 ? strrchr(line, ',') : NULL;
+      if (line[0] != '#' && c1 && c3 && c3 != c1 && strncmp(line, "name,", 5) != 0) {
+        nu_bench_baseline_add(nu_bench_baseline_index(line, (size_t)(c1 - line), true),
+          strtod(c3 + 1, NULL));
+      }
+      line = next;
+    }
+  }
+
+  NU_FREE(text);
+  if (nu_bench_state.baseline_count == 0) {
+    fprintf(stderr, "ERROR: No benchmark samples found in baseline '%s'\n", path);
+    return false;
+  }
+  return true;
+}
+
+static inline void
+nu_bench_free_baseline (void)
+{
+  for (int32_t i = 0; i < nu_bench_state.baseline_count; i++) {
+    NU_FREE(nu_bench_state.baseline[i].samples);
+  }
+  nu_bench_state.baseline_count = 0;
+}
+
+static inline double
+nu_bench_complexity_value (
+  nu_bench_complexity_t c,
+  double n)
+{
+  switch (c) {
+    case NU_BENCH_O_1:       return 1.0;
+    case NU_BENCH_O_LOG_N:   return log2(n);
+    case NU_BENCH_O_N:       return n;
+    case NU_BENCH_O_N_LOG_N: return n * log2(n);
+    case NU_BENCH_O_N2:      return n * n;
+    case NU_BENCH_O_N3:      return n * n * n;
+    case NU_BENCH_O_COUNT:
+    default:                 return 0.0;
+  }
+}
+
+static inline const char*
+nu_bench_complexity_name (nu_bench_complexity_t c)
+{
+  switch (c) {
+    case NU_BENCH_O_1:       return "O(1)";
+    case NU_BENCH_O_LOG_N:   return "O(log n)";
+    case NU_BENCH_O_N:       return "O(n)";
+    case NU_BENCH_O_N_LOG_N: return "O(n log n)";
+    case NU_BENCH_O_N2:      return "O(n^2)";
+    case NU_BENCH_O_N3:      return "O(n^3)";
+    case NU_BENCH_O_COUNT:
+    default:                 return "O(?)";
+  }
+}
+
+static inline const char*
+nu_bench_complexity_term (nu_bench_complexity_t c)
+{
+  switch (c) {
+    case NU_BENCH_O_1:       return "1";
+    case NU_BENCH_O_LOG_N:   return "log n";
+    case NU_BENCH_O_N:       return "n";
+    case NU_BENCH_O_N_LOG_N: return "n log n";
+    case NU_BENCH_O_N2:      return "n^2";
+    case NU_BENCH_O_N3:      return "n^3";
+    case NU_BENCH_O_COUNT:
+    default:                 return "?";
+  }
+}
+
+// Least-squares fit of time = coef * f(n) for each candidate f; picks the one
+// with the smallest root-mean-square error, reported relative to mean time
+static inline nu_bench_complexity_t
+nu_bench_fit_complexity (
+  const double* n,
+  const double* ns,
+  size_t points,
+  double* coef,
+  double* rms)
+{
+  nu_bench_complexity_t best = NU_BENCH_O_1;
+  double mean = 0.0;
+  for (size_t i = 0; i < points; i++) {
+    mean += ns[i] / (double)points;
+  }
+
+  *coef = 0.0;
+  *rms  = DBL_MAX;
+  for (int32_t c = 0; c < NU_BENCH_O_COUNT; c++) {
+    double sum_tf = 0.0, sum_ff = 0.0;
+    for (size_t i = 0; i < points; i++) {
+      double f = nu_bench_complexity_value((nu_bench_complexity_t)c, n[i]);
+      sum_tf += ns[i] * f;
+      sum_ff += f * f;
+    }
+    if (sum_ff <= 0.0) {
+      continue;
+    }
+    double k   = sum_tf / sum_ff;
+    double err = 0.0;
+    for (size_t i = 0; i < points; i++) {
+      double d = ns[i] - k * nu_bench_complexity_value((nu_bench_complexity_t)c, n[i]);
+      err += d * d;
+    }
+    err = mean > 0.0 ? sqrt(err / (double)points) / mean : 0.0;
+    if (err < *rms) {
+      best  = (nu_bench_complexity_t)c;
+      *coef = k;
+      *rms  = err;
+    }
+  }
+  return best;
+}
+
+// Format a rate with a k/M/G prefix
+static inline void
+nu_bench_format_rate (
+  char* buf,
+  size_t size,
+  double per_second,
+  const char* unit)
+{
+  if (per_second >= 1e9) {
+    snprintf(buf, size, "%.2f G%s/s", per_second / 1e9, unit);
+  } else if (per_second >= 1e6) {
+    snprintf(buf, size, "%.2f M%s/s", per_second / 1e6, unit);
+  } else if (per_second >= 1e3) {
+    snprintf(buf, size, "%.2f k%s/s", per_second / 1e3, unit);
+  } else {
+    snprintf(buf, size, "%.2f %s/s", per_second, unit);
+  }
+}
+
+static inline void
+nu_bench_format_bytes (
+  char* buf,
+  size_t size,
+  double bytes)
+{
+  if (bytes >= 1024.0 * 1024.0 * 1024.0) {
+    snprintf(buf, size, "%.2f GiB", bytes / (1024.0 * 1024.0 * 1024.0));
+  } else if (bytes >= 1024.0 * 1024.0) {
+    snprintf(buf, size, "%.2f MiB", bytes / (1024.0 * 1024.0));
+  } else if (bytes >= 1024.0) {
+    snprintf(buf, size, "%.2f KiB", bytes / 1024.0);
+  } else {
+    snprintf(buf, size, "%.0f B", bytes);
+  }
+}
+
+// Throughput at the median time, 0 when the body did not declare its work
+static inline double
+nu_bench_items_per_second (const nu_bench_stats_t* st)
+{
+  if (nu_bench_state.current_threads > 0) {
+    return (double)nu_bench_state.items * nu_bench_state.mt_throughput;
+  }
+  if (nu_bench_state.open_offered > 0.0) {
+    return (double)nu_bench_state.items * nu_bench_state.open_achieved;
+  }
+  return st->median > 0.0 ? (double)nu_bench_state.items * 1e9 / st->median : 0.0;
+}
+
+static inline double
+nu_bench_bytes_per_second (const nu_bench_stats_t* st)
+{
+  if (nu_bench_state.current_threads > 0) {
+    return (double)nu_bench_state.bytes * nu_bench_state.mt_throughput;
+  }
+  if (nu_bench_state.open_offered > 0.0) {
+    return (double)nu_bench_state.bytes * nu_bench_state.open_achieved;
+  }
+  return st->median > 0.0 ? (double)nu_bench_state.bytes * 1e9 / st->median : 0.0;
+}
+
+// Memory level whose bandwidth bounds the current result: the smallest cache
+// that holds the bytes declared per invocation, or DRAM when none does or
+// the caches start cold. NULL without --roofline or declared bytes.
+static inline const nu_bench_roofline_t*
+nu_bench_roofline_level (void)
+{
+  int32_t count = nu_bench_state.level_count;
+  if (count == 0 || nu_bench_state.bytes == 0) {
+    return NULL;
+  }
+  for (int32_t l = 0; l < count - 1 && !nu_bench_state.cold; l++) {
+    if (nu_bench_state.bytes <= nu_bench_state.levels[l].size) {
+      return &nu_bench_state.levels[l];
+    }
+  }
+  return &nu_bench_state.levels[count - 1];
+}
+
+// Bytes/s as a fraction of that level's streaming read bandwidth. Near 1 the
+// code runs at the memory ceiling (memory-bound); far below it, the time
+// goes elsewhere (compute-bound, or latency-bound for dependent loads).
+static inline double
+nu_bench_roofline_fraction (
+  const nu_bench_roofline_t* level,
+  const nu_bench_stats_t* st)
+{
+  return level->read_bw > 0.0 ? nu_bench_bytes_per_second(st) / level->read_bw : 0.0;
+}
+
+// One line of counter averages, divided by `per` (1 or the items count)
+static inline void
+nu_bench_report_perf_text (
+  FILE* log,
+  const char* label,
+  double per)
+{
+  double cycles       = nu_bench_perf_per_iteration(NU_BENCH_PERF_CYCLES);
+  double instructions = nu_bench_perf_per_iteration(NU_BENCH_PERF_INSTRUCTIONS);
+
+  fprintf(log, "               %s:", label);
+  const char* sep = " ";
+  for (int32_t e = 0; e < NU_BENCH_PERF_COUNT; e++) {
+    double v = nu_bench_perf_per_iteration((nu_bench_perf_event_t)e);
+    if (v >= 0.0) {
+      fprintf(log, "%s%.1f %s", sep, v / per, nu_bench_perf_name((nu_bench_perf_event_t)e));
+      if (e == NU_BENCH_PERF_INSTRUCTIONS && cycles > 0.0) {
+        fprintf(log, " (IPC %.2f)", instructions / cycles);
+      }
+      sep = ", ";
+    }
+  }
+  fprintf(log, "\n");
+}
+
+// Counter averages as a JSON object, divided by `per`
+static inline void
+nu_bench_report_perf_json (
+  FILE* out,
+  const char* key,
+  double per)
+{
+  fprintf(out, "      \"%s\": {", key);
+  const char* sep = "";
+  for (int32_t e = 0; e < NU_BENCH_PERF_COUNT; e++) {
+    double v = nu_bench_perf_per_iteration((nu_bench_perf_event_t)e);
+    if (v >= 0.0) {
+      fprintf(out, "%s\"%s\": %.3f", sep, nu_bench_perf_name((nu_bench_perf_event_t)e), v / per);
+      sep = ", ";
+    }
+  }
+  double cycles = nu_bench_perf_per_iteration(NU_BENCH_PERF_CYCLES);
+  if (cycles > 0.0 && nu_bench_perf_per_iteration(NU_BENCH_PERF_INSTRUCTIONS) >= 0.0) {
+    fprintf(out, "%s\"ipc\": %.3f", sep, nu_bench_perf_per_iteration(NU_BENCH_PERF_INSTRUCTIONS) / cycles);
+  }
+  fprintf(out, "},\n");
+}
+
+// Human-readable result line(s)
+static inline void
+nu_bench_report_text (
+  const char* name,
+  const nu_bench_stats_t* st)
+{
+  FILE* log = nu_bench_state.log;
+
+  // Format time with proper padding (12 chars total for time + unit)
+  char time_buf[32];
+  nu_bench_format_time(time_buf, sizeof(time_buf), st->median, 9);
+
+  fprintf(log, "  %s  %s", time_buf, name);
+
+  if (nu_bench_state.items > 0 || nu_bench_state.bytes > 0) {
+    char rate[32];
+    fprintf(log, "  [");
+    if (nu_bench_state.items > 0) {
+      nu_bench_format_rate(rate, sizeof(rate), nu_bench_items_per_second(st), "items");
+      fprintf(log, "%s%s", rate, nu_bench_state.bytes > 0 ? ", " : "");
+    }
+    if (nu_bench_state.bytes > 0) {
+      nu_bench_format_rate(rate, sizeof(rate), nu_bench_bytes_per_second(st), "B");
+      fprintf(log, "%s", rate);
+    }
+    const nu_bench_roofline_t* level = nu_bench_roofline_level();
+    if (level) {
+      fprintf(log, ", %.1f%% of %s", nu_bench_roofline_fraction(level, st) * 100.0, level->name);
+    }
+    fprintf(log, "]");
+  }
+
+  size_t outliers = st->outliers_low + st->outliers_high;
+  if (outliers > 0) {
+    fprintf(log, " (%zu outlier%s)", outliers, outliers == 1 ? "" : "s");
+  }
+  if (nu_bench_state.noise > nu_bench_state.noise_threshold) {
+    fprintf(log, " NOISY (probe %.1f%% off)", nu_bench_state.noise * 100.0);
+  }
+  fprintf(log, "\n");
+
+  if (nu_bench_state.verbose) {
+    char a[32], b[32], c[32];
+    nu_bench_format_time(a, sizeof(a), st->ci_low, 0);
+    nu_bench_format_time(b, sizeof(b), st->ci_high, 0);
+    nu_bench_format_time(c, sizeof(c), st->mad, 0);
+    fprintf(log, "               median 95%% CI [%s, %s], MAD %s\n", a, b, c);
+
+    nu_bench_format_time(a, sizeof(a), st->mean, 0);
+    nu_bench_format_time(b, sizeof(b), st->stddev, 0);
+    fprintf(log, "               mean %s, stddev %s", a, b);
+    fprintf(log, " (%.1f%%)\n", st->mean > 0.0 ? 100.0 * st->stddev / st->mean : 0.0);
+
+    nu_bench_format_time(a, sizeof(a), st->min, 0);
+    nu_bench_format_time(b, sizeof(b), st->p90, 0);
+    nu_bench_format_time(c, sizeof(c), st->p99, 0);
+    fprintf(log, "               min %s, p90 %s, p99 %s", a, b, c);
+    nu_bench_format_time(a, sizeof(a), st->p999, 0);
+    nu_bench_format_time(b, sizeof(b), st->max, 0);
+    fprintf(log, ", p99.9 %s, max %s\n", a, b);
+
+    fprintf(log, "               %zu samples x %zu iterations, outliers: %zu low, %zu high (%zu severe)\n",
+      st->count, nu_bench_state.batch, st->outliers_low, st->outliers_high, st->outliers_severe);
+
+    const nu_bench_roofline_t* level = nu_bench_roofline_level();
+    if (level) {
+      char rate[32];
+      double fraction = nu_bench_roofline_fraction(level, st);
+      nu_bench_format_rate(rate, sizeof(rate), level->read_bw, "B");
+      fprintf(log, "               roofline: %.1f%% of %s read bandwidth (%s), %s-bound\n",
+        fraction * 100.0, level->name, rate, fraction >= 0.5 ? "memory" : "compute");
+    }
+  }
+
+  if (nu_bench_state.current_threads > 0) {
+    char rate[32];
+    nu_bench_format_rate(rate, sizeof(rate), nu_bench_state.mt_throughput, "ops");
+    fprintf(log, "               %d thread%s: %s aggregate, %.1f%% scaling efficiency\n",
+      nu_bench_state.current_threads, nu_bench_state.current_threads == 1 ? "" : "s",
+      rate, nu_bench_state.mt_efficiency * 100.0);
+  }
+
+  if (nu_bench_state.open_offered > 0.0) {
+    char offered[32], achieved[32], service[32];
+    nu_bench_format_rate(offered, sizeof(offered), nu_bench_state.open_offered, "ops");
+    nu_bench_format_rate(achieved, sizeof(achieved), nu_bench_state.open_achieved, "ops");
+    nu_bench_format_time(service, sizeof(service), nu_bench_state.open_service, 0);
+    fprintf(log, "               offered %s, achieved %s, service time %s%s\n",
+      offered, achieved, service, nu_bench_state.open_saturated ? ", SATURATED" : "");
+  }
+
+  if (nu_bench_state.perf && nu_bench_state.perf_iterations > 0) {
+    nu_bench_report_perf_text(log, "per iteration", 1.0);
+    if (nu_bench_state.items > 0) {
+      nu_bench_report_perf_text(log, "per item", (double)nu_bench_state.items);
+    }
+  }
+
+  if (nu_bench_state.allocs) {
+    char bytes[32], peak[32];
+    nu_bench_format_bytes(bytes, sizeof(bytes), nu_bench_state.alloc_bytes_per_iteration);
+    nu_bench_format_bytes(peak, sizeof(peak), (double)nu_bench_state.alloc_peak_bytes);
+    fprintf(log, "               allocations: %.2f per iteration, %s per iteration, peak %s live\n",
+      nu_bench_state.allocs_per_iteration, bytes, peak);
+  }
+}
+
+// One JSON object per benchmark, streamed into the "benchmarks" array
+static inline void
+nu_bench_report_json (
+  const char* name,
+  const nu_bench_stats_t* st)
+{
+  FILE* out = nu_bench_state.out;
+
+  fprintf(out, "%s\n    {\n      \"name\": ", nu_bench_state.reported > 0 ? "," : "");
+  nu_bench_json_string(out, name);
+  fprintf(out, ",\n      \"batch\": %zu,\n", nu_bench_state.batch);
+  if (nu_bench_state.repetitions > 1) {
+    fprintf(out, "      \"repetition\": %d,\n", nu_bench_state.repetition);
+  }
+  const nu_bench_entry_t* bench = &nu_bench_state.benches[nu_bench_state.current_bench];
+  if (bench->param_fn || bench->group) {
+    fprintf(out, "      \"param\": %" PRId64 ",\n", nu_bench_state.current_param);
+  }
+  if (nu_bench_state.variant_name) {
+    fprintf(out, "      \"group\": ");
+    nu_bench_json_string(out, bench->name);
+    fprintf(out, ",\n      \"variant\": ");
+    nu_bench_json_string(out, nu_bench_state.variant_name);
+    fprintf(out, ",\n      \"baseline\": %s,\n", nu_bench_state.variant_is_baseline ? "true" : "false");
+    fprintf(out, "      \"speedup_vs_baseline\": %.4f,\n", nu_bench_state.variant_speedup);
+    fprintf(out, "      \"p_value_vs_baseline\": %.6f,\n", nu_bench_state.variant_p);
+  }
+  if (nu_bench_state.items > 0) {
+    fprintf(out, "      \"items_per_second\": %.3f,\n", nu_bench_items_per_second(st));
+  }
+  if (nu_bench_state.bytes > 0) {
+    fprintf(out, "      \"bytes_per_second\": %.3f,\n", nu_bench_bytes_per_second(st));
+  }
+  const nu_bench_roofline_t* level = nu_bench_roofline_level();
+  if (level) {
+    double fraction = nu_bench_roofline_fraction(level, st);
+    fprintf(out, "      \"roofline_level\": \"%s\",\n", level->name);
+    fprintf(out, "      \"roofline_fraction\": %.4f,\n", fraction);
+    fprintf(out, "      \"roofline_bound\": \"%s\",\n", fraction >= 0.5 ? "memory" : "compute");
+  }
+  if (nu_bench_state.current_threads > 0) {
+    fprintf(out, "      \"threads\": %d,\n", nu_bench_state.current_threads);
+    fprintf(out, "      \"throughput_per_second\": %.3f,\n", nu_bench_state.mt_throughput);
+    fprintf(out, "      \"scaling_efficiency\": %.4f,\n", nu_bench_state.mt_efficiency);
+  }
+  if (nu_bench_state.open_offered > 0.0) {
+    fprintf(out, "      \"load\": %.4f,\n", nu_bench_state.open_offered / nu_bench_state.open_capacity);
+    fprintf(out, "      \"capacity_per_second\": %.3f,\n", nu_bench_state.open_capacity);
+    fprintf(out, "      \"offered_per_second\": %.3f,\n", nu_bench_state.open_offered);
+    fprintf(out, "      \"achieved_per_second\": %.3f,\n", nu_bench_state.open_achieved);
+    fprintf(out, "      \"service_mean_ns\": %.3f,\n", nu_bench_state.open_service);
+    fprintf(out, "      \"saturated\": %s,\n", nu_bench_state.open_saturated ? "true" : "false");
+  }
+  if (nu_bench_state.perf && nu_bench_state.perf_iterations > 0) {
+    nu_bench_report_perf_json(out, "counters_per_iteration", 1.0);
+    if (nu_bench_state.items > 0) {
+      nu_bench_report_perf_json(out, "counters_per_item", (double)nu_bench_state.items);
+    }
+  }
+  if (nu_bench_state.allocs) {
+    fprintf(out, "      \"allocs_per_iteration\": %.3f,\n", nu_bench_state.allocs_per_iteration);
+    fprintf(out, "      \"alloc_bytes_per_iteration\": %.3f,\n", nu_bench_state.alloc_bytes_per_iteration);
+    fprintf(out, "      \"peak_live_bytes\": %" PRId64 ",\n", nu_bench_state.alloc_peak_bytes);
+  }
+  fprintf(out, "      \"cache\": \"%s\",\n", nu_bench_state.cold ? "cold" : "hot");
+  fprintf(out, "      \"noise\": %.4f,\n", nu_bench_state.noise);
+  fprintf(out, "      \"samples\": %zu,\n", st->count);
+  fprintf(out, "      \"median_ns\": %.3f,\n", st->median);
+  fprintf(out, "      \"ci_low_ns\": %.3f,\n", st->ci_low);
+  fprintf(out, "      \"ci_high_ns\": %.3f,\n", st->ci_high);
+  fprintf(out, "      \"mean_ns\": %.3f,\n", st->mean);
+  fprintf(out, "      \"stddev_ns\": %.3f,\n", st->stddev);
+  fprintf(out, "      \"mad_ns\": %.3f,\n", st->mad);
+  fprintf(out, "      \"min_ns\": %.3f,\n", st->min);
+  fprintf(out, "      \"p90_ns\": %.3f,\n", st->p90);
+  fprintf(out, "      \"p99_ns\": %.3f,\n", st->p99);
+  fprintf(out, "      \"p999_ns\": %.3f,\n", st->p999);
+  fprintf(out, "      \"max_ns\": %.3f,\n", st->max);
+  fprintf(out, "      \"outliers_low\": %zu,\n", st->outliers_low);
+  fprintf(out, "      \"outliers_high\": %zu,\n", st->outliers_high);
+  fprintf(out, "      \"samples_ns\": [");
+  for (size_t i = 0; i < nu_bench_state.time_count; i++) {
+    fprintf(out, "%s%.3f", i % 8 == 0 ? "\n        " : " ", nu_bench_state.times[i]);
+    if (i + 1 < nu_bench_state.time_count)fputc(',', out);
+  }
+  fprintf(out, "\n      ]\n    }");
+}
+
+// One CSV row per sample
+static inline void
+nu_bench_report_csv (const char* name)
+{
+  for (size_t i = 0; i < nu_bench_state.time_count; i++) {
+    fprintf(nu_bench_state.out, "%s,%zu,%zu,%.3f\n",
+      name, nu_bench_state.batch, i, nu_bench_state.times[i]);
+  }
+}
+
+// Compare the current samples against the baseline entry of the same name
+static inline void
+nu_bench_report_baseline (
+  const char* name,
+  const nu_bench_stats_t* st)
+{
+  FILE* log = nu_bench_state.log;
+  const nu_bench_baseline_t* base = nu_bench_baseline_find(name);
+  if (!base) {
+    fprintf(log, "               vs baseline: not present\n");
+    return;
+  }
+
+  double* sorted = NU_MALLOC(base->count * sizeof(double));
+  if (!sorted) {
+    fprintf(stderr, "Benchmark allocation failed\n");
+    exit(1);
+  }
+  memcpy(sorted, base->samples, base->count * sizeof(double));
+  nu_sort(sorted, base->count, sizeof(double), nu_bench_compare_doubles);
+  double base_median = nu_bench_percentile(sorted, base->count, 0.5);
+  NU_FREE(sorted);
+
+  double p      = nu_bench_mann_whitney(nu_bench_state.times, nu_bench_state.time_count,
+    base->samples, base->count);
+  double change = base_median > 0.0 ? st->median / base_median - 1.0 : 0.0;
+  bool significant = p < nu_bench_state.alpha && fabs(change) >= nu_bench_state.threshold;
+
+  fprintf(log, "               vs baseline: %.1f%% %s (speedup %.3fx, p=%.4f)",
+    fabs(change) * 100.0, change > 0.0 ? "slower" : "faster",
+    st->median > 0.0 ? base_median / st->median : 0.0, p);
+  if (significant && change > 0.0) {
+    nu_bench_state.regressions++;
+    fprintf(log, " REGRESSION\n");
+  } else if (significant) {
+    fprintf(log, " improvement\n");
+  } else {
+    fprintf(log, " no significant change\n");
+  }
+}
+
+// Sampling profiler (--profile). A SIGPROF timer on process CPU time
+// captures the stack of whichever thread is inside a timed region; after
+// each result the stacks are folded ("outer;...;inner count" lines, as read
+// by flamegraph.pl, speedscope and similar) into <dir>/<name>.folded, with
+// each '/' of the name a directory (<dir>/<group>/<variant>/<param>.folded
+// for A/B groups). Samples are tagged with the group variant that was
+// running, so interleaved variants get separate profiles.
+// Frames are named by backtrace_symbols(), which sees only dynamic symbols:
+// link with -rdynamic to name the executable's own functions. Static
+// functions have no such symbol and are attributed to their object.
+#define NU_BENCH_PROFILE_DEPTH 48
+#define NU_BENCH_PROFILE_SAMPLES 16384
+#define NU_BENCH_PROFILE_HZ 1000
+#define NU_BENCH_PROFILE_LINE 2048
+
+typedef struct {
+  int32_t depth;
+  int32_t variant;           // Group variant running, -1 outside groups
+  void* pcs[NU_BENCH_PROFILE_DEPTH];
+} nu_bench_profile_sample_t;
+
+static struct {
+  nu_bench_profile_sample_t* samples;
+  _Atomic size_t count;      // Samples taken, may exceed the capacity
+  size_t sampled;            // Samples of the current result
+  volatile sig_atomic_t variant;  // Group variant running, -1 outside groups
+} nu_bench_profile;
+
+static void
+nu_bench_profile_signal (int sig)
+{
+  (void)sig;
+  if (!nu_bench_local.in_region) {
+    return;
+  }
+  int saved  = errno;
+  size_t idx = atomic_fetch_add_explicit(&nu_bench_profile.count, 1, memory_order_relaxed);
+  if (idx < NU_BENCH_PROFILE_SAMPLES) {
+    nu_bench_profile_sample_t* sample = &nu_bench_profile.samples[idx];
+    sample->variant = nu_bench_profile.variant;
+#if NU_BENCH_HAVE_PROFILE
+    sample->depth = backtrace(sample->pcs, NU_BENCH_PROFILE_DEPTH);
+#else
+    sample->depth = 0;
+#endif
+  }
+  errno = saved;
+}
+
+// Allocate the sample buffer and install the SIGPROF handler
+static inline bool
+nu_bench_profile_init (void)
+{
+#if NU_BENCH_HAVE_PROFILE
+  nu_bench_profile.samples = NU_MALLOC(NU_BENCH_PROFILE_SAMPLES * sizeof(nu_bench_profile_sample_t));
+  if (!nu_bench_profile.samples) {
+    fprintf(stderr, "Benchmark allocation failed\n");
+    exit(1);
+  }
+  nu_bench_profile.variant = -1;
+  // The first backtrace() may load the unwinder, which is not safe in a
+  // signal handler
+  void* warm[4];
+  backtrace(warm, 4);
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = nu_bench_profile_signal;
+  action.sa_flags   = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGPROF, &action, NULL) != 0) {
+    fprintf(stderr, "Warning: --profile: cannot install SIGPROF handler\n");
+    return false;
+  }
+  if (mkdir(nu_bench_state.profile_dir, 0755) != 0 && errno != EEXIST) {
+    fprintf(stderr, "Warning: --profile: cannot create %s: %s\n",
+      nu_bench_state.profile_dir, strerror(errno));
+    return false;
+  }
+  return true;
+#else
+  fprintf(stderr, "Warning: --profile is not supported on this platform\n");
+  return false;
+#endif
+}
+
+// Start or stop sampling; samples are only kept inside timed regions
+static inline void
+nu_bench_profile_arm (bool on)
+{
+  struct itimerval timer;
+  memset(&timer, 0, sizeof(timer));
+  if (on) {
+    atomic_store(&nu_bench_profile.count, 0);
+    timer.it_interval.tv_usec = 1000000 / NU_BENCH_PROFILE_HZ;
+    timer.it_value            = timer.it_interval;
+  }
+  setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+// Name of a frame from its backtrace_symbols() line: the function, else
+// "[object]" for code without a dynamic symbol, else the address
+static inline const char*
+nu_bench_profile_symbol (
+  const char* text,
+  uintptr_t pc,
+  char* buf,
+  size_t size)
+{
+  // glibc: "object(function+0x1a) [0x...]" or "object(+0x1a) [0x...]"
+  const char* open = text ? strchr(text, '(') : NULL;
+  if (open) {
+    size_t len = strcspn(open + 1, "+)");
+    if (len > 0) {
+      snprintf(buf, size, "%.*s", (int)len, open + 1);
+      return buf;
+    }
+    const char* file = text;
+    for (const char* c = text; c < open; c++) {
+      if (*c == '/')file = c + 1;
+    }
+    if (open > file) {
+      snprintf(buf, size, "[%.*s]", (int)(open - file), file);
+      return buf;
+    }
+  }
+  // macOS: "3   object   0x0000000100003f2c function + 26"
+  char object[128], function[256];
+  if (text && !open && sscanf(text, "%*d %127s %*s %255s", object, function) == 2) {
+    if (strncmp(function, "0x", 2) != 0) {
+      snprintf(buf, size, "%s", function);
+    } else {
+      snprintf(buf, size, "[%s]", object);
+    }
+    return buf;
+  }
+  snprintf(buf, size, "0x%" PRIxPTR, pc);
+  return buf;
+}
+
+static inline int
+nu_bench_compare_stacks (
+  const void* a,
+  const void* b)
+{
+  const nu_bench_profile_sample_t* x = *(const nu_bench_profile_sample_t* const*)a;
+  const nu_bench_profile_sample_t* y = *(const nu_bench_profile_sample_t* const*)b;
+  if (x->depth != y->depth) {
+    return (x->depth > y->depth) - (x->depth < y->depth);
+  }
+  return memcmp(x->pcs, y->pcs, (size_t)x->depth * sizeof(void*));
+}
+
+typedef struct {
+  const char* line;
+  size_t count;
+} nu_bench_folded_t;
+
+static inline int
+nu_bench_compare_folded (
+  const void* a,
+  const void* b)
+{
+  return strcmp(((const nu_bench_folded_t*)a)->line, ((const nu_bench_folded_t*)b)->line);
+}
+
+// Write one stack as "outer;...;inner" (the first two frames are the signal
+// handler and the signal trampoline)
+static inline void
+nu_bench_profile_fold (
+  const nu_bench_profile_sample_t* sample,
+  char* line,
+  size_t size)
+{
+  const int32_t skip = 2;
+  size_t len = 0;
+  char buf[256];
+  line[0] = '\0';
+  if (sample->depth <= skip) {
+    return;
+  }
+  // Return addresses point after the call; look up the call itself
+  void* pcs[NU_BENCH_PROFILE_DEPTH];
+  for (int32_t f = skip; f < sample->depth; f++) {
+    pcs[f] = (char*)sample->pcs[f] - (f > skip ? 1 : 0);
+  }
+#if NU_BENCH_HAVE_PROFILE
+  char** texts = backtrace_symbols(pcs + skip, sample->depth - skip);
+#else
+  char** texts = NULL;
+#endif
+  for (int32_t f = sample->depth - 1; f >= skip && len < size; f--) {
+    const char* name = nu_bench_profile_symbol(texts ? texts[f - skip] : NULL, (uintptr_t)pcs[f], buf, sizeof(buf));
+    int n = snprintf(line + len, size - len, "%s%s", name, f > skip ? ";" : "");
+    if (n < 0)break;
+    len += (size_t)n;
+  }
+  // Allocated by libc, not through NU_MALLOC
+  free(texts);
+}
+
+// Fold the samples of the result just measured, those taken while group
+// variant `variant` ran (-1 outside groups), into <dir>/<name>.folded
+static inline void
+nu_bench_profile_write (
+  const char* name,
+  int32_t variant)
+{
+  size_t count = atomic_load(&nu_bench_profile.count);
+  size_t taken = count < NU_BENCH_PROFILE_SAMPLES ? count : NU_BENCH_PROFILE_SAMPLES;
+
+  // Each '/' of the name is a directory, created as the path is built
+  char path[512];
+  int len = snprintf(path, sizeof(path), "%s/", nu_bench_state.profile_dir);
+  for (const char* c = name; *c && len > 0 && (size_t)len < sizeof(path) - 8; c++) {
+    if (*c == '/') {
+      path[len] = '\0';
+      if (mkdir(path, 0755) != 0 && errno != EEXIST) {
+        fprintf(nu_bench_state.log, "               profile: cannot create %s: %s\n", path, strerror(errno));
+        return;
+      }
+      path[len++] = '/';
+      continue;
+    }
+    bool plain = (*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9')
+                 || *c == '_' || *c == '-' || *c == '.';
+    path[len++] = plain ? *c : '_';
+  }
+  if (len < 0 || (size_t)len >= sizeof(path) - 8) {
+    return;
+  }
+  snprintf(path + len, sizeof(path) - (size_t)len, ".folded");
+
+  FILE* out = fopen(path, "w");
+  if (!out) {
+    fprintf(nu_bench_state.log, "               profile: cannot write %s: %s\n", path, strerror(errno));
+    return;
+  }
+
+  // Group identical stacks, then merge those that fold to the same line
+  // (different return addresses within the same functions)
+  size_t kept = 0;
+  for (size_t i = 0; i < taken; i++) {
+    kept += nu_bench_profile.samples[i].variant == variant;
+  }
+  const nu_bench_profile_sample_t** stacks = NU_MALLOC((kept + 1) * sizeof(*stacks));
+  nu_bench_folded_t* folded = NU_MALLOC((kept + 1) * sizeof(nu_bench_folded_t));
+  char* text = NU_MALLOC((kept + 1) * NU_BENCH_PROFILE_LINE);
+  if (!stacks || !folded || !text) {
+    fprintf(stderr, "Benchmark allocation failed\n");
+    exit(1);
+  }
+  for (size_t i = 0, k = 0; i < taken; i++) {
+    if (nu_bench_profile.samples[i].variant == variant) {
+      stacks[k++] = &nu_bench_profile.samples[i];
+    }
+  }
+  nu_sort(stacks, kept, sizeof(*stacks), nu_bench_compare_stacks);
+
+  size_t unique = 0;
+  for (size_t i = 0; i < kept;) {
+    size_t j = i + 1;
+    while (j < kept && nu_bench_compare_stacks(&stacks[i], &stacks[j]) == 0) j++;
+    char* line = text + unique * NU_BENCH_PROFILE_LINE;
+    nu_bench_profile_fold(stacks[i], line, NU_BENCH_PROFILE_LINE);
+    if (line[0]) {
+      folded[unique++] = (nu_bench_folded_t){line, j - i};
+    }
+    i = j;
+  }
+  nu_sort(folded, unique, sizeof(nu_bench_folded_t), nu_bench_compare_folded);
+  for (size_t i = 0; i < unique;) {
+    size_t total = 0, j = i;
+    for (; j < unique && strcmp(folded[i].line, folded[j].line) == 0; j++) {
+      total += folded[j].count;
+    }
+    fprintf(out, "%s %zu\n", folded[i].line, total);
+    i = j;
+  }
+
+  NU_FREE(text);
+  NU_FREE(folded);
+  NU_FREE(stacks);
+  fclose(out);
+
+  fprintf(nu_bench_state.log, "               profile: %zu samples -> %s", kept, path);
+  if (count > taken) {
+    fprintf(nu_bench_state.log, " (%zu dropped)", count - taken);
+  }
+  fprintf(nu_bench_state.log, "\n");
+}
+
+// Release the sample buffer
+static inline void
+nu_bench_profile_free (void)
+{
+  NU_FREE(nu_bench_profile.samples);
+  nu_bench_profile.samples = NULL;
+}
+
+// Report a finished benchmark in every requested form
+static inline void
+nu_bench_report (
+  const char* name,
+  const nu_bench_stats_t* st)
+{
+  nu_bench_report_text(name, st);
+  if (nu_bench_state.baseline_count > 0) {
+    nu_bench_report_baseline(name, st);
+  }
+  if (nu_bench_state.format == NU_BENCH_FORMAT_JSON) {
+    nu_bench_report_json(name, st);
+  } else if (nu_bench_state.format == NU_BENCH_FORMAT_CSV) {
+    nu_bench_report_csv(name);
+  }
+  if (nu_bench_state.profile_dir) {
+    nu_bench_profile_write(name, nu_bench_state.variant_name ? nu_bench_state.variant_index : -1);
+  }
+  if (nu_bench_state.noise > nu_bench_state.noise_threshold) {
+    nu_bench_state.noisy++;
+  }
+  nu_bench_state.reported++;
+}
+
+// Forget the samples of the previous result
+static inline void
+nu_bench_reset_samples (void)
+{
+  nu_histogram_reset(&nu_bench_state.histogram);
+  nu_bench_state.time_count     = 0;
+  nu_bench_state.time_seen      = 0;
+  nu_bench_state.time_mean      = 0.0;
+  nu_bench_state.time_m2        = 0.0;
+  nu_bench_state.reservoir_seed = 0x9E3779B97F4A7C15ull;
+}
+
+// Record one sample in O(1) and constant memory: histogram, running mean,
+// and reservoir sampling (Algorithm R) into times
+static inline void
+nu_bench_record_sample (double ns)
+{
+  double ps = ns * 1000.0 + 0.5;
+  int64_t value = ps <= 0.0 ? 0 : ps >= (double)nu_bench_state.histogram.highest
+                  ? nu_bench_state.histogram.highest : (int64_t)ps;
+  nu_histogram_record(&nu_bench_state.histogram, value);
+
+  size_t seen   = ++nu_bench_state.time_seen;
+  double delta  = ns - nu_bench_state.time_mean;
+  nu_bench_state.time_mean += delta / (double)seen;
+  nu_bench_state.time_m2   += delta * (ns - nu_bench_state.time_mean);
+
+  if (nu_bench_state.time_count < NU_BENCH_RESERVOIR) {
+    nu_bench_state.times[nu_bench_state.time_count++] = ns;
+    return;
+  }
+  uint64_t slot = nu_bench_rand(&nu_bench_state.reservoir_seed) % seen;
+  if (slot < NU_BENCH_RESERVOIR) {
+    nu_bench_state.times[slot] = ns;
+  }
+}
+
+// Register memory the benchmark reads so cold mode can flush exactly that;
+// call from NU_BENCH_SETUP. Regions are forgotten after each result.
+static inline void
+nu_bench_cache_region (
+  const void* ptr,
+  size_t size)
+{
+  if (nu_bench_state.cache_region_count < 16) {
+    nu_bench_state.cache_regions[nu_bench_state.cache_region_count].ptr  = ptr;
+    nu_bench_state.cache_regions[nu_bench_state.cache_region_count].size = size;
+    nu_bench_state.cache_region_count++;
+  }
+}
+
+// Size in bytes of the data (or unified) cache at level 1-3 of CPU 0, 0 if
+// it cannot be determined
+static inline size_t
+nu_bench_cache_size (int32_t level)
+{
+  size_t size = 0;
+#ifdef __APPLE__
+  static const char* const names[] = {"hw.l1dcachesize", "hw.l2cachesize", "hw.l3cachesize"};
+  uint64_t bytes = 0;
+  size_t len     = sizeof(bytes);
+  if (level >= 1 && level <= 3 && sysctlbyname(names[level - 1], &bytes, &len, NULL, 0) == 0) {
+    size = (size_t)bytes;
+  }
+#else
+  char path[96];
+  char value[32];
+  for (int32_t index = 0; index < 8 && size == 0; index++) {
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/level", index);
+    if (!nu_bench_read_line(path, NULL, value, sizeof(value)) || atoi(value) != level) {
+      continue;
+    }
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/type", index);
+    if (nu_bench_read_line(path, NULL, value, sizeof(value)) && strcmp(value, "Instruction") == 0) {
+      continue;
+    }
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", index);
+    if (nu_bench_read_line(path, NULL, value, sizeof(value))) {
+      char* unit;
+      size = (size_t)strtoul(value, &unit, 10);
+      size *= *unit == 'M' ? 1024 * 1024 : *unit == 'K' ? 1024 : 1;
+    }
+  }
+#endif
+  return size;
+}
+
+// Last-level cache size in bytes, 32 MiB if it cannot be determined
+static inline size_t
+nu_bench_llc_size (void)
+{
+  size_t size = nu_bench_cache_size(3);
+  return size > 0 ? size : (size_t)32 << 20;
+}
+
+// Allocate the eviction buffer: twice the LLC, capped at 256 MiB, and large
+// enough that a page-stride walk covers more pages than the TLBs hold
+static inline void
+nu_bench_evict_init (void)
+{
+  size_t size = nu_bench_llc_size() * 2;
+  size = size < ((size_t)8 << 20) ? (size_t)8 << 20 : size;
+  size = size > ((size_t)256 << 20) ? (size_t)256 << 20 : size;
+  if (nu_bench_state.tlb_flush && size < ((size_t)64 << 20)) {
+    size = (size_t)64 << 20;
+  }
+
+  nu_bench_state.evict = NU_MALLOC(size);
+  if (!nu_bench_state.evict) {
+    fprintf(stderr, "Benchmark allocation failed\n");
+    exit(1);
+  }
+  memset(nu_bench_state.evict, 0, size);
+  nu_bench_state.evict_size = size;
+}
+
+// Evict the benchmark's data from the caches (and optionally the TLBs)
+static inline void
+nu_bench_evict (void)
+{
+  unsigned char* evict = nu_bench_state.evict;
+  size_t size          = nu_bench_state.evict_size;
+
+#if NU_BENCH_HAVE_TSC
+  if (nu_bench_state.cache_region_count > 0) {
+    for (int32_t r = 0; r < nu_bench_state.cache_region_count; r++) {
+      const char* ptr = nu_bench_state.cache_regions[r].ptr;
+      for (size_t off = 0; off < nu_bench_state.cache_regions[r].size; off += 64) {
+        _mm_clflush(ptr + off);
+      }
+    }
+    _mm_mfence();
+  } else
+#endif
+  {
+    // Write every line so dirty data is written back, not just shadowed
+    for (size_t off = 0; off < size; off += 64) {
+      evict[off]++;
+    }
+  }
+
+  if (nu_bench_state.tlb_flush) {
+    for (size_t off = 0; off < size; off += 4096) {
+      evict[off]++;
+    }
+  }
+  nu_bench_clobber();
+}
+
+// Nanoseconds per load of a pointer chase over a random cyclic chain
+// through every cache line of buf. Each load depends on the previous one and
+// the order defeats the prefetchers, so this is the level's load latency.
+static inline double
+nu_bench_roofline_latency (
+  unsigned char* buf,
+  size_t size,
+  bool warm)
+{
+  size_t lines = size / 64;
+
+  // Sattolo's algorithm: a random permutation with a single cycle, so the
+  // chase visits every line before repeating
+  for (size_t i = 0; i < lines; i++) {
+    *(size_t*)(void*)(buf + i * 64) = i;
+  }
+  uint64_t seed = 0x2545F4914F6CDD1DULL;
+  for (size_t i = lines - 1; i > 0; i--) {
+    size_t j  = (size_t)(nu_bench_rand(&seed) % i);
+    size_t* a = (size_t*)(void*)(buf + i * 64);
+    size_t* b = (size_t*)(void*)(buf + j * 64);
+    size_t t  = *a;
+    *a = *b;
+    *b = t;
+  }
+  for (size_t i = 0; i < lines; i++) {
+    void** slot = (void**)(void*)(buf + i * 64);
+    *slot = buf + *(size_t*)(void*)slot * 64;
+  }
+
+  void* p = buf;
+  if (warm) {
+    for (size_t i = 0; i < lines; i++)p = *(void**)p;
+  }
+  const size_t steps = (size_t)1 << 20;
+  double best = DBL_MAX;
+  for (int32_t r = 0; r < 3; r++) {
+    uint64_t t0 = nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC);
+    for (size_t i = 0; i < steps; i++)p = *(void**)p;
+    best = fmin(best, (double)(nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC) - t0));
+  }
+  nu_bench_do_not_optimize(p);
+  return best / (double)steps;
+}
+
+// Two 64-bit lanes, so the read kernel issues full-width vector loads
+typedef uint64_t nu_bench_vec_t __attribute__((vector_size(16)));
+
+// Streaming bandwidth over buf in bytes/s: kind 0 reads, 1 writes, 2 copies
+// the first half onto the second. Passes repeat until ~256 MiB have moved;
+// the best of three runs is kept.
+static inline double
+nu_bench_roofline_bandwidth (
+  unsigned char* buf,
+  size_t size,
+  int32_t kind)
+{
+  const uint64_t* words = (const uint64_t*)(const void*)buf;
+  size_t count          = size / sizeof(uint64_t);
+  size_t passes         = ((size_t)256 << 20) / size;
+  passes = passes > 0 ? passes : 1;
+  uint64_t sum = 0;
+
+  double best = DBL_MAX;
+  for (int32_t r = 0; r < 3; r++) {
+    uint64_t t0 = nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC);
+    for (size_t p = 0; p < passes; p++) {
+      if (kind == 0) {
+        nu_bench_vec_t s0 = {0}, s1 = {0}, s2 = {0}, s3 = {0}, v;
+        for (size_t i = 0; i + 8 <= count; i += 8) {
+          memcpy(&v, words + i, sizeof(v));
+          s0 += v;
+          memcpy(&v, words + i + 2, sizeof(v));
+          s1 += v;
+          memcpy(&v, words + i + 4, sizeof(v));
+          s2 += v;
+          memcpy(&v, words + i + 6, sizeof(v));
+          s3 += v;
+        }
+        s0  += s1 + s2 + s3;
+        sum += s0[0] + s0[1];
+      } else if (kind == 1) {
+        memset(buf, (int)(p & 0xFF), size);
+      } else {
+        memcpy(buf + size / 2, buf, size / 2);
+      }
+      nu_bench_do_not_optimize(buf);
+    }
+    best = fmin(best, (double)(nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC) - t0));
+  }
+  nu_bench_do_not_optimize(&sum);
+  size_t bytes = kind == 2 ? size / 2 * 2 : size;
+  return (double)bytes * (double)passes * 1e9 / best;
+}
+
+// Measure latency and bandwidth of each cache level (on a working set of
+// half its size) and of DRAM (four times the LLC, 64 MiB to 1 GiB), on the
+// calling thread. Levels whose size is unknown are skipped.
+static inline void
+nu_bench_roofline_init (void)
+{
+  static const char* const names[] = {"L1", "L2", "L3"};
+  size_t llc = nu_bench_llc_size();
+  size_t max = llc * 4;
+  max = max < ((size_t)64 << 20) ? (size_t)64 << 20 : max;
+  max = max > ((size_t)1 << 30) ? (size_t)1 << 30 : max;
+
+  unsigned char* buf = NU_MALLOC(max);
+  while (!buf && max > llc * 2 && max > ((size_t)64 << 20)) {
+    max /= 2;
+    buf = NU_MALLOC(max);
+  }
+  if (!buf) {
+    nu_bench_warn("cannot allocate the roofline buffer; --roofline disabled");
+    return;
+  }
+  memset(buf, 1, max);
+
+  int32_t count = 0;
+  for (int32_t level = 1; level <= 4; level++) {
+    size_t size = level <= 3 ? nu_bench_cache_size(level) : 0;
+    size_t working_set = level <= 3 ? size / 2 : max;
+    if (level <= 3 && (size == 0 || working_set > max)) {
+      continue;
+    }
+    working_set &= ~(size_t)4095;
+
+    nu_bench_roofline_t* l = &nu_bench_state.levels[count++];
+    l->name        = level <= 3 ? names[level - 1] : "DRAM";
+    l->size        = size;
+    l->working_set = working_set;
+    l->read_bw     = nu_bench_roofline_bandwidth(buf, working_set, 0);
+    l->write_bw    = nu_bench_roofline_bandwidth(buf, working_set, 1);
+    l->copy_bw     = nu_bench_roofline_bandwidth(buf, working_set, 2);
+    l->latency_ns  = nu_bench_roofline_latency(buf, working_set, level <= 3);
+  }
+  nu_bench_state.level_count = count;
+
+  NU_FREE(buf);
+}
+
+// Zero the calling thread's allocation counters
+static inline void
+nu_bench_alloc_reset (void)
+{
+  nu_bench_local.allocs      = 0;
+  nu_bench_local.alloc_bytes = 0;
+  nu_bench_local.live_bytes  = 0;
+  nu_bench_local.peak_bytes  = 0;
+}
+
+// Turn allocation totals over `iterations` invocations into the result
+static inline void
+nu_bench_alloc_result (
+  uint64_t allocs,
+  uint64_t bytes,
+  int64_t peak,
+  size_t iterations)
+{
+  double n = iterations > 0 ? (double)iterations : 1.0;
+  nu_bench_state.allocs_per_iteration      = (double)allocs / n;
+  nu_bench_state.alloc_bytes_per_iteration = (double)bytes / n;
+  nu_bench_state.alloc_peak_bytes          = peak;
+}
+
+// Invoke the body batch times; returns the summed timed-region ns
+static inline double
+nu_bench_run_batch (
+  nu_bench_entry_t* bench,
+  size_t batch)
+{
+  nu_bench_local.region_ns = 0.0;
+  for (size_t i = 0; i < batch; i++) {
+    if (bench->reset) {
+      bench->reset(nu_bench_state.current_param);
+    }
+    if (nu_bench_state.cold) {
+      nu_bench_evict();
+    }
+    nu_bench_local.live_bytes = 0;
+    if (nu_bench_state.variant) {
+      nu_bench_state.variant(nu_bench_state.current_param);
+    } else if (bench->param_fn) {
+      bench->param_fn(nu_bench_state.current_param);
+    } else {
+      bench->fn();
+    }
+    nu_bench_state.current_iteration++;
+  }
+  nu_bench_state.items = nu_bench_local.items;
+  nu_bench_state.bytes = nu_bench_local.bytes;
+  return nu_bench_local.region_ns;
+}
+
+// Double the batch until one sample takes at least sample_time. Gives up
+// growing once the wall-clock budget is spent, which also covers bodies that
+// never call NU_BENCH_START/NU_BENCH_END.
+static inline size_t
+nu_bench_calibrate_batch (nu_bench_entry_t* bench)
+{
+  uint64_t t0  = nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC);
+  size_t batch = 1;
+
+  for (;;) {
+    double ns      = nu_bench_run_batch(bench, batch);
+    double elapsed = (double)(nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC) - t0);
+    if (ns >= nu_bench_state.sample_time || elapsed >= nu_bench_state.time_budget) {
+      return batch;
+    }
+    batch *= 2;
+  }
+}
+
+// Collect the samples of one benchmark (for the current param)
+static inline void
+nu_bench_collect (int32_t idx)
+{
+  nu_bench_entry_t* bench = &nu_bench_state.benches[idx];
+
+  // Reset timing data
+  nu_bench_state.current_bench     = idx;
+  nu_bench_state.current_iteration = 0;
+  nu_bench_state.items             = 0;
+  nu_bench_state.bytes             = 0;
+  nu_bench_local.items             = 0;
+  nu_bench_local.bytes             = 0;
+  nu_bench_state.perf_iterations   = 0;
+  nu_bench_state.perf_enabled      = 0.0;
+  nu_bench_state.perf_running      = 0.0;
+  memset(nu_bench_state.perf_total, 0, sizeof(nu_bench_state.perf_total));
+  nu_bench_reset_samples();
+
+  double noise_before = nu_bench_probe_noise();
+  nu_bench_state.cache_region_count = 0;
+  if (bench->setup) {
+    bench->setup(nu_bench_state.current_param);
+  }
+
+  // Size the batch, then warm up with it for at most a tenth of the budget.
+  // Cold samples are single evicted invocations, so neither applies.
+  size_t batch = nu_bench_state.cold ? 1 : nu_bench_calibrate_batch(bench);
+  nu_bench_state.batch = batch;
+
+  uint64_t t0 = nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC);
+  for (size_t i = 0; i < nu_bench_state.warmup_runs && !nu_bench_state.cold; i++) {
+    if ((double)(nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC) - t0) >= nu_bench_state.time_budget / 10.0) {
+      break;
+    }
+    nu_bench_run_batch(bench, batch);
+  }
+
+  // Sample until -n is reached or, adaptively, until the mean is known to
+  // within rel_error or the budget runs out (after min_samples either way)
+  double mean = 0.0, m2 = 0.0;
+  nu_bench_alloc_reset();
+  if (nu_bench_state.profile_dir) {
+    nu_bench_profile_arm(true);
+  }
+  t0 = nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC);
+  for (;;) {
+    nu_bench_local.perf_counting = nu_bench_state.perf;
+    double ns = nu_bench_run_batch(bench, batch) / (double)batch;
+    nu_bench_local.perf_counting    = false;
+    nu_bench_state.perf_iterations += batch;
+    nu_bench_record_sample(ns);
+
+    size_t n     = nu_bench_state.time_seen;
+    double delta = ns - mean;
+    mean += delta / (double)n;
+    m2   += delta * (ns - mean);
+
+    if (nu_bench_state.total_iterations > 0) {
+      if (n >= nu_bench_state.total_iterations)break;
+      continue;
+    }
+    if (n < nu_bench_state.min_samples || n < 2) {
+      continue;
+    }
+    // A profile needs the whole budget to collect enough samples
+    double std_err = sqrt(m2 / (double)(n - 1) / (double)n);
+    if (mean > 0.0 && std_err / mean <= nu_bench_state.rel_error && !nu_bench_state.profile_dir) {
+      break;
+    }
+    if ((double)(nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC) - t0) >= nu_bench_state.time_budget) {
+      break;
+    }
+  }
+
+  if (nu_bench_state.profile_dir) {
+    nu_bench_profile_arm(false);
+  }
+  nu_bench_alloc_result(nu_bench_local.allocs, nu_bench_local.alloc_bytes,
+    nu_bench_local.peak_bytes, nu_bench_state.perf_iterations);
+
+  if (bench->teardown) {
+    bench->teardown(nu_bench_state.current_param);
+  }
+  nu_bench_state.noise = fmax(noise_before, nu_bench_probe_noise());
+}
+
+static inline bool
+nu_bench_matches (const char* name)
+{
+  return !nu_bench_state.filter || strstr(name, nu_bench_state.filter) != NULL;
+}
+
+// Barrier built on a mutex and condition variable (pthread_barrier_t is not
+// available everywhere)
+typedef struct {
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  int32_t parties;
+  int32_t waiting;
+  uint64_t generation;
+} nu_bench_barrier_t;
+
+static inline void
+nu_bench_barrier_init (
+  nu_bench_barrier_t* barrier,
+  int32_t parties)
+{
+  pthread_mutex_init(&barrier->mutex, NULL);
+  pthread_cond_init(&barrier->cond, NULL);
+  barrier->parties    = parties;
+  barrier->waiting    = 0;
+  barrier->generation = 0;
+}
+
+static inline void
+nu_bench_barrier_destroy (nu_bench_barrier_t* barrier)
+{
+  pthread_cond_destroy(&barrier->cond);
+  pthread_mutex_destroy(&barrier->mutex);
+}
+
+static inline void
+nu_bench_barrier_wait (nu_bench_barrier_t* barrier)
+{
+  pthread_mutex_lock(&barrier->mutex);
+  uint64_t generation = barrier->generation;
+  if (++barrier->waiting == barrier->parties) {
+    barrier->waiting = 0;
+    barrier->generation++;
+    pthread_cond_broadcast(&barrier->cond);
+  } else {
+    while (generation == barrier->generation) {
+      pthread_cond_wait(&barrier->cond, &barrier->mutex);
+    }
+  }
+  pthread_mutex_unlock(&barrier->mutex);
+}
+
+// One NU_BENCH_MT worker; results are read by the main thread between rounds
+typedef struct {
+  pthread_t thread;
+  int32_t index;
+  int32_t cpu;
+  double region_ns;          // Timed-region total of the last round
+  uint64_t items;
+  uint64_t bytes;
+  uint64_t allocs;           // Allocation counters of the last round
+  uint64_t alloc_bytes;
+  int64_t peak_bytes;
+} nu_bench_worker_t;
+
+// Shared by the workers of the current NU_BENCH_MT run. Every round starts
+// on the `start` barrier and ends on `done`, so the fields written between
+// rounds are ordered by the barrier mutex.
+static struct {
+  nu_bench_barrier_t start;
+  nu_bench_barrier_t done;
+  nu_bench_mt_fn fn;
+  int32_t threads;
+  size_t batch;
+  bool stop;
+  nu_bench_worker_t workers[NU_BENCH_MAX_THREADS];
+} nu_bench_mt;
+
+static inline void*
+nu_bench_mt_worker (void* arg)
+{
+  nu_bench_worker_t* worker = arg;
+  nu_bench_pin_thread(worker->cpu);
+
+  for (;;) {
+    nu_bench_barrier_wait(&nu_bench_mt.start);
+    if (nu_bench_mt.stop) {
+      break;
+    }
+    nu_bench_local.region_ns = 0.0;
+    nu_bench_alloc_reset();
+    for (size_t i = 0; i < nu_bench_mt.batch; i++) {
+      nu_bench_local.live_bytes = 0;
+      nu_bench_mt.fn(worker->index, nu_bench_mt.threads);
+    }
+    worker->region_ns   = nu_bench_local.region_ns;
+    worker->items       = nu_bench_local.items;
+    worker->bytes       = nu_bench_local.bytes;
+    worker->allocs      = nu_bench_local.allocs;
+    worker->alloc_bytes = nu_bench_local.alloc_bytes;
+    worker->peak_bytes  = nu_bench_local.peak_bytes;
+    nu_bench_barrier_wait(&nu_bench_mt.done);
+  }
+  return NULL;
+}
+
+// Release all workers for one round of `batch` invocations each and wait
+// for the slowest; returns the longest per-thread timed total
+static inline double
+nu_bench_mt_round (size_t batch)
+{
+  nu_bench_mt.batch = batch;
+  nu_bench_barrier_wait(&nu_bench_mt.start);
+  nu_bench_barrier_wait(&nu_bench_mt.done);
+
+  double longest = 0.0;
+  for (int32_t t = 0; t < nu_bench_mt.threads; t++) {
+    longest = fmax(longest, nu_bench_mt.workers[t].region_ns);
+  }
+  return longest;
+}
+
+// Collect one NU_BENCH_MT benchmark at a given thread count. Samples are the
+// per-thread latencies of every round, pooled; throughput is the sum of the
+// per-thread rates of a round, averaged over rounds.
+static inline void
+nu_bench_collect_mt (
+  int32_t idx,
+  int32_t threads)
+{
+  nu_bench_entry_t* bench = &nu_bench_state.benches[idx];
+  double noise_before     = nu_bench_probe_noise();
+
+  if (bench->setup) {
+    bench->setup(threads);
+  }
+
+  nu_bench_state.current_bench   = idx;
+  nu_bench_state.current_threads = threads;
+  nu_bench_state.perf_iterations = 0;
+  nu_bench_reset_samples();
+
+  nu_bench_barrier_init(&nu_bench_mt.start, threads + 1);
+  nu_bench_barrier_init(&nu_bench_mt.done, threads + 1);
+  nu_bench_mt.fn      = bench->mt_fn;
+  nu_bench_mt.threads = threads;
+  nu_bench_mt.stop    = false;
+  for (int32_t t = 0; t < threads; t++) {
+    nu_bench_worker_t* worker = &nu_bench_mt.workers[t];
+    worker->index = t;
+    worker->cpu   = nu_bench_state.cpus[t % nu_bench_state.cpu_count];
+    worker->items = 0;
+    worker->bytes = 0;
+    if (pthread_create(&worker->thread, NULL, nu_bench_mt_worker, worker) != 0) {
+      fprintf(stderr, "ERROR: Cannot create benchmark thread %d\n", t);
+      exit(1);
+    }
+  }
+
+  // Size the batch so the slowest thread's sample reaches sample_time
+  uint64_t t0  = nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC);
+  size_t batch = 1;
+  while (nu_bench_mt_round(batch) < nu_bench_state.sample_time
+         && (double)(nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC) - t0) < nu_bench_state.time_budget) {
+    batch *= 2;
+  }
+  nu_bench_state.batch = batch;
+
+  t0 = nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC);
+  for (size_t i = 0; i < nu_bench_state.warmup_runs; i++) {
+    if ((double)(nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC) - t0) >= nu_bench_state.time_budget / 10.0) {
+      break;
+    }
+    nu_bench_mt_round(batch);
+  }
+
+  // Same stopping rule as nu_bench_collect, applied to aggregate throughput
+  double mean = 0.0, m2 = 0.0;
+  size_t rounds = 0;
+  uint64_t allocs = 0, alloc_bytes = 0;
+  int64_t peak_bytes = 0;
+  if (nu_bench_state.profile_dir) {
+    nu_bench_profile_arm(true);
+  }
+  t0 = nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC);
+  for (;;) {
+    nu_bench_mt_round(batch);
+
+    double throughput = 0.0;
+    for (int32_t t = 0; t < threads; t++) {
+      nu_bench_worker_t* worker = &nu_bench_mt.workers[t];
+      double ns = worker->region_ns;
+      nu_bench_record_sample(ns / (double)batch);
+      if (ns > 0.0)throughput += (double)batch * 1e9 / ns;
+      allocs      += worker->allocs;
+      alloc_bytes += worker->alloc_bytes;
+      if (worker->peak_bytes > peak_bytes)peak_bytes = worker->peak_bytes;
+    }
+
+    rounds++;
+    double delta = throughput - mean;
+    mean += delta / (double)rounds;
+    m2   += delta * (throughput - mean);
+
+    if (nu_bench_state.total_iterations > 0) {
+      if (rounds >= nu_bench_state.total_iterations)break;
+      continue;
+    }
+    if (rounds < nu_bench_state.min_samples || rounds < 2) {
+      continue;
+    }
+    double std_err = sqrt(m2 / (double)(rounds - 1) / (double)rounds);
+    if (mean > 0.0 && std_err / mean <= nu_bench_state.rel_error && !nu_bench_state.profile_dir) {
+      break;
+    }
+    if ((double)(nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC) - t0) >= nu_bench_state.time_budget) {
+      break;
+    }
+  }
+
+  if (nu_bench_state.profile_dir) {
+    nu_bench_profile_arm(false);
+  }
+  nu_bench_mt.stop = true;
+  nu_bench_barrier_wait(&nu_bench_mt.start);
+  for (int32_t t = 0; t < threads; t++) {
+    pthread_join(nu_bench_mt.workers[t].thread, NULL);
+  }
+  nu_bench_barrier_destroy(&nu_bench_mt.start);
+  nu_bench_barrier_destroy(&nu_bench_mt.done);
+  if (bench->teardown) {
+    bench->teardown(threads);
+  }
+
+  nu_bench_state.noise         = fmax(noise_before, nu_bench_probe_noise());
+  nu_bench_state.mt_throughput = mean;
+  nu_bench_state.items         = nu_bench_mt.workers[0].items;
+  nu_bench_state.bytes         = nu_bench_mt.workers[0].bytes;
+  nu_bench_alloc_result(allocs, alloc_bytes, peak_bytes, rounds * batch * (size_t)threads);
+}
+
+// Run an NU_BENCH_MT benchmark at each thread count (--threads, or powers of
+// two up to the usable CPUs); efficiency is relative to the first count run
+static inline int32_t
+nu_bench_run_mt (int32_t idx)
+{
+  nu_bench_entry_t* bench = &nu_bench_state.benches[idx];
+  int32_t counts[32];
+  size_t runs = 0;
+
+  if (nu_bench_state.thread_runs > 0) {
+    for (size_t i = 0; i < nu_bench_state.thread_runs; i++) {
+      counts[runs++] = nu_bench_state.threads[i];
+    }
+  } else {
+    for (int32_t t = 1; t < nu_bench_state.cpu_count && runs < 31; t *= 2) {
+      counts[runs++] = t;
+    }
+    counts[runs++] = nu_bench_state.cpu_count;
+  }
+
+  double base = 0.0;
+  int32_t reported = 0;
+  for (size_t r = 0; r < runs; r++) {
+    char name[160];
+    snprintf(name, sizeof(name), "%s/threads:%d", bench->name, counts[r]);
+    if (!nu_bench_matches(name)) {
+      continue;
+    }
+
+    nu_bench_stats_t st;
+    nu_bench_collect_mt(idx, counts[r]);
+    double per_thread = nu_bench_state.mt_throughput / (double)counts[r];
+    if (base <= 0.0)base = per_thread;
+    nu_bench_state.mt_efficiency = base > 0.0 ? per_thread / base : 0.0;
+
+    nu_bench_calculate_stats(&st);
+    nu_bench_report(name, &st);
+    reported++;
+  }
+  nu_bench_state.current_threads = 0;
+  return reported;
+}
+
+// Measure and report one result hot, cold or both; cold results are named
+// "<name>/cold". Returns the median of the first (hot if measured) run.
+static inline double
+nu_bench_measure (
+  int32_t idx,
+  const char* name)
+{
+  nu_bench_stats_t st;
+  double hot = 0.0;
+
+  if (nu_bench_state.cache != NU_BENCH_CACHE_COLD) {
+    nu_bench_collect(idx);
+    nu_bench_calculate_stats(&st);
+    nu_bench_report(name, &st);
+    hot = st.median;
+  }
+  if (nu_bench_state.cache == NU_BENCH_CACHE_HOT) {
+    return hot;
+  }
+
+  char cold_name[176];
+  snprintf(cold_name, sizeof(cold_name), "%s/cold", name);
+  nu_bench_state.cold = true;
+  nu_bench_collect(idx);
+  nu_bench_calculate_stats(&st);
+  nu_bench_report(cold_name, &st);
+  nu_bench_state.cold = false;
+
+  if (nu_bench_state.cache == NU_BENCH_CACHE_COLD) {
+    return st.median;
+  }
+  char hot_buf[32], cold_buf[32];
+  nu_bench_format_time(hot_buf, sizeof(hot_buf), hot, 0);
+  nu_bench_format_time(cold_buf, sizeof(cold_buf), st.median, 0);
+  fprintf(nu_bench_state.log, "               hot %s, cold %s (%.2fx)\n",
+    hot_buf, cold_buf, hot > 0.0 ? st.median / hot : 0.0);
+  return hot;
+}
+
+// Samples of the variants of the group being collected, per variant
+typedef struct {
+  bool selected;             // Matches the filter (the baseline always runs)
+  size_t batch;
+  size_t count;              // Samples held in the reservoir
+  size_t seen;               // Samples taken
+  double mean;               // Welford running mean and M2
+  double m2;
+  size_t iterations;
+  uint64_t items;
+  uint64_t bytes;
+  uint64_t allocs;
+  uint64_t alloc_bytes;
+  int64_t peak_bytes;
+  double perf_total[NU_BENCH_PERF_COUNT];  // Hardware counters (--perf)
+  double perf_enabled;
+  double perf_running;
+} nu_bench_variant_run_t;
+
+static struct {
+  double* samples;           // NU_BENCH_RESERVOIR per variant
+  nu_bench_variant_run_t runs[NU_BENCH_MAX_VARIANTS];
+} nu_bench_group;
+
+// Record one sample of a variant: running mean and reservoir
+static inline void
+nu_bench_group_record (
+  int32_t v,
+  double ns)
+{
+  nu_bench_variant_run_t* run = &nu_bench_group.runs[v];
+  double* samples = nu_bench_group.samples + (size_t)v * NU_BENCH_RESERVOIR;
+
+  size_t seen  = ++run->seen;
+  double delta = ns - run->mean;
+  run->mean += delta / (double)seen;
+  run->m2   += delta * (ns - run->mean);
+
+  if (run->count < NU_BENCH_RESERVOIR) {
+    samples[run->count++] = ns;
+    return;
+  }
+  uint64_t slot = nu_bench_rand(&nu_bench_state.reservoir_seed) % seen;
+  if (slot < NU_BENCH_RESERVOIR) {
+    samples[slot] = ns;
+  }
+}
+
+// Collect the selected variants of a group (for the current param). The
+// input is generated once; every round then takes one sample of each
+// variant in a freshly shuffled order, so drift in the machine (frequency,
+// temperature, background load) is spread evenly over the variants instead
+// of favoring whichever happens to run first.
+static inline void
+nu_bench_collect_group (int32_t idx)
+{
+  nu_bench_entry_t* bench = &nu_bench_state.benches[idx];
+  int32_t order[NU_BENCH_MAX_VARIANTS];
+  int32_t active = 0;
+
+  nu_bench_state.current_bench     = idx;
+  nu_bench_state.current_iteration = 0;
+  nu_bench_state.perf_iterations   = 0;
+  nu_bench_state.reservoir_seed    = 0x9E3779B97F4A7C15ull;
+  for (int32_t v = 0; v < bench->variant_count; v++) {
+    nu_bench_variant_run_t* run = &nu_bench_group.runs[v];
+    bool selected = run->selected;
+    memset(run, 0, sizeof(*run));
+    run->selected = selected;
+    if (selected)order[active++] = v;
+  }
+
+  double noise_before = nu_bench_probe_noise();
+  nu_bench_state.cache_region_count = 0;
+  if (bench->setup) {
+    bench->setup(nu_bench_state.current_param);
+  }
+
+  // Size each variant's batch, then warm all of them up in turn
+  for (int32_t k = 0; k < active; k++) {
+    nu_bench_state.variant = bench->variants[order[k]].fn;
+    nu_bench_group.runs[order[k]].batch = nu_bench_state.cold ? 1 : nu_bench_calibrate_batch(bench);
+  }
+  uint64_t t0 = nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC);
+  for (size_t i = 0; i < nu_bench_state.warmup_runs && !nu_bench_state.cold; i++) {
+    if ((double)(nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC) - t0) >= nu_bench_state.time_budget / 10.0) {
+      break;
+    }
+    for (int32_t k = 0; k < active; k++) {
+      nu_bench_state.variant = bench->variants[order[k]].fn;
+      nu_bench_run_batch(bench, nu_bench_group.runs[order[k]].batch);
+    }
+  }
+
+  // Same stopping rule as nu_bench_collect, once every variant meets it; the
+  // budget is per variant
+  uint64_t seed = 0x2545F4914F6CDD1Dull;
+  double budget = nu_bench_state.time_budget * (double)active;
+  if (nu_bench_state.profile_dir) {
+    nu_bench_profile_arm(true);
+  }
+  t0 = nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC);
+  for (size_t rounds = 1;; rounds++) {
+    for (int32_t k = active - 1; k > 0; k--) {
+      int32_t j = (int32_t)(nu_bench_rand(&seed) % (uint64_t)(k + 1));
+      int32_t t = order[k];
+      order[k] = order[j];
+      order[j] = t;
+    }
+
+    for (int32_t k = 0; k < active; k++) {
+      nu_bench_variant_run_t* run = &nu_bench_group.runs[order[k]];
+      nu_bench_state.variant = bench->variants[order[k]].fn;
+      nu_bench_local.items   = 0;
+      nu_bench_local.bytes   = 0;
+      nu_bench_alloc_reset();
+      nu_bench_state.perf_enabled = 0.0;
+      nu_bench_state.perf_running = 0.0;
+      memset(nu_bench_state.perf_total, 0, sizeof(nu_bench_state.perf_total));
+      nu_bench_profile.variant     = order[k];
+      nu_bench_local.perf_counting = nu_bench_state.perf;
+      double ns = nu_bench_run_batch(bench, run->batch) / (double)run->batch;
+      nu_bench_local.perf_counting = false;
+      nu_bench_profile.variant     = -1;
+      nu_bench_group_record(order[k], ns);
+
+      run->perf_enabled += nu_bench_state.perf_enabled;
+      run->perf_running += nu_bench_state.perf_running;
+      for (int32_t e = 0; e < NU_BENCH_PERF_COUNT; e++) {
+        run->perf_total[e] += nu_bench_state.perf_total[e];
+      }
+
+      run->iterations  += run->batch;
+      run->items        = nu_bench_state.items;
+      run->bytes        = nu_bench_state.bytes;
+      run->allocs      += nu_bench_local.allocs;
+      run->alloc_bytes += nu_bench_local.alloc_bytes;
+      if (nu_bench_local.peak_bytes > run->peak_bytes)run->peak_bytes = nu_bench_local.peak_bytes;
+    }
+
+    if (nu_bench_state.total_iterations > 0) {
+      if (rounds >= nu_bench_state.total_iterations)break;
+      continue;
+    }
+    if (rounds < nu_bench_state.min_samples || rounds < 2) {
+      continue;
+    }
+    bool precise = true;
+    for (int32_t k = 0; k < active; k++) {
+      const nu_bench_variant_run_t* run = &nu_bench_group.runs[order[k]];
+      double std_err = sqrt(run->m2 / (double)(run->seen - 1) / (double)run->seen);
+      if (!(run->mean > 0.0 && std_err / run->mean <= nu_bench_state.rel_error))precise = false;
+    }
+    // A profile needs the whole budget to collect enough samples
+    if (precise && !nu_bench_state.profile_dir) {
+      break;
+    }
+    if ((double)(nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC) - t0) >= budget) {
+      break;
+    }
+  }
+  nu_bench_state.variant = NULL;
+  if (nu_bench_state.profile_dir) {
+    nu_bench_profile_arm(false);
+  }
+
+  if (bench->teardown) {
+    bench->teardown(nu_bench_state.current_param);
+  }
+  nu_bench_state.noise = fmax(noise_before, nu_bench_probe_noise());
+}
+
+// Make a collected variant the current result
+static inline void
+nu_bench_group_load (int32_t v)
+{
+  const nu_bench_variant_run_t* run = &nu_bench_group.runs[v];
+  const double* samples = nu_bench_group.samples + (size_t)v * NU_BENCH_RESERVOIR;
+
+  nu_bench_reset_samples();
+  for (size_t i = 0; i < run->count; i++) {
+    nu_bench_record_sample(samples[i]);
+  }
+  nu_bench_state.batch           = run->batch;
+  nu_bench_state.items           = run->items;
+  nu_bench_state.bytes           = run->bytes;
+  nu_bench_state.perf_iterations = run->iterations;
+  nu_bench_state.perf_enabled    = run->perf_enabled;
+  nu_bench_state.perf_running    = run->perf_running;
+  memcpy(nu_bench_state.perf_total, run->perf_total, sizeof(nu_bench_state.perf_total));
+  nu_bench_alloc_result(run->allocs, run->alloc_bytes, run->peak_bytes, run->iterations);
+}
+
+// Conventional significance marker of a p-value
+static inline const char*
+nu_bench_significance (double p)
+{
+  return p < 0.001 ? "***" : p < 0.01 ? "**" : p < 0.05 ? "*" : "ns";
+}
+
+// Measure the selected variants of a group on the current param, hot or
+// cold, and report each ("<group>/<variant>/<param>[/cold]") followed by a
+// table relative to the baseline. Medians are stored per variant; returns
+// the number of results reported.
+static inline int32_t
+nu_bench_measure_group (
+  int32_t idx,
+  double* medians)
+{
+  nu_bench_entry_t* bench = &nu_bench_state.benches[idx];
+  FILE* log               = nu_bench_state.log;
+  const char* suffix      = nu_bench_state.cold ? "/cold" : "";
+  int32_t base            = bench->baseline_variant >= 0 ? bench->baseline_variant : 0;
+  const double* base_samples = nu_bench_group.samples + (size_t)base * NU_BENCH_RESERVOIR;
+
+  nu_bench_collect_group(idx);
+
+  // Baseline first, so the others can be reported relative to it
+  int32_t order[NU_BENCH_MAX_VARIANTS];
+  int32_t active = 0;
+  order[active++] = base;
+  for (int32_t v = 0; v < bench->variant_count; v++) {
+    if (v != base && nu_bench_group.runs[v].selected)order[active++] = v;
+  }
+
+  nu_bench_stats_t st[NU_BENCH_MAX_VARIANTS];
+  double p[NU_BENCH_MAX_VARIANTS];
+  for (int32_t k = 0; k < active; k++) {
+    int32_t v = order[k];
+    char name[192];
+    snprintf(name, sizeof(name), "%s/%s/%" PRId64 "%s",
+      bench->name, bench->variants[v].name, nu_bench_state.current_param, suffix);
+
+    nu_bench_group_load(v);
+    nu_bench_calculate_stats(&st[v]);
+    p[v] = v == base ? 1.0 : nu_bench_mann_whitney(
+      nu_bench_group.samples + (size_t)v * NU_BENCH_RESERVOIR, nu_bench_group.runs[v].count,
+      base_samples, nu_bench_group.runs[base].count);
+
+    nu_bench_state.variant_name        = bench->variants[v].name;
+    nu_bench_state.variant_index       = v;
+    nu_bench_state.variant_is_baseline = v == base;
+    nu_bench_state.variant_speedup     = st[v].median > 0.0 ? st[base].median / st[v].median : 0.0;
+    nu_bench_state.variant_p           = p[v];
+    nu_bench_report(name, &st[v]);
+    medians[v] = st[v].median;
+  }
+  nu_bench_state.variant_name = NULL;
+
+  if (active > 1) {
+    fprintf(log, "  %s/%" PRId64 "%s relative to %s:\n",
+      bench->name, nu_bench_state.current_param, suffix, bench->variants[base].name);
+    for (int32_t k = 0; k < active; k++) {
+      int32_t v = order[k];
+      char time_buf[32];
+      nu_bench_format_time(time_buf, sizeof(time_buf), st[v].median, 9);
+      fprintf(log, "    %-20s %s", bench->variants[v].name, time_buf);
+      double speedup = st[v].median > 0.0 ? st[base].median / st[v].median : 0.0;
+      if (v == base) {
+        fprintf(log, "     baseline\n");
+      } else if (speedup >= 1.0) {
+        fprintf(log, "  %6.2fx faster  %s\n", speedup, nu_bench_significance(p[v]));
+      } else {
+        fprintf(log, "  %6.2fx slower  %s\n", speedup > 0.0 ? 1.0 / speedup : 0.0, nu_bench_significance(p[v]));
+      }
+    }
+  }
+  return active;
+}
+
+// Run a group at every point of its sweep, hot, cold or both; the fitted
+// complexity is reported per variant, from the first of those runs
+static inline int32_t
+nu_bench_run_group (int32_t idx)
+{
+  nu_bench_entry_t* bench = &nu_bench_state.benches[idx];
+  int32_t base            = bench->baseline_variant >= 0 ? bench->baseline_variant : 0;
+  if (bench->variant_count == 0) {
+    return 0;
+  }
+
+  nu_bench_group.samples = NU_MALLOC((size_t)bench->variant_count * NU_BENCH_RESERVOIR * sizeof(double));
+  if (!nu_bench_group.samples) {
+    fprintf(stderr, "Benchmark allocation failed\n");
+    exit(1);
+  }
+
+  double ns[NU_BENCH_MAX_VARIANTS][NU_BENCH_MAX_PARAMS];
+  double n[NU_BENCH_MAX_VARIANTS][NU_BENCH_MAX_PARAMS];
+  size_t points[NU_BENCH_MAX_VARIANTS] = {0};
+  int32_t reported = 0;
+
+  for (size_t p = 0; p < bench->param_count; p++) {
+    bool any = false;
+    for (int32_t v = 0; v < bench->variant_count; v++) {
+      char name[192];
+      snprintf(name, sizeof(name), "%s/%s/%" PRId64, bench->name, bench->variants[v].name, bench->params[p]);
+      nu_bench_group.runs[v].selected = nu_bench_matches(name);
+      any = any || nu_bench_group.runs[v].selected;
+    }
+    if (!any) {
+      continue;
+    }
+    nu_bench_group.runs[base].selected = true;
+    nu_bench_state.current_param       = bench->params[p];
+
+    double hot[NU_BENCH_MAX_VARIANTS] = {0}, cold[NU_BENCH_MAX_VARIANTS] = {0};
+    if (nu_bench_state.cache != NU_BENCH_CACHE_COLD) {
+      reported += nu_bench_measure_group(idx, hot);
+    }
+    if (nu_bench_state.cache != NU_BENCH_CACHE_HOT) {
+      nu_bench_state.cold = true;
+      reported += nu_bench_measure_group(idx, cold);
+      nu_bench_state.cold = false;
+    }
+
+    for (int32_t v = 0; v < bench->variant_count; v++) {
+      if (nu_bench_group.runs[v].selected) {
+        n[v][points[v]]  = (double)bench->params[p];
+        ns[v][points[v]] = nu_bench_state.cache != NU_BENCH_CACHE_COLD ? hot[v] : cold[v];
+        points[v]++;
+      }
+    }
+  }
+
+  for (int32_t v = 0; v < bench->variant_count; v++) {
+    if (points[v] < 3) {
+      continue;
+    }
+    double coef, rms;
+    nu_bench_complexity_t fit = nu_bench_fit_complexity(n[v], ns[v], points[v], &coef, &rms);
+    char coef_buf[32];
+    nu_bench_format_time(coef_buf, sizeof(coef_buf), coef, 0);
+    fprintf(nu_bench_state.log, "  %s/%s: %s, %s * %s (rms %.1f%%)\n",
+      bench->name, bench->variants[v].name, nu_bench_complexity_name(fit), coef_buf,
+      nu_bench_complexity_term(fit), rms * 100.0);
+  }
+
+  NU_FREE(nu_bench_group.samples);
+  nu_bench_group.samples = NULL;
+  return reported;
+}
+
+// Wait until the monotonic clock reaches `due`: sleep while it is far off,
+// then spin so the operation starts on time
+static inline uint64_t
+nu_bench_wait_until (uint64_t due)
+{
+  uint64_t now = nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC);
+  if (now + 200000u < due) {
+    uint64_t ns = due - now - 100000u;
+    struct timespec ts = {(time_t)(ns / 1000000000u), (long)(ns % 1000000000u)};
+    nanosleep(&ts, NULL);
+  }
+  while (now < due) {
+    now = nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC);
+  }
+  return now;
+}
+
+// Invoke one open-loop operation as a timed region (for allocation
+// tracking); returns its completion time
+static inline uint64_t
+nu_bench_open_op (nu_bench_entry_t* bench)
+{
+  nu_bench_local.live_bytes = 0;
+  nu_bench_local.in_region  = true;
+  bench->fn();
+  nu_bench_local.in_region = false;
+  nu_bench_state.current_iteration++;
+  return nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC);
+}
+
+// Closed-loop capacity: operations/s with each issued as soon as the last
+// completes, after a warmup of the same length
+static inline double
+nu_bench_open_capacity (nu_bench_entry_t* bench)
+{
+  double duration = fmin(nu_bench_state.time_budget / 4.0, 2.5e8);
+  double rate     = 0.0;
+  for (int32_t round = 0; round < 2; round++) {
+    uint64_t t0  = nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC);
+    uint64_t now = t0;
+    size_t ops   = 0;
+    while ((double)(now - t0) < duration || ops < 100) {
+      now = nu_bench_open_op(bench);
+      ops++;
+    }
+    rate = (double)ops * 1e9 / (double)(now - t0);
+  }
+  return rate;
+}
+
+// Issue operations at `rate` per second for the time budget, open loop.
+// Operation k is due at t0 + k / rate whether or not earlier ones have
+// finished: it starts when due or, if the previous one is still running,
+// as soon as that completes, which is what a scheduler feeding a queue to
+// one worker would do. Latency is measured from when it was due. Measuring
+// from its actual start would hide the queueing delay a slow operation
+// imposes on those behind it (coordinated omission).
+static inline void
+nu_bench_collect_open (
+  nu_bench_entry_t* bench,
+  double rate)
+{
+  nu_bench_state.current_iteration = 0;
+  nu_bench_state.items             = 0;
+  nu_bench_state.bytes             = 0;
+  nu_bench_local.items             = 0;
+  nu_bench_local.bytes             = 0;
+  nu_bench_state.perf_iterations   = 0;
+  nu_bench_reset_samples();
+  nu_bench_alloc_reset();
+
+  double noise_before = nu_bench_probe_noise();
+  if (nu_bench_state.profile_dir) {
+    nu_bench_profile_arm(true);
+  }
+
+  // Stop issuing after twice the budget, so a saturated point ends even
+  // though its backlog keeps growing
+  double interval = 1e9 / rate;
+  double service  = 0.0;
+  uint64_t t0     = nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC);
+  uint64_t now    = t0;
+  size_t ops      = 0;
+  for (;;) {
+    uint64_t due = t0 + (uint64_t)((double)ops * interval);
+    if ((double)(due - t0) >= nu_bench_state.time_budget
+        || (double)(now - t0) >= 2.0 * nu_bench_state.time_budget) {
+      break;
+    }
+    uint64_t start = now < due ? nu_bench_wait_until(due) : now;
+    now = nu_bench_open_op(bench);
+    nu_bench_record_sample((double)(now - due));
+    service += (double)(now - start);
+    ops++;
+  }
+
+  if (nu_bench_state.profile_dir) {
+    nu_bench_profile_arm(false);
+  }
+  nu_bench_alloc_result(nu_bench_local.allocs, nu_bench_local.alloc_bytes,
+    nu_bench_local.peak_bytes, ops);
+
+  nu_bench_state.items          = nu_bench_local.items;
+  nu_bench_state.bytes          = nu_bench_local.bytes;
+  nu_bench_state.batch          = 1;
+  nu_bench_state.open_offered   = rate;
+  nu_bench_state.open_achieved  = (double)ops * 1e9 / (double)(now - t0);
+  nu_bench_state.open_service   = ops > 0 ? service / (double)ops : 0.0;
+  nu_bench_state.open_saturated = nu_bench_state.open_achieved < 0.95 * rate;
+  nu_bench_state.noise          = fmax(noise_before, nu_bench_probe_noise());
+}
+
+// Run an open-loop benchmark over increasing offered loads, results named
+// "<name>/<load>%", stopping after the first saturated point, then print its
+// latency-vs-throughput curve
+static inline int32_t
+nu_bench_run_open (int32_t idx)
+{
+  static const double defaults[] = {0.1, 0.25, 0.5, 0.7, 0.8, 0.9, 0.95, 1.0, 1.1, 1.25};
+  nu_bench_entry_t* bench = &nu_bench_state.benches[idx];
+  const double* loads     = nu_bench_state.load_count > 0 ? nu_bench_state.loads : defaults;
+  size_t load_count       = nu_bench_state.load_count > 0
+                            ? nu_bench_state.load_count : sizeof(defaults) / sizeof(defaults[0]);
+
+  char names[16][160];
+  size_t selected = 0;
+  for (size_t l = 0; l < load_count; l++) {
+    snprintf(names[l], sizeof(names[l]), "%s/%g%%", bench->name, loads[l] * 100.0);
+    selected += nu_bench_matches(names[l]);
+  }
+  if (selected == 0) {
+    return 0;
+  }
+
+  nu_bench_state.current_bench      = idx;
+  nu_bench_state.current_param      = 0;
+  nu_bench_state.cache_region_count = 0;
+  if (bench->setup) {
+    bench->setup(0);
+  }
+  nu_bench_state.open_capacity = nu_bench_open_capacity(bench);
+
+  struct {
+    double offered, achieved, p50, p99, p999, max;
+  } curve[16];
+  int32_t reported = 0;
+  for (size_t l = 0; l < load_count; l++) {
+    if (!nu_bench_matches(names[l])) {
+      continue;
+    }
+    nu_bench_stats_t st;
+    nu_bench_collect_open(bench, loads[l] * nu_bench_state.open_capacity);
+    nu_bench_calculate_stats(&st);
+    nu_bench_report(names[l], &st);
+
+    curve[reported].offered  = nu_bench_state.open_offered;
+    curve[reported].achieved = nu_bench_state.open_achieved;
+    curve[reported].p50      = st.median;
+    curve[reported].p99      = st.p99;
+    curve[reported].p999     = st.p999;
+    curve[reported].max      = st.max;
+    reported++;
+    if (nu_bench_state.open_saturated) {
+      break;
+    }
+  }
+
+  if (bench->teardown) {
+    bench->teardown(0);
+  }
+
+  char capacity[32];
+  nu_bench_format_rate(capacity, sizeof(capacity), nu_bench_state.open_capacity, "ops");
+  fprintf(nu_bench_state.log, "  %s: closed-loop capacity %s; latency under load:\n", bench->name, capacity);
+  fprintf(nu_bench_state.log, "    %15s %15s %11s %11s %11s %11s\n",
+    "offered", "achieved", "p50", "p99", "p99.9", "max");
+  for (int32_t r = 0; r < reported; r++) {
+    char offered[32], achieved[32], p50[32], p99[32], p999[32], max[32];
+    nu_bench_format_rate(offered, sizeof(offered), curve[r].offered, "ops");
+    nu_bench_format_rate(achieved, sizeof(achieved), curve[r].achieved, "ops");
+    nu_bench_format_time(p50, sizeof(p50), curve[r].p50, 0);
+    nu_bench_format_time(p99, sizeof(p99), curve[r].p99, 0);
+    nu_bench_format_time(p999, sizeof(p999), curve[r].p999, 0);
+    nu_bench_format_time(max, sizeof(max), curve[r].max, 0);
+    fprintf(nu_bench_state.log, "    %15s %15s %11s %11s %11s %11s\n",
+      offered, achieved, p50, p99, p999, max);
+  }
+
+  nu_bench_state.open_offered = 0.0;
+  return reported;
+}
+
+// Run a single benchmark, or every point of its sweep; returns how many
+// results were reported
+static inline int32_t
+nu_bench_run_one (int32_t idx)
+{
+  nu_bench_entry_t* bench = &nu_bench_state.benches[idx];
+
+  if (bench->mt_fn) {
+    return nu_bench_run_mt(idx);
+  }
+  if (bench->group) {
+    return nu_bench_run_group(idx);
+  }
+  if (bench->open_loop) {
+    return nu_bench_run_open(idx);
+  }
+  if (!bench->param_fn) {
+    if (!nu_bench_matches(bench->name)) {
+      return 0;
+    }
+    nu_bench_state.current_param = 0;
+    nu_bench_measure(idx, bench->name);
+    return 1;
+  }
+
+  double ns[NU_BENCH_MAX_PARAMS];
+  double n[NU_BENCH_MAX_PARAMS];
+  size_t points = 0;
+
+  for (size_t p = 0; p < bench->param_count; p++) {
+    char name[160];
+    snprintf(name, sizeof(name), "%s/%" PRId64, bench->name, bench->params[p]);
+    if (!nu_bench_matches(name)) {
+      continue;
+    }
+
+    nu_bench_state.current_param = bench->params[p];
+    n[points]  = (double)bench->params[p];
+    ns[points] = nu_bench_measure(idx, name);
+    points++;
+  }
+
+  if (points >= 3) {
+    double coef, rms;
+    nu_bench_complexity_t fit = nu_bench_fit_complexity(n, ns, points, &coef, &rms);
+    char coef_buf[32];
+    nu_bench_format_time(coef_buf, sizeof(coef_buf), coef, 0);
+    fprintf(nu_bench_state.log, "  %s: %s, %s * %s (rms %.1f%%)\n",
+      bench->name, nu_bench_complexity_name(fit), coef_buf,
+      nu_bench_complexity_term(fit), rms * 100.0);
+  }
+  return (int32_t)points;
+}
+
+// Counters an isolated child passes back to the parent
+typedef struct {
+  int32_t run_count;
+  int32_t reported;
+  int32_t regressions;
+  int32_t noisy;
+} nu_bench_child_result_t;
+
+// Report output of the isolated child being run, held until it exits
+static struct {
+  char* data;
+  size_t size;
+  size_t capacity;
+} nu_bench_child;
+
+// Append to the child output buffer, growing it by doubling
+static inline void
+nu_bench_child_append (
+  const char* data,
+  size_t size)
+{
+  if (nu_bench_child.size + size > nu_bench_child.capacity) {
+    size_t capacity = nu_bench_child.capacity > 0 ? nu_bench_child.capacity : 65536;
+    while (capacity < nu_bench_child.size + size) {
+      capacity *= 2;
+    }
+    char* grown = NU_MALLOC(capacity);
+    if (!grown) {
+      fprintf(stderr, "Benchmark allocation failed\n");
+      exit(1);
+    }
+    if (nu_bench_child.data) {
+      memcpy(grown, nu_bench_child.data, nu_bench_child.size);
+      NU_FREE(nu_bench_child.data);
+    }
+    nu_bench_child.data     = grown;
+    nu_bench_child.capacity = capacity;
+  }
+  memcpy(nu_bench_child.data + nu_bench_child.size, data, size);
+  nu_bench_child.size += size;
+}
+
+// Run one benchmark in a forked child. Every child starts from the parent's
+// state before any benchmark ran, so heap layout, fragmentation and cached
+// data left by earlier benchmarks cannot affect it, and a crash or hang
+// only loses that benchmark. The child's report output comes back over one
+// pipe and its counters over another; the output is passed on only if the
+// child exits cleanly (text output is passed on regardless, to show how far
+// it got). Returns the number of results reported.
+static inline int32_t
+nu_bench_run_isolated (int32_t idx)
+{
+  const char* name = nu_bench_state.benches[idx].name;
+  int out_pipe[2], result_pipe[2];
+
+  fflush(nu_bench_state.out);
+  fflush(nu_bench_state.log);
+  if (pipe(out_pipe) != 0) {
+    fprintf(stderr, "ERROR: --isolate: pipe failed (%s)\n", strerror(errno));
+    exit(1);
+  }
+  if (pipe(result_pipe) != 0) {
+    fprintf(stderr, "ERROR: --isolate: pipe failed (%s)\n", strerror(errno));
+    exit(1);
+  }
+  pid_t pid = fork();
+  if (pid < 0) {
+    fprintf(stderr, "ERROR: --isolate: fork failed (%s)\n", strerror(errno));
+    exit(1);
+  }
+
+  if (pid == 0) {
+    close(out_pipe[0]);
+    close(result_pipe[0]);
+    FILE* out = fdopen(out_pipe[1], "w");
+    if (!out) {
+      _exit(1);
+    }
+    if (nu_bench_state.log == nu_bench_state.out) {
+      nu_bench_state.log = out;
+    }
+    nu_bench_state.out = out;
+
+    // Counters opened by the parent count the parent
+    if (nu_bench_state.perf) {
+      nu_bench_perf_close();
+      nu_bench_state.perf = nu_bench_perf_open();
+    }
+
+    nu_bench_child_result_t result;
+    result.run_count   = nu_bench_run_one(idx);
+    result.reported    = nu_bench_state.reported;
+    result.regressions = nu_bench_state.regressions;
+    result.noisy       = nu_bench_state.noisy;
+    fflush(nu_bench_state.log);
+    fflush(out);
+    ssize_t written = write(result_pipe[1], &result, sizeof(result));
+    _exit(written == (ssize_t)sizeof(result) ? 0 : 1);
+  }
+
+  close(out_pipe[1]);
+  close(result_pipe[1]);
+  nu_bench_child.size = 0;
+
+  nu_bench_child_result_t result;
+  size_t result_size = 0;
+  bool timed_out     = false;
+  uint64_t deadline  = nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC) + (uint64_t)(nu_bench_state.timeout * 1e9);
+  struct pollfd fds[2] = {{out_pipe[0], POLLIN, 0}, {result_pipe[0], POLLIN, 0}};
+  while (fds[0].fd >= 0 || fds[1].fd >= 0) {
+    int wait_ms = -1;
+    if (nu_bench_state.timeout > 0.0) {
+      uint64_t now = nu_bench_clock_ns(NU_BENCH_CLOCK_MONOTONIC);
+      if (now >= deadline) {
+        kill(pid, SIGKILL);
+        timed_out = true;
+        break;
+      }
+      wait_ms = (int)((deadline - now) / 1000000u) + 1;
+    }
+    if (poll(fds, 2, wait_ms) < 0 && errno != EINTR) {
+      break;
+    }
+
+    char buf[65536];
+    for (int32_t f = 0; f < 2; f++) {
+      if (fds[f].fd < 0 || !(fds[f].revents & (POLLIN | POLLHUP | POLLERR))) {
+        continue;
+      }
+      ssize_t n = read(fds[f].fd, buf, sizeof(buf));
+      if (n <= 0) {
+        close(fds[f].fd);
+        fds[f].fd = -1;
+      } else if (f == 0) {
+        nu_bench_child_append(buf, (size_t)n);
+      } else if (result_size + (size_t)n <= sizeof(result)) {
+        memcpy((char*)&result + result_size, buf, (size_t)n);
+        result_size += (size_t)n;
+      }
+    }
+  }
+  for (int32_t f = 0; f < 2; f++) {
+    if (fds[f].fd >= 0)close(fds[f].fd);
+  }
+
+  int status = 0;
+  waitpid(pid, &status, 0);
+  bool ok = !timed_out && WIFEXITED(status) && WEXITSTATUS(status) == 0 && result_size == sizeof(result);
+
+  if (ok || nu_bench_state.format == NU_BENCH_FORMAT_TEXT) {
+    fwrite(nu_bench_child.data ? nu_bench_child.data : "", 1, nu_bench_child.size, nu_bench_state.out);
+  }
+  if (!ok) {
+    if (timed_out) {
+      fprintf(nu_bench_state.log, "  %s: timed out after %.0fs, killed\n", name, nu_bench_state.timeout);
+    } else if (WIFSIGNALED(status)) {
+      fprintf(nu_bench_state.log, "  %s: crashed (%s)\n", name, strsignal(WTERMSIG(status)));
+    } else {
+      fprintf(nu_bench_state.log, "  %s: failed (exit status %d)\n", name, WEXITSTATUS(status));
+    }
+    nu_bench_state.failed++;
+    return 0;
+  }
+
+  nu_bench_state.reported    = result.reported;
+  nu_bench_state.regressions = result.regressions;
+  nu_bench_state.noisy       = result.noisy;
+  return result.run_count;
+}
+
+// Match "--name value" or "--name=value", advancing *i past a separate value
+static inline const char*
+nu_bench_option_value (
+  int32_t argc,
+  char** argv,
+  int32_t* i,
+  const char* name)
+{
+  size_t len = strlen(name);
+  if (strncmp(argv[*i], name, len) != 0) {
+    return NULL;
+  }
+  if (argv[*i][len] == '=') {
+    return argv[*i] + len + 1;
+  }
+  if (argv[*i][len] == '\0' && *i + 1 < argc) {
+    return argv[++(*i)];
+  }
+  return NULL;
+}
+
+static inline void
+nu_bench_usage (const char* prog)
+{
+  printf("Usage: %s [options]\n", prog);
+  printf("Options:\n");
+  printf("  -v, --verbose          Show detailed statistics\n");
+  printf("  -n <samples>           Fixed number of samples (default: adaptive)\n");
+  printf("  -w <warmups>           Number of warmup samples (default: 5)\n");
+  printf("  -f <filter>            Run only benchmarks containing this string\n");
+  printf("  --clock <clock>        Time source: wall, cpu or tsc (default: wall)\n");
+  printf("  --time <s>             Time budget per benchmark (default: 1)\n");
+  printf("  --sample-time <ms>     Minimum timed duration of one sample (default: 1)\n");
+  printf("  --rel-error <pct>      Stop once the mean is this precise (default: 1)\n");
+  printf("  --min-samples <n>      Samples taken before stopping early (default: 10)\n");
+  printf("  --format <fmt>         Results as text, json or csv (default: text)\n");
+  printf("  --output <file>        Write results to file (default: stdout)\n");
+  printf("  --baseline <file>      Compare against a previous json or csv run\n");
+  printf("  --alpha <p>            Significance level for --baseline (default: 0.01)\n");
+  printf("  --threshold <pct>      Smallest change reported by --baseline (default: 5)\n");
+  printf("  --perf                 Count cycles, instructions and misses (Linux)\n");
+  printf("  --profile <dir>        Sample timed regions, write <dir>/<name>.folded\n");
+  printf("  --allocs               Count allocations in timed regions (default: off; needs allocator hooks)\n");
+  printf("  --cache <mode>         Start each invocation hot, cold or both (default: hot)\n");
+  printf("  --tlb-flush            With --cache, also evict TLB entries\n");
+  printf("  --roofline             Measure cache/DRAM latency and bandwidth, rate results against them\n");
+  printf("  --isolate              Run each benchmark in its own forked process\n");
+  printf("  --timeout <s>          With --isolate, kill a benchmark after s seconds (default: 300, 0 = never)\n");
+  printf("  --repetitions <n>      Run every benchmark n times (default: 1)\n");
+  printf("  --cpu <n>              Pin the benchmark to CPU n\n");
+  printf("  --mlock                Lock memory to avoid page faults while timing\n");
+  printf("  --threads <n,n,...>    Thread counts for NU_BENCH_MT (default: 1,2,4..CPUs)\n");
+  printf("  --load <pct,pct,...>   Offered loads for NU_BENCH_OPEN_LOOP, %% of capacity\n");
+  printf("                         (default: 10,25,50,70,80,90,95,100,110,125)\n");
+  printf("  -h, --help             Show this help\n");
+}
+
+// Parse command line args; returns -1 to continue, otherwise an exit code
+static inline int
+nu_bench_parse_args (
+  int32_t argc,
+  char** argv)
+{
+  const char* value;
+  for (int32_t i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-v") == 0 || strcmp(argv[i], "--verbose") == 0) {
+      nu_bench_state.verbose = true;
+    } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      nu_bench_state.total_iterations = (size_t)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+      nu_bench_state.warmup_runs = (size_t)atoi(argv[++i]);
+    } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+      nu_bench_state.filter = argv[++i];
+    } else if ((value = nu_bench_option_value(argc, argv, &i, "--time"))) {
+      nu_bench_state.time_budget = atof(value) * 1e9;
+    } else if ((value = nu_bench_option_value(argc, argv, &i, "--sample-time"))) {
+      nu_bench_state.sample_time = atof(value) * 1e6;
+    } else if ((value = nu_bench_option_value(argc, argv, &i, "--rel-error"))) {
+      nu_bench_state.rel_error = atof(value) / 100.0;
+    } else if ((value = nu_bench_option_value(argc, argv, &i, "--min-samples"))) {
+      nu_bench_state.min_samples = (size_t)atoi(value);
+    } else if ((value = nu_bench_option_value(argc, argv, &i, "--clock"))) {
+      if (strcmp(value, "wall") == 0) {
+        nu_bench_state.clock = NU_BENCH_CLOCK_WALL;
+      } else if (strcmp(value, "cpu") == 0) {
+        nu_bench_state.clock = NU_BENCH_CLOCK_CPU;
+      } else if (strcmp(value, "tsc") == 0) {
+        nu_bench_state.clock = NU_BENCH_CLOCK_TSC;
+      } else {
+        fprintf(stderr, "ERROR: Unknown clock '%s' (expected wall, cpu or tsc)\n", value);
+        return 1;
+      }
+    } else if ((value = nu_bench_option_value(argc, argv, &i, "--format"))) {
+      if (strcmp(value, "text") == 0) {
+        nu_bench_state.format = NU_BENCH_FORMAT_TEXT;
+      } else if (strcmp(value, "json") == 0) {
+        nu_bench_state.format = NU_BENCH_FORMAT_JSON;
+      } else if (strcmp(value, "csv") == 0) {
+        nu_bench_state.format = NU_BENCH_FORMAT_CSV;
+      } else {
+        fprintf(stderr, "ERROR: Unknown format '%s' (expected text, json or csv)\n", value);
+        return 1;
+      }
+    } else if ((value = nu_bench_option_value(argc, argv, &i, "--output"))) {
+      nu_bench_state.out = fopen(value, "w");
+      if (!nu_bench_state.out) {
+        fprintf(stderr, "ERROR: Cannot open output '%s'\n", value);
+        return 1;
+      }
+    } else if ((value = nu_bench_option_value(argc, argv, &i, "--baseline"))) {
+      if (!nu_bench_load_baseline(value)) {
+        return 1;
+      }
+    } else if ((value = nu_bench_option_value(argc, argv, &i, "--alpha"))) {
+      nu_bench_state.alpha = atof(value);
+    } else if ((value = nu_bench_option_value(argc, argv, &i, "--threshold"))) {
+      nu_bench_state.threshold = atof(value) / 100.0;
+    } else if ((value = nu_bench_option_value(argc, argv, &i, "--threads"))) {
+      nu_bench_state.thread_runs = 0;
+      for (char* end; *value && nu_bench_state.thread_runs < 32; value = end + (*end == ',')) {
+        long threads = strtol(value, &end, 10);
+        if (end == value || threads < 1 || threads > NU_BENCH_MAX_THREADS) {
+          fprintf(stderr, "ERROR: Bad thread count in --threads (1-%d)\n", NU_BENCH_MAX_THREADS);
+          return 1;
+        }
+        nu_bench_state.threads[nu_bench_state.thread_runs++] = (int32_t)threads;
+      }
+    } else if ((value = nu_bench_option_value(argc, argv, &i, "--load"))) {
+      nu_bench_state.load_count = 0;
+      for (char* end; *value && nu_bench_state.load_count < 16; value = end + (*end == ',')) {
+        double load = strtod(value, &end);
+        if (end == value || load <= 0.0) {
+          fprintf(stderr, "ERROR: Bad load in --load (percent of capacity, > 0)\n");
+          return 1;
+        }
+        nu_bench_state.loads[nu_bench_state.load_count++] = load / 100.0;
+      }
+    } else if ((value = nu_bench_option_value(argc, argv, &i, "--cache"))) {
+      if (strcmp(value, "hot") == 0) {
+        nu_bench_state.cache = NU_BENCH_CACHE_HOT;
+      } else if (strcmp(value, "cold") == 0) {
+        nu_bench_state.cache = NU_BENCH_CACHE_COLD;
+      } else if (strcmp(value, "both") == 0) {
+        nu_bench_state.cache = NU_BENCH_CACHE_BOTH;
+      } else {
+        fprintf(stderr, "ERROR: Unknown cache mode '%s' (expected hot, cold or both)\n", value);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--tlb-flush") == 0) {
+      nu_bench_state.tlb_flush = true;
+    } else if (strcmp(argv[i], "--roofline") == 0) {
+      nu_bench_state.roofline = true;
+    } else if (strcmp(argv[i], "--isolate") == 0) {
+      nu_bench_state.isolate = true;
+    } else if ((value = nu_bench_option_value(argc, argv, &i, "--timeout"))) {
+      nu_bench_state.timeout = atof(value);
+    } else if ((value = nu_bench_option_value(argc, argv, &i, "--repetitions"))) {
+      nu_bench_state.repetitions = atoi(value) > 0 ? atoi(value) : 1;
+    } else if ((value = nu_bench_option_value(argc, argv, &i, "--cpu"))) {
+      nu_bench_state.cpu = atoi(value);
+    } else if (strcmp(argv[i], "--mlock") == 0) {
+      nu_bench_state.mlock = true;
+    } else if (strcmp(argv[i], "--perf") == 0) {
+      nu_bench_state.perf = true;
+    } else if ((value = nu_bench_option_value(argc, argv, &i, "--profile"))) {
+      nu_bench_state.profile_dir = value;
+    } else if (strcmp(argv[i], "--allocs") == 0) {
+      nu_bench_state.allocs = true;
+    } else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+      nu_bench_usage(argv[0]);
+      return 0;
+    } else {
+      fprintf(stderr, "ERROR: Unknown option '%s' (see --help)\n", argv[i]);
+      return 1;
+    }
+  }
+  return -1;
+}
+
+// Run all benchmarks
+static inline int
+nu_bench_run_all (
+  int32_t argc,
+  char** argv)
+{
+  int exit_code = nu_bench_parse_args(argc, argv);
+  if (exit_code >= 0) {
+    nu_bench_free_baseline();
+    return exit_code;
+  }
+
+  // Keep machine-readable output clean of progress text
+  if (!nu_bench_state.out) {
+    nu_bench_state.out = stdout;
+  }
+  if (nu_bench_state.format == NU_BENCH_FORMAT_TEXT) {
+    nu_bench_state.log = nu_bench_state.out;
+  } else {
+    nu_bench_state.log = nu_bench_state.out == stdout ? stderr : stdout;
+  }
+  FILE* log = nu_bench_state.log;
+
+  nu_bench_setup_env();
+  nu_bench_init_clock();
+  if (nu_bench_state.cache != NU_BENCH_CACHE_HOT) {
+    nu_bench_evict_init();
+  }
+  if (nu_bench_state.roofline) {
+    nu_bench_roofline_init();
+  }
+  if (nu_bench_state.perf) {
+    nu_bench_state.perf = nu_bench_perf_open();
+  }
+  if (nu_bench_state.profile_dir && !nu_bench_profile_init()) {
+    nu_bench_state.profile_dir = NULL;
+  }
+  // Picoseconds from 1 ps to one hour, 3 significant digits
+  if (!nu_histogram_init(&nu_bench_state.histogram, 1, 3600LL * 1000000000000LL, 3)) {
+    fprintf(stderr, "Benchmark allocation failed\n");
+    exit(1);
+  }
+
+  fprintf(log, "Running benchmarks");
+  if (nu_bench_state.verbose) {
+    if (nu_bench_state.total_iterations > 0) {
+      fprintf(log, " (%zu samples, %zu warmups)",
+        nu_bench_state.total_iterations,
+        nu_bench_state.warmup_runs);
+    } else {
+      fprintf(log, " (%.2fs budget, %.1f%% target error, %zu warmups)",
+        nu_bench_state.time_budget / 1e9,
+        nu_bench_state.rel_error * 100.0,
+        nu_bench_state.warmup_runs);
+    }
+  }
+  fprintf(log, "...\n");
+  if (nu_bench_state.verbose) {
+    fprintf(log, "  Clock: %s, timer overhead %.1f ns (subtracted)\n",
+      nu_bench_clock_name(nu_bench_state.clock),
+      nu_bench_state.timer_overhead);
+    if (nu_bench_state.cpu >= 0) {
+      fprintf(log, "  Pinned to CPU %d\n", nu_bench_state.cpu);
+    }
+    if (nu_bench_state.cache != NU_BENCH_CACHE_HOT) {
+      fprintf(log, "  Cold runs: clflush registered regions, else stream %zu MiB%s\n",
+        nu_bench_state.evict_size >> 20, nu_bench_state.tlb_flush ? ", TLB flush" : "");
+    }
+  }
+  for (int32_t i = 0; i < nu_bench_state.warning_count; i++) {
+    fprintf(log, "  Warning: %s\n", nu_bench_state.warnings[i]);
+  }
+  if (nu_bench_state.level_count > 0) {
+    fprintf(log, "  Roofline (one core):    size   latency         read        write         copy\n");
+    for (int32_t l = 0; l < nu_bench_state.level_count; l++) {
+      const nu_bench_roofline_t* level = &nu_bench_state.levels[l];
+      char size[32], read[32], write[32], copy[32];
+      if (level->size > 0) {
+        nu_bench_format_bytes(size, sizeof(size), (double)level->size);
+      } else {
+        snprintf(size, sizeof(size), "-");
+      }
+      nu_bench_format_rate(read, sizeof(read), level->read_bw, "B");
+      nu_bench_format_rate(write, sizeof(write), level->write_bw, "B");
+      nu_bench_format_rate(copy, sizeof(copy), level->copy_bw, "B");
+      fprintf(log, "    %-6s %19s %7.1f ns %12s %12s %12s\n",
+        level->name, size, level->latency_ns, read, write, copy);
+    }
+  }
+
+  nu_bench_report_begin();
+
+  // Repetitions run the whole suite again, so drift affects every
+  // benchmark alike rather than the repetitions of one
+  int32_t run_count = 0;
+  for (int32_t r = 0; r < nu_bench_state.repetitions; r++) {
+    nu_bench_state.repetition = r;
+    if (nu_bench_state.repetitions > 1) {
+      fprintf(log, "Repetition %d of %d\n", r + 1, nu_bench_state.repetitions);
+    }
+    for (int32_t i = 0; i < nu_bench_state.count; i++) {
+      run_count += nu_bench_state.isolate ? nu_bench_run_isolated(i) : nu_bench_run_one(i);
+    }
+  }
+  NU_FREE(nu_bench_child.data);
+  nu_bench_child.data     = NULL;
+  nu_bench_child.capacity = 0;
+
+  nu_bench_report_end();
+
+  if (run_count == 0 && nu_bench_state.failed == 0) {
+    fprintf(log, "  No benchmarks matched filter.\n");
+  }
+
+  if (nu_bench_state.perf) {
+    nu_bench_perf_close();
+  }
+
+  NU_FREE(nu_bench_state.evict);
+  nu_bench_state.evict = NULL;
+
+  nu_histogram_free(&nu_bench_state.histogram);
+  nu_bench_profile_free();
+
+  exit_code = 0;
+  if (nu_bench_state.baseline_count > 0) {
+    fprintf(log, "\n%d significant regression%s against baseline.\n",
+      nu_bench_state.regressions, nu_bench_state.regressions == 1 ? "" : "s");
+    exit_code = nu_bench_state.regressions > 0 ? 1 : 0;
+    nu_bench_free_baseline();
+  }
+
+  if (nu_bench_state.failed > 0) {
+    fprintf(log, "\n%d benchmark%s crashed or timed out in isolation.\n",
+      nu_bench_state.failed, nu_bench_state.failed == 1 ? "" : "s");
+    exit_code = 1;
+  }
+
+  if (nu_bench_state.noisy > 0) {
+    fprintf(log, "\n%d noisy result%s: the spin probe drifted more than %.0f%% while measuring.\n",
+      nu_bench_state.noisy, nu_bench_state.noisy == 1 ? "" : "s",
+      nu_bench_state.noise_threshold * 100.0);
+  }
+
+  fprintf(log, "\nBenchmarks completed.\n");
+
+  if (nu_bench_state.out != stdout) {
+    fclose(nu_bench_state.out);
+  }
+  return exit_code;
 }
 
 // Main macro
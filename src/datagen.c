@@ -0,0 +1,450 @@
+#include "datagen.h"
+#include "sort.h"
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+extern void* NU_MALLOC(size_t size);
+extern void NU_FREE(void* ptr);
+
+static const char* const dist_names[NU_DATAGEN_DIST_COUNT] = {
+  "random", "sorted", "reversed", "zipf", "organ_pipe",
+  "sorted_swaps", "runs", "equal_outliers", "antiqsort",
+};
+
+static const char* const type_names[NU_DATAGEN_TYPE_COUNT] = {
+  "int32", "int64", "double", "string16", "record64", "record256",
+};
+
+// splitmix64: fixed so a seed gives the same input everywhere
+static uint64_t
+next_random (uint64_t* seed)
+{
+  uint64_t z = (*seed += 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+// Uniform in [0, bound); the modulo bias is negligible for input generation
+static size_t
+random_below (uint64_t* seed, size_t bound)
+{
+  return bound > 0 ? (size_t)(next_random(seed) % bound) : 0;
+}
+
+// Uniform in [0, 1)
+static double
+random_unit (uint64_t* seed)
+{
+  return (double)(next_random(seed) >> 11) * 0x1.0p-53;
+}
+
+static size_t
+isqrt (size_t n)
+{
+  size_t r = (size_t)sqrt((double)n);
+  while (r * r > n) r--;
+  while ((r + 1) * (r + 1) <= n) r++;
+  return r;
+}
+
+void
+nu_datagen_random (int64_t* keys, size_t n, uint64_t* seed)
+{
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = (int64_t)random_below(seed, n);
+  }
+}
+
+void
+nu_datagen_sorted (int64_t* keys, size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = (int64_t)i;
+  }
+}
+
+void
+nu_datagen_reversed (int64_t* keys, size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = (int64_t)(n - 1 - i);
+  }
+}
+
+// Zipf sampling by rejection-inversion (Hormann and Derflinger, 1996):
+// O(1) per key and no table, so n can be large. h is the unnormalized
+// density x^-s and h_integral an antiderivative of it.
+static double
+zipf_helper1 (double x)
+{
+  return fabs(x) > 1e-8 ? log1p(x) / x : 1.0 - x * (0.5 - x * (1.0 / 3.0 - 0.25 * x));
+}
+
+static double
+zipf_helper2 (double x)
+{
+  return fabs(x) > 1e-8 ? expm1(x) / x : 1.0 + x * 0.5 * (1.0 + x / 3.0 * (1.0 + 0.25 * x));
+}
+
+static double
+zipf_h (double x, double s)
+{
+  return exp(-s * log(x));
+}
+
+static double
+zipf_h_integral (double x, double s)
+{
+  double log_x = log(x);
+  return zipf_helper2((1.0 - s) * log_x) * log_x;
+}
+
+static double
+zipf_h_integral_inverse (double x, double s)
+{
+  double t = x * (1.0 - s);
+  if (t < -1.0)t = -1.0;
+  return exp(zipf_helper1(t) * x);
+}
+
+void
+nu_datagen_zipf (int64_t* keys, size_t n, double exponent, uint64_t* seed)
+{
+  double s       = exponent > 0.0 ? exponent : 1.0;
+  double count   = (double)n;
+  double h_x1    = zipf_h_integral(1.5, s) - 1.0;
+  double h_n     = zipf_h_integral(count + 0.5, s);
+  double squeeze = 2.0 - zipf_h_integral_inverse(zipf_h_integral(2.5, s) - zipf_h(2.0, s), s);
+
+  for (size_t i = 0; i < n; i++) {
+    for (;;) {
+      double u = h_n + random_unit(seed) * (h_x1 - h_n);
+      double x = zipf_h_integral_inverse(u, s);
+      double k = floor(x + 0.5);
+      if (k < 1.0)k = 1.0;
+      if (k > count)k = count;
+      if (k - x <= squeeze || u >= zipf_h_integral(k + 0.5, s) - zipf_h(k, s)) {
+        keys[i] = (int64_t)k - 1;
+        break;
+      }
+    }
+  }
+}
+
+void
+nu_datagen_organ_pipe (int64_t* keys, size_t n)
+{
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = (int64_t)(i <= n / 2 ? i : n - i);
+  }
+}
+
+void
+nu_datagen_sorted_swaps (int64_t* keys, size_t n, size_t swaps, uint64_t* seed)
+{
+  nu_datagen_sorted(keys, n);
+  for (size_t s = 0; s < swaps && n > 1; s++) {
+    size_t a     = random_below(seed, n);
+    size_t b     = random_below(seed, n);
+    int64_t temp = keys[a];
+    keys[a] = keys[b];
+    keys[b] = temp;
+  }
+}
+
+void
+nu_datagen_runs (int64_t* keys, size_t n, size_t mean_run, uint64_t* seed)
+{
+  size_t max_run = mean_run > 0 ? 2 * mean_run : 2;
+  for (size_t i = 0; i < n;) {
+    size_t len = 1 + random_below(seed, max_run);
+    if (len > n - i)len = n - i;
+
+    // A random walk upwards from a random start, staying below n
+    size_t value = random_below(seed, n);
+    size_t step  = (n - value) / len + 1;
+    for (size_t j = 0; j < len; j++, i++) {
+      keys[i] = (int64_t)value;
+      value  += random_below(seed, step);
+      if (value >= n)value = n - 1;
+    }
+  }
+}
+
+void
+nu_datagen_equal_outliers (int64_t* keys, size_t n, size_t outliers, uint64_t* seed)
+{
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = (int64_t)(n / 2);
+  }
+  for (size_t i = 0; i < outliers && n > 0; i++) {
+    keys[random_below(seed, n)] = (int64_t)random_below(seed, n);
+  }
+}
+
+// State of the adversary's comparator, which the sort calls without context
+static struct {
+  int64_t* value;            // Decided key per element, or gas
+  int64_t gas;               // Undecided; compares above every decided key
+  int64_t solid;             // Next key to decide
+  uint32_t candidate;        // Most recent undecided element compared
+} antiqsort;
+
+static int
+antiqsort_compare (const void* a, const void* b)
+{
+  uint32_t x, y;
+  memcpy(&x, a, sizeof(x));
+  memcpy(&y, b, sizeof(y));
+
+  int64_t* value = antiqsort.value;
+  if (value[x] == antiqsort.gas && value[y] == antiqsort.gas) {
+    // Both undecided: freeze the one likely to be the pivot, low
+    if (x == antiqsort.candidate) {
+      value[x] = antiqsort.solid++;
+    } else {
+      value[y] = antiqsort.solid++;
+    }
+  }
+  if (value[x] == antiqsort.gas) {
+    antiqsort.candidate = x;
+  } else if (value[y] == antiqsort.gas) {
+    antiqsort.candidate = y;
+  }
+  return (value[x] > value[y]) - (value[x] < value[y]);
+}
+
+bool
+nu_datagen_antiqsort (int64_t* keys, size_t n, size_t size, nu_datagen_sort_fn sort)
+{
+  if ((!keys && n > 0) || size < sizeof(uint32_t) || !sort || n > UINT32_MAX) {
+    return false;
+  }
+  if (n == 0) {
+    return true;
+  }
+
+  unsigned char* elements = NU_MALLOC(n * size);
+  if (!elements) {
+    return false;
+  }
+  memset(elements, 0, n * size);
+  for (size_t i = 0; i < n; i++) {
+    uint32_t index = (uint32_t)i;
+    memcpy(elements + i * size, &index, sizeof(index));
+    keys[i] = (int64_t)n - 1;
+  }
+
+  antiqsort.value     = keys;
+  antiqsort.gas       = (int64_t)n - 1;
+  antiqsort.solid     = 0;
+  antiqsort.candidate = 0;
+  sort(elements, n, size, antiqsort_compare);
+  antiqsort.value = NULL;
+
+  NU_FREE(elements);
+  return true;
+}
+
+bool
+nu_datagen_keys (int64_t* keys, size_t n, nu_datagen_dist_t dist, size_t size, uint64_t seed)
+{
+  if (!keys && n > 0) {
+    return false;
+  }
+
+  switch (dist) {
+  case NU_DATAGEN_RANDOM:
+    nu_datagen_random(keys, n, &seed);
+    return true;
+  case NU_DATAGEN_SORTED:
+    nu_datagen_sorted(keys, n);
+    return true;
+  case NU_DATAGEN_REVERSED:
+    nu_datagen_reversed(keys, n);
+    return true;
+  case NU_DATAGEN_ZIPF:
+    nu_datagen_zipf(keys, n, 1.0, &seed);
+    return true;
+  case NU_DATAGEN_ORGAN_PIPE:
+    nu_datagen_organ_pipe(keys, n);
+    return true;
+  case NU_DATAGEN_SORTED_SWAPS:
+    nu_datagen_sorted_swaps(keys, n, isqrt(n), &seed);
+    return true;
+  case NU_DATAGEN_RUNS:
+    nu_datagen_runs(keys, n, isqrt(n), &seed);
+    return true;
+  case NU_DATAGEN_EQUAL_OUTLIERS:
+    nu_datagen_equal_outliers(keys, n, n / 100 + 1, &seed);
+    return true;
+  case NU_DATAGEN_ANTIQSORT:
+    return nu_datagen_antiqsort(keys, n, size, nu_sort);
+  case NU_DATAGEN_DIST_COUNT:
+    break;
+  }
+  return false;
+}
+
+void
+nu_datagen_fill (void* out, const int64_t* keys, size_t n, nu_datagen_type_t type)
+{
+  // Centered on zero so signed types see negative values too
+  int64_t center = (int64_t)(n / 2);
+
+  for (size_t i = 0; i < n; i++) {
+    int64_t key = keys[i];
+    switch (type) {
+    case NU_DATAGEN_INT32:
+      ((int32_t*)out)[i] = (int32_t)(key - center);
+      break;
+    case NU_DATAGEN_INT64:
+      ((int64_t*)out)[i] = (key - center) * 4096;
+      break;
+    case NU_DATAGEN_DOUBLE:
+      ((double*)out)[i] = (double)(key - center) / 4.0;
+      break;
+    case NU_DATAGEN_STRING16:
+      snprintf((char*)out + i * 16, 16, "%015" PRId64, key);
+      break;
+    case NU_DATAGEN_RECORD64: {
+      nu_datagen_record64_t* record = (nu_datagen_record64_t*)out + i;
+      record->key = (uint64_t)key;
+      for (size_t p = 0; p < 7; p++) {
+        record->payload[p] = (uint64_t)i + p;
+      }
+      break;
+    }
+    case NU_DATAGEN_RECORD256: {
+      nu_datagen_record256_t* record = (nu_datagen_record256_t*)out + i;
+      record->key = (uint64_t)key;
+      for (size_t p = 0; p < 31; p++) {
+        record->payload[p] = (uint64_t)i + p;
+      }
+      break;
+    }
+    case NU_DATAGEN_TYPE_COUNT:
+      return;
+    }
+  }
+}
+
+bool
+nu_datagen_generate (void* out, size_t n, nu_datagen_dist_t dist, nu_datagen_type_t type, uint64_t seed)
+{
+  size_t size = nu_datagen_type_size(type);
+  if ((!out && n > 0) || size == 0) {
+    return false;
+  }
+  if (n == 0) {
+    return true;
+  }
+
+  int64_t* keys = NU_MALLOC(n * sizeof(int64_t));
+  if (!keys) {
+    return false;
+  }
+  bool ok = nu_datagen_keys(keys, n, dist, size, seed);
+  if (ok) {
+    nu_datagen_fill(out, keys, n, type);
+  }
+  NU_FREE(keys);
+  return ok;
+}
+
+size_t
+nu_datagen_type_size (nu_datagen_type_t type)
+{
+  switch (type) {
+  case NU_DATAGEN_INT32:
+    return sizeof(int32_t);
+  case NU_DATAGEN_INT64:
+    return sizeof(int64_t);
+  case NU_DATAGEN_DOUBLE:
+    return sizeof(double);
+  case NU_DATAGEN_STRING16:
+    return 16;
+  case NU_DATAGEN_RECORD64:
+    return sizeof(nu_datagen_record64_t);
+  case NU_DATAGEN_RECORD256:
+    return sizeof(nu_datagen_record256_t);
+  case NU_DATAGEN_TYPE_COUNT:
+    break;
+  }
+  return 0;
+}
+
+static int
+compare_int32 (const void* a, const void* b)
+{
+  int32_t x = *(const int32_t*)a;
+  int32_t y = *(const int32_t*)b;
+  return (x > y) - (x < y);
+}
+
+static int
+compare_int64 (const void* a, const void* b)
+{
+  int64_t x = *(const int64_t*)a;
+  int64_t y = *(const int64_t*)b;
+  return (x > y) - (x < y);
+}
+
+static int
+compare_double (const void* a, const void* b)
+{
+  double x = *(const double*)a;
+  double y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+static int
+compare_string16 (const void* a, const void* b)
+{
+  return strncmp(a, b, 16);
+}
+
+// Both record types start with the key
+static int
+compare_record (const void* a, const void* b)
+{
+  uint64_t x = *(const uint64_t*)a;
+  uint64_t y = *(const uint64_t*)b;
+  return (x > y) - (x < y);
+}
+
+nu_datagen_compare_fn
+nu_datagen_comparator (nu_datagen_type_t type)
+{
+  switch (type) {
+  case NU_DATAGEN_INT32:
+    return compare_int32;
+  case NU_DATAGEN_INT64:
+    return compare_int64;
+  case NU_DATAGEN_DOUBLE:
+    return compare_double;
+  case NU_DATAGEN_STRING16:
+    return compare_string16;
+  case NU_DATAGEN_RECORD64:
+  case NU_DATAGEN_RECORD256:
+    return compare_record;
+  case NU_DATAGEN_TYPE_COUNT:
+    break;
+  }
+  return NULL;
+}
+
+const char*
+nu_datagen_dist_name (nu_datagen_dist_t dist)
+{
+  return (unsigned)dist < NU_DATAGEN_DIST_COUNT ? dist_names[dist] : "unknown";
+}
+
+const char*
+nu_datagen_type_name (nu_datagen_type_t type)
+{
+  return (unsigned)type < NU_DATAGEN_TYPE_COUNT ? type_names[type] : "unknown";
+}
@@ -0,0 +1,219 @@
+#ifndef NU_DATAGEN_H
+#define NU_DATAGEN_H
+
+/**
+ * @file datagen.h
+ * @brief Reproducible input distributions for benchmarks and tests
+ *
+ * Inputs are generated in two steps. A distribution produces n integer keys
+ * in [0, n) (nu_datagen_keys() or one of the individual generators), and
+ * nu_datagen_fill() turns the keys into elements of one of several types,
+ * from 4-byte integers to 256-byte records. The conversion preserves the
+ * order of the keys, so a comparison sort performs the same comparisons on
+ * every element type and results across types are directly comparable.
+ *
+ * All randomness comes from a caller-supplied seed and a fixed generator,
+ * so a seed produces the same input on every platform and run.
+ *
+ * Besides the usual random, sorted and reversed inputs, the distributions
+ * model messier production data: skewed (Zipf) keys, organ pipes, nearly
+ * sorted arrays, concatenated sorted runs, all-equal data with a few
+ * outliers, and McIlroy's "antiqsort" adversary, which adapts to a sort's
+ * comparisons to drive quicksort towards quadratic time.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* For internal library builds, NU_MALLOC/NU_FREE are defined by compiler */
+#ifdef NU_MALLOC
+extern void* NU_MALLOC(size_t size);
+extern void NU_FREE(void* ptr);
+
+#endif
+
+/* Key distributions */
+typedef enum {
+  NU_DATAGEN_RANDOM,          // Uniform over [0, n)
+  NU_DATAGEN_SORTED,          // 0, 1, ..., n-1
+  NU_DATAGEN_REVERSED,        // n-1, ..., 1, 0
+  NU_DATAGEN_ZIPF,            // Zipf with exponent 1: a few keys dominate
+  NU_DATAGEN_ORGAN_PIPE,      // 0, 1, ..., n/2, ..., 1, 0
+  NU_DATAGEN_SORTED_SWAPS,    // Sorted, then sqrt(n) random pairs swapped
+  NU_DATAGEN_RUNS,            // Ascending runs of random length, mean sqrt(n)
+  NU_DATAGEN_EQUAL_OUTLIERS,  // One key everywhere except n/100 + 1 outliers
+  NU_DATAGEN_ANTIQSORT,       // McIlroy's adversary, built against nu_sort
+  NU_DATAGEN_DIST_COUNT,
+} nu_datagen_dist_t;
+
+/* Element types */
+typedef enum {
+  NU_DATAGEN_INT32,           // int32_t, 4 bytes
+  NU_DATAGEN_INT64,           // int64_t, 8 bytes
+  NU_DATAGEN_DOUBLE,          // double, 8 bytes
+  NU_DATAGEN_STRING16,        // char[16], zero-padded decimal, strcmp order
+  NU_DATAGEN_RECORD64,        // nu_datagen_record64_t, 64 bytes
+  NU_DATAGEN_RECORD256,       // nu_datagen_record256_t, 256 bytes
+  NU_DATAGEN_TYPE_COUNT,
+} nu_datagen_type_t;
+
+/* Records are ordered by key; payload[0] holds the element's original
+ * index, so stability can be checked */
+typedef struct {
+  uint64_t key;
+  uint64_t payload[7];
+} nu_datagen_record64_t;
+
+typedef struct {
+  uint64_t key;
+  uint64_t payload[31];
+} nu_datagen_record256_t;
+
+typedef int (* nu_datagen_compare_fn)(const void* a, const void* b);
+
+typedef void (* nu_datagen_sort_fn)(void* base, size_t nmemb, size_t size, nu_datagen_compare_fn compar);
+
+/**
+ * @brief Uniformly random keys in [0, n)
+ * @param keys Output, n keys
+ * @param n Number of keys
+ * @param seed Generator state, advanced
+ */
+void nu_datagen_random(int64_t* keys, size_t n, uint64_t* seed);
+
+/**
+ * @brief Ascending keys 0 to n-1
+ * @param keys Output, n keys
+ * @param n Number of keys
+ */
+void nu_datagen_sorted(int64_t* keys, size_t n);
+
+/**
+ * @brief Descending keys n-1 to 0
+ * @param keys Output, n keys
+ * @param n Number of keys
+ */
+void nu_datagen_reversed(int64_t* keys, size_t n);
+
+/**
+ * @brief Zipf-distributed keys: key k-1 occurs with probability proportional
+ *        to 1 / k^exponent
+ * @param keys Output, n keys in [0, n)
+ * @param n Number of keys
+ * @param exponent Skew, > 0 (1 is the classic Zipf law)
+ * @param seed Generator state, advanced
+ */
+void nu_datagen_zipf(int64_t* keys, size_t n, double exponent, uint64_t* seed);
+
+/**
+ * @brief Keys rising to n/2 and falling back: 0, 1, ..., n/2, ..., 1, 0
+ * @param keys Output, n keys
+ * @param n Number of keys
+ */
+void nu_datagen_organ_pipe(int64_t* keys, size_t n);
+
+/**
+ * @brief Ascending keys with random pairs of positions swapped
+ * @param keys Output, n keys
+ * @param n Number of keys
+ * @param swaps Number of swaps
+ * @param seed Generator state, advanced
+ */
+void nu_datagen_sorted_swaps(int64_t* keys, size_t n, size_t swaps, uint64_t* seed);
+
+/**
+ * @brief Concatenated non-decreasing runs of random length
+ * @param keys Output, n keys in [0, n)
+ * @param n Number of keys
+ * @param mean_run Mean run length (lengths are uniform in [1, 2 * mean_run])
+ * @param seed Generator state, advanced
+ */
+void nu_datagen_runs(int64_t* keys, size_t n, size_t mean_run, uint64_t* seed);
+
+/**
+ * @brief One key (n/2) everywhere except at random outlier positions
+ * @param keys Output, n keys in [0, n)
+ * @param n Number of keys
+ * @param outliers Number of positions given a random key
+ * @param seed Generator state, advanced
+ */
+void nu_datagen_equal_outliers(int64_t* keys, size_t n, size_t outliers, uint64_t* seed);
+
+/**
+ * @brief McIlroy's antiqsort adversary against a sort function
+ *
+ * Sorts n elements of size bytes with sort, using a comparator that decides
+ * the key of each element only when forced to, always in the way that makes
+ * the sort's pivot a bad one. The decided keys are returned: sorting them
+ * again with the same (deterministic) sort and element size repeats the
+ * same comparisons. Not thread-safe.
+ *
+ * @param keys Output, n keys in [0, n)
+ * @param n Number of keys (at most UINT32_MAX)
+ * @param size Element size the adversary sorts, >= 4
+ * @param sort Sort to defeat, with the signature of qsort()
+ * @return true on success, false on invalid arguments or allocation failure
+ */
+bool nu_datagen_antiqsort(int64_t* keys, size_t n, size_t size, nu_datagen_sort_fn sort);
+
+/**
+ * @brief Generate keys from a distribution with its default parameters
+ * @param keys Output, n keys in [0, n)
+ * @param n Number of keys
+ * @param dist Distribution
+ * @param size Element size NU_DATAGEN_ANTIQSORT is built for (ignored otherwise)
+ * @param seed Seed
+ * @return true on success, false on invalid arguments or allocation failure
+ */
+bool nu_datagen_keys(int64_t* keys, size_t n, nu_datagen_dist_t dist, size_t size, uint64_t seed);
+
+/**
+ * @brief Convert keys to elements, preserving their order
+ * @param out Output, n elements of nu_datagen_type_size(type) bytes
+ * @param keys Keys in [0, n)
+ * @param n Number of keys
+ * @param type Element type
+ */
+void nu_datagen_fill(void* out, const int64_t* keys, size_t n, nu_datagen_type_t type);
+
+/**
+ * @brief Generate n elements of a type following a distribution
+ * @param out Output, n elements of nu_datagen_type_size(type) bytes
+ * @param n Number of elements
+ * @param dist Distribution
+ * @param type Element type
+ * @param seed Seed
+ * @return true on success, false on invalid arguments or allocation failure
+ */
+bool nu_datagen_generate(void* out, size_t n, nu_datagen_dist_t dist, nu_datagen_type_t type, uint64_t seed);
+
+/**
+ * @brief Size of an element type
+ * @param type Element type
+ * @return Size in bytes, or 0 for an invalid type
+ */
+size_t nu_datagen_type_size(nu_datagen_type_t type);
+
+/**
+ * @brief Comparator ordering elements of a type by key
+ * @param type Element type
+ * @return Comparator, or NULL for an invalid type
+ */
+nu_datagen_compare_fn nu_datagen_comparator(nu_datagen_type_t type);
+
+/**
+ * @brief Name of a distribution, e.g. "organ_pipe"
+ * @param dist Distribution
+ * @return Name, or "unknown"
+ */
+const char* nu_datagen_dist_name(nu_datagen_dist_t dist);
+
+/**
+ * @brief Name of an element type, e.g. "record64"
+ * @param type Element type
+ * @return Name, or "unknown"
+ */
+const char* nu_datagen_type_name(nu_datagen_type_t type);
+
+#endif /* NU_DATAGEN_H */
@@ -0,0 +1,488 @@
+#include "histogram.h"
+#include <math.h>
+#include <string.h>
+
+extern void* NU_MALLOC(size_t size);
+extern void NU_FREE(void* ptr);
+
+static const uint8_t encoding_magic[4] = {'N', 'U', 'H', '1'};
+
+static int32_t
+bucket_index (const nu_histogram* h, int64_t value)
+{
+  // Smallest power of two containing the value, relative to the first bucket
+  int32_t pow2_ceiling = 64 - __builtin_clzll((uint64_t)(value | h->sub_bucket_mask));
+  return pow2_ceiling - h->unit_magnitude - (h->sub_bucket_half_count_magnitude + 1);
+}
+
+static int32_t
+sub_bucket_index (const nu_histogram* h, int64_t value, int32_t bucket)
+{
+  return (int32_t)(value >> (bucket + h->unit_magnitude));
+}
+
+static size_t
+counts_index (const nu_histogram* h, int32_t bucket, int32_t sub_bucket)
+{
+  // Bucket 0 uses all sub-buckets; every later bucket only its upper half
+  return (size_t)(((int64_t)(bucket + 1) << h->sub_bucket_half_count_magnitude)
+                  + (sub_bucket - h->sub_bucket_half_count));
+}
+
+static size_t
+counts_index_for (const nu_histogram* h, int64_t value)
+{
+  int32_t bucket = bucket_index(h, value);
+  return counts_index(h, bucket, sub_bucket_index(h, value, bucket));
+}
+
+static int64_t
+value_at_index (const nu_histogram* h, size_t index)
+{
+  int32_t bucket     = (int32_t)(index >> h->sub_bucket_half_count_magnitude) - 1;
+  int32_t sub_bucket = (int32_t)(index & (size_t)(h->sub_bucket_half_count - 1)) + h->sub_bucket_half_count;
+  if (bucket < 0) {
+    sub_bucket -= h->sub_bucket_half_count;
+    bucket      = 0;
+  }
+  return (int64_t)sub_bucket << (bucket + h->unit_magnitude);
+}
+
+static int64_t
+lowest_equivalent (const nu_histogram* h, int64_t value)
+{
+  int32_t bucket = bucket_index(h, value);
+  return (int64_t)sub_bucket_index(h, value, bucket) << (bucket + h->unit_magnitude);
+}
+
+static int64_t
+equivalent_range (const nu_histogram* h, int64_t value)
+{
+  int32_t bucket     = bucket_index(h, value);
+  int32_t sub_bucket = sub_bucket_index(h, value, bucket);
+  int32_t adjusted   = sub_bucket >= h->sub_bucket_count ? bucket + 1 : bucket;
+  return (int64_t)1 << (h->unit_magnitude + adjusted);
+}
+
+static int64_t
+highest_equivalent (const nu_histogram* h, int64_t value)
+{
+  return lowest_equivalent(h, value) + equivalent_range(h, value) - 1;
+}
+
+static int64_t
+median_equivalent (const nu_histogram* h, int64_t value)
+{
+  return lowest_equivalent(h, value) + (equivalent_range(h, value) >> 1);
+}
+
+static void
+update_min_max_atomic (nu_histogram* h, int64_t value)
+{
+  int64_t current = atomic_load_explicit(&h->min, memory_order_relaxed);
+  while (value < current
+         && !atomic_compare_exchange_weak_explicit(&h->min, &current, value,
+           memory_order_relaxed, memory_order_relaxed)) {
+  }
+  current = atomic_load_explicit(&h->max, memory_order_relaxed);
+  while (value > current
+         && !atomic_compare_exchange_weak_explicit(&h->max, &current, value,
+           memory_order_relaxed, memory_order_relaxed)) {
+  }
+}
+
+bool
+nu_histogram_init (nu_histogram* histogram, int64_t lowest, int64_t highest, int32_t significant_figures)
+{
+  if (!histogram || lowest < 1 || significant_figures < 1 || significant_figures > 5
+      || highest < 2 * lowest) {
+    return false;
+  }
+
+  // Enough sub-buckets that 10^significant_figures steps fit in the range
+  // where each unit is distinguishable
+  int64_t largest_single_unit = 2;
+  for (int32_t i = 0; i < significant_figures; i++) {
+    largest_single_unit *= 10;
+  }
+  int32_t sub_bucket_count_magnitude = 0;
+  while (((int64_t)1 << sub_bucket_count_magnitude) < largest_single_unit) {
+    sub_bucket_count_magnitude++;
+  }
+
+  histogram->lowest                          = lowest;
+  histogram->highest                         = highest;
+  histogram->significant_figures             = significant_figures;
+  histogram->unit_magnitude                  = 63 - __builtin_clzll((uint64_t)lowest);
+  histogram->sub_bucket_half_count_magnitude = sub_bucket_count_magnitude - 1;
+  histogram->sub_bucket_count                = 1 << sub_bucket_count_magnitude;
+  histogram->sub_bucket_half_count           = histogram->sub_bucket_count / 2;
+  histogram->sub_bucket_mask                 = (int64_t)(histogram->sub_bucket_count - 1) << histogram->unit_magnitude;
+
+  if (histogram->unit_magnitude + sub_bucket_count_magnitude > 62) {
+    return false;
+  }
+
+  int64_t smallest_untrackable = (int64_t)histogram->sub_bucket_count << histogram->unit_magnitude;
+  int32_t buckets              = 1;
+  while (smallest_untrackable <= highest) {
+    if (smallest_untrackable > INT64_MAX / 2) {
+      buckets++;
+      break;
+    }
+    smallest_untrackable <<= 1;
+    buckets++;
+  }
+  histogram->bucket_count = buckets;
+  histogram->counts_len   = (size_t)(buckets + 1) * (size_t)histogram->sub_bucket_half_count;
+
+  histogram->counts = NU_MALLOC(histogram->counts_len * sizeof(*histogram->counts));
+  if (!histogram->counts) {
+    return false;
+  }
+  for (size_t i = 0; i < histogram->counts_len; i++) {
+    atomic_init(&histogram->counts[i], 0);
+  }
+  atomic_init(&histogram->total_count, 0);
+  atomic_init(&histogram->min, INT64_MAX);
+  atomic_init(&histogram->max, 0);
+  return true;
+}
+
+void
+nu_histogram_free (nu_histogram* histogram)
+{
+  if (histogram && histogram->counts) {
+    NU_FREE((void*)(uintptr_t)histogram->counts);
+    histogram->counts = NULL;
+  }
+}
+
+void
+nu_histogram_reset (nu_histogram* histogram)
+{
+  if (!histogram || !histogram->counts) {
+    return;
+  }
+  for (size_t i = 0; i < histogram->counts_len; i++) {
+    atomic_store_explicit(&histogram->counts[i], 0, memory_order_relaxed);
+  }
+  atomic_store_explicit(&histogram->total_count, 0, memory_order_relaxed);
+  atomic_store_explicit(&histogram->min, INT64_MAX, memory_order_relaxed);
+  atomic_store_explicit(&histogram->max, 0, memory_order_relaxed);
+}
+
+bool
+nu_histogram_record_n (nu_histogram* histogram, int64_t value, uint64_t count)
+{
+  if (!histogram || value < 0 || value > histogram->highest) {
+    return false;
+  }
+
+  // Single writer: relaxed loads and stores compile to plain moves
+  size_t index = counts_index_for(histogram, value);
+  atomic_store_explicit(&histogram->counts[index],
+    atomic_load_explicit(&histogram->counts[index], memory_order_relaxed) + count,
+    memory_order_relaxed);
+  atomic_store_explicit(&histogram->total_count,
+    atomic_load_explicit(&histogram->total_count, memory_order_relaxed) + count,
+    memory_order_relaxed);
+  if (value < atomic_load_explicit(&histogram->min, memory_order_relaxed)) {
+    atomic_store_explicit(&histogram->min, value, memory_order_relaxed);
+  }
+  if (value > atomic_load_explicit(&histogram->max, memory_order_relaxed)) {
+    atomic_store_explicit(&histogram->max, value, memory_order_relaxed);
+  }
+  return true;
+}
+
+bool
+nu_histogram_record (nu_histogram* histogram, int64_t value)
+{
+  return nu_histogram_record_n(histogram, value, 1);
+}
+
+bool
+nu_histogram_record_atomic (nu_histogram* histogram, int64_t value)
+{
+  if (!histogram || value < 0 || value > histogram->highest) {
+    return false;
+  }
+
+  atomic_fetch_add_explicit(&histogram->counts[counts_index_for(histogram, value)], 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&histogram->total_count, 1, memory_order_relaxed);
+  update_min_max_atomic(histogram, value);
+  return true;
+}
+
+bool
+nu_histogram_add (nu_histogram* dst, const nu_histogram* src)
+{
+  if (!dst || !src) {
+    return false;
+  }
+
+  bool same_layout = dst->lowest == src->lowest && dst->highest == src->highest
+                     && dst->significant_figures == src->significant_figures;
+  bool all_fit = true;
+  uint64_t added = 0;
+
+  for (size_t i = 0; i < src->counts_len; i++) {
+    uint64_t count = atomic_load_explicit(&src->counts[i], memory_order_relaxed);
+    if (count == 0) {
+      continue;
+    }
+    size_t index = i;
+    if (!same_layout) {
+      int64_t value = median_equivalent(src, value_at_index(src, i));
+      if (value > dst->highest) {
+        all_fit = false;
+        continue;
+      }
+      index = counts_index_for(dst, value);
+    }
+    atomic_fetch_add_explicit(&dst->counts[index], count, memory_order_relaxed);
+    added += count;
+  }
+  atomic_fetch_add_explicit(&dst->total_count, added, memory_order_relaxed);
+
+  if (added > 0) {
+    int64_t min = atomic_load_explicit(&src->min, memory_order_relaxed);
+    int64_t max = atomic_load_explicit(&src->max, memory_order_relaxed);
+    update_min_max_atomic(dst, min);
+    update_min_max_atomic(dst, max <= dst->highest ? max : dst->highest);
+  }
+  return all_fit;
+}
+
+int64_t
+nu_histogram_value_at_percentile (const nu_histogram* histogram, double percentile)
+{
+  uint64_t total = nu_histogram_count(histogram);
+  if (total == 0) {
+    return 0;
+  }
+  if (percentile <= 0.0) {
+    return nu_histogram_min(histogram);
+  }
+  if (percentile > 100.0) {
+    percentile = 100.0;
+  }
+
+  uint64_t target = (uint64_t)(percentile / 100.0 * (double)total + 0.5);
+  target = target > 1 ? target : 1;
+
+  int64_t max         = nu_histogram_max(histogram);
+  uint64_t cumulative = 0;
+  for (size_t i = 0; i < histogram->counts_len; i++) {
+    cumulative += atomic_load_explicit(&histogram->counts[i], memory_order_relaxed);
+    if (cumulative >= target) {
+      int64_t value = highest_equivalent(histogram, value_at_index(histogram, i));
+      return value < max ? value : max;
+    }
+  }
+  return max;
+}
+
+uint64_t
+nu_histogram_count (const nu_histogram* histogram)
+{
+  return histogram ? atomic_load_explicit(&histogram->total_count, memory_order_relaxed) : 0;
+}
+
+int64_t
+nu_histogram_min (const nu_histogram* histogram)
+{
+  if (nu_histogram_count(histogram) == 0) {
+    return 0;
+  }
+  return atomic_load_explicit(&histogram->min, memory_order_relaxed);
+}
+
+int64_t
+nu_histogram_max (const nu_histogram* histogram)
+{
+  if (nu_histogram_count(histogram) == 0) {
+    return 0;
+  }
+  return atomic_load_explicit(&histogram->max, memory_order_relaxed);
+}
+
+double
+nu_histogram_mean (const nu_histogram* histogram)
+{
+  uint64_t total = nu_histogram_count(histogram);
+  if (total == 0) {
+    return 0.0;
+  }
+  double sum = 0.0;
+  for (size_t i = 0; i < histogram->counts_len; i++) {
+    uint64_t count = atomic_load_explicit(&histogram->counts[i], memory_order_relaxed);
+    if (count > 0) {
+      sum += (double)count * (double)median_equivalent(histogram, value_at_index(histogram, i));
+    }
+  }
+  return sum / (double)total;
+}
+
+double
+nu_histogram_stddev (const nu_histogram* histogram)
+{
+  uint64_t total = nu_histogram_count(histogram);
+  if (total == 0) {
+    return 0.0;
+  }
+  double mean = nu_histogram_mean(histogram);
+  double sum  = 0.0;
+  for (size_t i = 0; i < histogram->counts_len; i++) {
+    uint64_t count = atomic_load_explicit(&histogram->counts[i], memory_order_relaxed);
+    if (count > 0) {
+      double delta = (double)median_equivalent(histogram, value_at_index(histogram, i)) - mean;
+      sum += (double)count * delta * delta;
+    }
+  }
+  return sqrt(sum / (double)total);
+}
+
+bool
+nu_histogram_values_are_equivalent (const nu_histogram* histogram, int64_t a, int64_t b)
+{
+  if (!histogram || a < 0 || b < 0) {
+    return false;
+  }
+  return lowest_equivalent(histogram, a) == lowest_equivalent(histogram, b);
+}
+
+// Unsigned LEB128; only writes while the buffer has room, always counts
+static void
+put_varint (uint8_t* buffer, size_t size, size_t* pos, uint64_t value)
+{
+  do {
+    uint8_t byte = (uint8_t)(value & 0x7f);
+    value >>= 7;
+    if (value) {
+      byte |= 0x80;
+    }
+    if (buffer && *pos < size) {
+      buffer[*pos] = byte;
+    }
+    (*pos)++;
+  } while (value);
+}
+
+static bool
+get_varint (const uint8_t* buffer, size_t size, size_t* pos, uint64_t* value)
+{
+  *value = 0;
+  for (int32_t shift = 0; shift < 64; shift += 7) {
+    if (*pos >= size) {
+      return false;
+    }
+    uint8_t byte = buffer[(*pos)++];
+    *value |= (uint64_t)(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Counts are written as ZigZag varints: a positive value is a bucket count,
+// a negative value a run of that many empty buckets
+static size_t
+encode_to (const nu_histogram* h, uint8_t* buffer, size_t size)
+{
+  size_t pos = 0;
+  for (size_t i = 0; i < sizeof(encoding_magic); i++) {
+    if (buffer && pos < size) {
+      buffer[pos] = encoding_magic[i];
+    }
+    pos++;
+  }
+  put_varint(buffer, size, &pos, (uint64_t)h->lowest);
+  put_varint(buffer, size, &pos, (uint64_t)h->highest);
+  put_varint(buffer, size, &pos, (uint64_t)h->significant_figures);
+  put_varint(buffer, size, &pos, (uint64_t)nu_histogram_min(h));
+  put_varint(buffer, size, &pos, (uint64_t)nu_histogram_max(h));
+
+  uint64_t zeros = 0;
+  for (size_t i = 0; i < h->counts_len; i++) {
+    uint64_t count = atomic_load_explicit(&h->counts[i], memory_order_relaxed);
+    if (count == 0) {
+      zeros++;
+      continue;
+    }
+    if (zeros > 0) {
+      put_varint(buffer, size, &pos, (zeros << 1) - 1);
+      zeros = 0;
+    }
+    put_varint(buffer, size, &pos, count << 1);
+  }
+  return pos;
+}
+
+size_t
+nu_histogram_encode (const nu_histogram* histogram, uint8_t* buffer, size_t size)
+{
+  if (!histogram || !histogram->counts) {
+    return 0;
+  }
+  size_t needed = encode_to(histogram, NULL, 0);
+  if (buffer && size >= needed) {
+    encode_to(histogram, buffer, size);
+  }
+  return needed;
+}
+
+bool
+nu_histogram_decode (nu_histogram* histogram, const uint8_t* buffer, size_t size)
+{
+  if (!histogram || !buffer || size < sizeof(encoding_magic)
+      || memcmp(buffer, encoding_magic, sizeof(encoding_magic)) != 0) {
+    return false;
+  }
+
+  size_t pos = sizeof(encoding_magic);
+  uint64_t lowest, highest, figures, min, max;
+  if (!get_varint(buffer, size, &pos, &lowest) || !get_varint(buffer, size, &pos, &highest)
+      || !get_varint(buffer, size, &pos, &figures) || !get_varint(buffer, size, &pos, &min)
+      || !get_varint(buffer, size, &pos, &max) || lowest > INT64_MAX || highest > INT64_MAX
+      || figures > 5 || min > INT64_MAX || max > INT64_MAX) {
+    return false;
+  }
+  if (!nu_histogram_init(histogram, (int64_t)lowest, (int64_t)highest, (int32_t)figures)) {
+    return false;
+  }
+
+  size_t index   = 0;
+  uint64_t total = 0;
+  while (pos < size) {
+    uint64_t value;
+    if (!get_varint(buffer, size, &pos, &value)) {
+      nu_histogram_free(histogram);
+      return false;
+    }
+    if (value & 1) {
+      uint64_t zeros = (value + 1) >> 1;
+      if (zeros > histogram->counts_len - index) {
+        nu_histogram_free(histogram);
+        return false;
+      }
+      index += (size_t)zeros;
+      continue;
+    }
+    if (index >= histogram->counts_len) {
+      nu_histogram_free(histogram);
+      return false;
+    }
+    atomic_store_explicit(&histogram->counts[index++], value >> 1, memory_order_relaxed);
+    total += value >> 1;
+  }
+
+  atomic_store_explicit(&histogram->total_count, total, memory_order_relaxed);
+  if (total > 0) {
+    atomic_store_explicit(&histogram->min, (int64_t)min, memory_order_relaxed);
+    atomic_store_explicit(&histogram->max, (int64_t)max, memory_order_relaxed);
+  }
+  return true;
+}
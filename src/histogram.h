@@ -0,0 +1,201 @@
+#ifndef NU_HISTOGRAM_H
+#define NU_HISTOGRAM_H
+
+/**
+ * @file histogram.h
+ * @brief High dynamic range histogram for recording latencies
+ *
+ * A log-linear bucketed recorder in the style of HdrHistogram. Values from
+ * 0 up to a configured maximum are recorded in O(1) with a configurable
+ * number of significant decimal digits: every recorded value is
+ * distinguishable from any other value that differs by more than
+ * 1 / 10^significant_figures of itself. Memory is fixed at initialization
+ * and independent of how many values are recorded, so a histogram can run
+ * for the lifetime of a service.
+ *
+ * Recording:
+ * - nu_histogram_record() is for a histogram owned by one thread (the usual
+ *   pattern is one histogram per thread, merged with nu_histogram_add())
+ * - nu_histogram_record_atomic() may be called concurrently from any number
+ *   of threads on a shared histogram; it is lock-free
+ *
+ * Queries (percentiles, mean, ...) and merging must not race with
+ * nu_histogram_record(); they may run concurrently with
+ * nu_histogram_record_atomic(), and then see a recent, possibly partially
+ * updated, state.
+ *
+ * Histograms serialize to a compact byte format (zero runs are run-length
+ * encoded, counts are variable-length integers) with nu_histogram_encode()
+ * and nu_histogram_decode().
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+/* For internal library builds, NU_MALLOC/NU_FREE are defined by compiler */
+#ifdef NU_MALLOC
+extern void* NU_MALLOC(size_t size);
+extern void NU_FREE(void* ptr);
+
+#endif
+
+typedef struct nu_histogram nu_histogram;
+
+struct nu_histogram {
+  int64_t lowest;            // Smallest value distinguishable from 0
+  int64_t highest;           // Largest value that can be recorded
+  int32_t significant_figures;
+
+  int32_t unit_magnitude;
+  int32_t sub_bucket_half_count_magnitude;
+  int32_t sub_bucket_half_count;
+  int32_t sub_bucket_count;
+  int64_t sub_bucket_mask;
+  int32_t bucket_count;
+  size_t counts_len;
+
+  _Atomic uint64_t* counts;
+  _Atomic uint64_t total_count;
+  _Atomic int64_t min;
+  _Atomic int64_t max;
+};
+
+/**
+ * @brief Initialize a histogram
+ * @param histogram Histogram to initialize
+ * @param lowest Smallest value distinguishable from 0 (>= 1); use 1 unless
+ *               values are known to be coarse, e.g. 1000 for ns values that
+ *               only need us resolution
+ * @param highest Largest value that can be recorded (>= 2 * lowest)
+ * @param significant_figures Decimal digits of precision, 1 to 5
+ * @return true on success, false on invalid arguments or allocation failure
+ */
+bool nu_histogram_init(nu_histogram* histogram, int64_t lowest, int64_t highest, int32_t significant_figures);
+
+/**
+ * @brief Release the memory of a histogram
+ * @param histogram Histogram to free (may be NULL)
+ */
+void nu_histogram_free(nu_histogram* histogram);
+
+/**
+ * @brief Clear all recorded values
+ * @param histogram Histogram to reset
+ */
+void nu_histogram_reset(nu_histogram* histogram);
+
+/**
+ * @brief Record a value (single writer)
+ * @param histogram Histogram to record into
+ * @param value Value to record, 0 to highest
+ * @return true if recorded, false if the value is out of range
+ */
+bool nu_histogram_record(nu_histogram* histogram, int64_t value);
+
+/**
+ * @brief Record a value count times (single writer)
+ * @param histogram Histogram to record into
+ * @param value Value to record, 0 to highest
+ * @param count Number of occurrences
+ * @return true if recorded, false if the value is out of range
+ */
+bool nu_histogram_record_n(nu_histogram* histogram, int64_t value, uint64_t count);
+
+/**
+ * @brief Record a value; safe to call concurrently from many threads
+ * @param histogram Histogram to record into
+ * @param value Value to record, 0 to highest
+ * @return true if recorded, false if the value is out of range
+ */
+bool nu_histogram_record_atomic(nu_histogram* histogram, int64_t value);
+
+/**
+ * @brief Add all values recorded in src to dst
+ *
+ * Histograms with the same configuration are merged count by count; otherwise
+ * each bucket of src is re-recorded at its midpoint.
+ *
+ * @param dst Histogram to add into
+ * @param src Histogram to add from
+ * @return true if every value fit, false if some exceeded dst's range
+ */
+bool nu_histogram_add(nu_histogram* dst, const nu_histogram* src);
+
+/**
+ * @brief Get the value at a percentile
+ * @param histogram Histogram to query
+ * @param percentile Percentile, 0 to 100
+ * @return Highest value equivalent to the recorded value at the percentile
+ *         (clamped to the exact maximum), or 0 if the histogram is empty
+ */
+int64_t nu_histogram_value_at_percentile(const nu_histogram* histogram, double percentile);
+
+/**
+ * @brief Get the number of values recorded
+ * @param histogram Histogram to query
+ * @return Total count
+ */
+uint64_t nu_histogram_count(const nu_histogram* histogram);
+
+/**
+ * @brief Get the exact smallest recorded value
+ * @param histogram Histogram to query
+ * @return Minimum, or 0 if the histogram is empty
+ */
+int64_t nu_histogram_min(const nu_histogram* histogram);
+
+/**
+ * @brief Get the exact largest recorded value
+ * @param histogram Histogram to query
+ * @return Maximum, or 0 if the histogram is empty
+ */
+int64_t nu_histogram_max(const nu_histogram* histogram);
+
+/**
+ * @brief Get the mean of the recorded values (to bucket precision)
+ * @param histogram Histogram to query
+ * @return Mean, or 0 if the histogram is empty
+ */
+double nu_histogram_mean(const nu_histogram* histogram);
+
+/**
+ * @brief Get the standard deviation of the recorded values (to bucket precision)
+ * @param histogram Histogram to query
+ * @return Population standard deviation, or 0 if the histogram is empty
+ */
+double nu_histogram_stddev(const nu_histogram* histogram);
+
+/**
+ * @brief Check whether two values fall into the same bucket
+ * @param histogram Histogram whose precision applies
+ * @param a First value
+ * @param b Second value
+ * @return true if the histogram cannot distinguish a from b
+ */
+bool nu_histogram_values_are_equivalent(const nu_histogram* histogram, int64_t a, int64_t b);
+
+/**
+ * @brief Serialize a histogram
+ *
+ * Like snprintf, the required size is returned even when the buffer is too
+ * small, in which case nothing is written.
+ *
+ * @param histogram Histogram to serialize
+ * @param buffer Output buffer (may be NULL when size is 0)
+ * @param size Size of the buffer in bytes
+ * @return Number of bytes the encoding needs
+ */
+size_t nu_histogram_encode(const nu_histogram* histogram, uint8_t* buffer, size_t size);
+
+/**
+ * @brief Initialize a histogram from nu_histogram_encode() output
+ * @param histogram Histogram to initialize (free with nu_histogram_free())
+ * @param buffer Encoded histogram
+ * @param size Size of the encoding in bytes
+ * @return true on success, false on malformed input or allocation failure
+ */
+bool nu_histogram_decode(nu_histogram* histogram, const uint8_t* buffer, size_t size);
+
+#endif /* NU_HISTOGRAM_H */
@@ -43,6 +43,11 @@ get_element (
   return (char*) base + index * size;
 }
 
+/* Elements up to this size are held in a stack buffer while insertion
+ * sort shifts larger ones right; bigger elements are swapped into place
+ * instead. Either way the sort never allocates. */
+#define INSERTION_KEY_SIZE 256
+
 static void
 insertion_sort (
   void* base,
@@ -51,10 +56,16 @@ insertion_sort (
   size_t size,
   int (*compar)(const void*, const void* ))
 {
-  char* key = NU_MALLOC(size);
-  if (!key)
+  if (size > INSERTION_KEY_SIZE) {
+    for (size_t i = low + 1; i <= high; i++) {
+      for (size_t j = i; j > low && compar(get_element(base, j - 1, size), get_element(base, j, size)) > 0; j--) {
+        swap_bytes(get_element(base, j - 1, size), get_element(base, j, size), size);
+      }
+    }
     return;
+  }
 
+  _Alignas(max_align_t) char key[INSERTION_KEY_SIZE];
   for (size_t i = low + 1; i <= high; i++) {
     memcpy(key, get_element(base, i, size), size);
 
@@ -65,8 +76,6 @@ insertion_sort (
     }
     memcpy(get_element(base, j, size), key, size);
   }
-
-  NU_FREE(key);
 }
 
 static void
@@ -28,14 +28,6 @@
 #include <stddef.h>
 #include <stdlib.h>
 
-/* For internal library builds, NU_MALLOC/NU_FREE are defined by compiler */
-/* These are not exposed to end users - sort.c handles allocation internally */
-#ifdef NU_MALLOC
-extern void* NU_MALLOC(size_t size);
-extern void NU_FREE(void* ptr);
-
-#endif
-
 #ifndef NU_QUICKSORT_STACK_SIZE
 #define NU_QUICKSORT_STACK_SIZE 64
 #endif
@@ -46,6 +38,8 @@ extern void NU_FREE(void* ptr);
  * This function sorts an array of nmemb elements of size bytes each.
  * The array is sorted in place using a hybrid introsort algorithm that
  * combines quicksort, heapsort, and insertion sort for optimal performance.
+ * It never allocates memory, so it cannot fail and is safe to call where
+ * allocation is not.
  *
  * @param base Pointer to the first element of the array to sort
  * @param nmemb Number of elements in the array
@@ -7,8 +7,17 @@
  * Features:
  * - Tests return nu_result_t for consistent error handling
  * - Automatic test registration via __attribute__((constructor))
- * - Zero dynamic allocation - all state is static
- * - ~250 lines of simple, readable code
+ * - No dynamic allocation when tests run in-process (the test table grows
+ *   as tests register, before any runs)
+ * - Parallel execution in forked worker processes (-j N), with output
+ *   reported in registration order
+ * - Per-test timeouts (--timeout) and a list of the slowest tests
+ * - Deterministic sharding (--shard i/n) and JUnit XML or JSON reports with
+ *   each test's wall time (--junit, --json)
+ * - Performance contracts: NU_ASSERT_COMPLEXITY checks the growth rate of
+ *   counted or timed work, NU_ASSERT_MAX_NS a time budget (link with -lm)
+ * - Stress tests: NU_STRESS_TEST runs a body concurrently on pinned threads
+ *   with randomized interleaving (link with -pthread)
  * - Header-only for easy inclusion
  *
  * Usage:
@@ -21,11 +30,36 @@
  *
  *   NU_TEST_MAIN()  // Generates main() that runs all tests
  *
+ * Command line (NU_TEST_MAIN):
+ *   -j, --jobs <n>       Run tests in n worker processes
+ *   --timeout <s>        Fail tests running longer than s seconds (300
+ *                        by default with -j, no limit in-process)
+ *   --slowest <n>        List the n slowest tests
+ *   --shard <i/n>        Run only shard i of n
+ *   --junit <file>       Write a JUnit XML report
+ *   --json <file>        Write a JSON report
+ *   -x, --stop-on-fail   Stop at the first failure
+ *   -v, --verbose        Print each test's time
+ *
+ * With -j, workers are forked once and handed tests one at a time from a
+ * shared queue, so a test runs in a worker that may already have run
+ * others, but never alongside state from tests in other workers. A test
+ * that times out (after 300 seconds unless --timeout says otherwise) or
+ * crashes fails and its worker is replaced. Each test's stdout and stderr
+ * are captured and printed with its result, in registration order, so the
+ * output is the same for any -j.
+ *
+ * --shard i/n keeps every nth test in registration order starting from the
+ * ith, so n runs (on different cores or machines) split a suite between
+ * them the same way every time. Reports list the shard's tests with their
+ * status and wall time; tests a -x run never reached are reported as not
+ * run. An in-process test that times out ends the run before reports are
+ * written, so use -j when a report must survive timeouts.
+ *
  * Known limitations:
- * - Maximum 512 tests per executable
- * - No parallel execution
  * - No fixtures (use static variables)
- * - Linux/macOS only (uses constructor attribute)
+ * - Linux/macOS only (uses constructor attribute); -j and --timeout need
+ *   POSIX (e.g. -D_DEFAULT_SOURCE), without it tests run serially
  */
 
 #ifndef NU_TEST_H
@@ -37,30 +71,85 @@
 #include <stdbool.h>
 #include <string.h>
 #include <stdint.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+
+#if defined(__APPLE__) || (defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 200809L)
+#define NU_TEST_POSIX
+#include <poll.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#endif
 
 // Test function signature - returns nu_result_t for consistency
 typedef nu_result_t (* nu_test_fn)(void);
 
+// Outcome of a test's last run
+typedef enum {
+  NU_TEST_NOT_RUN,
+  NU_TEST_PASSED,
+  NU_TEST_FAILED
+} nu_test_status_t;
+
 // Test registration entry
 typedef struct {
   const char* name;
   nu_test_fn fn;
   const char* file;
   int32_t line;
+  double ns;                   // Wall time of the test's last run
+  nu_test_status_t status;
+  nu_error_t error;            // Why the last run failed
 } nu_test_entry_t;
 
-// Global test state - no dynamic allocation needed
+// Most worker processes for -j
+#define NU_TEST_MAX_JOBS 256
+
+// Global test state; the test table grows as tests register, before any
+// test runs
 static struct {
-  nu_test_entry_t tests[512];  // Reasonable limit for single test file
-  int32_t count;
+  nu_test_entry_t* tests;
+  int32_t count;               // Tests to run (the shard's, with --shard)
+  int32_t capacity;
+  int32_t registered;          // Tests registered, before sharding
   int32_t passed;
   int32_t failed;
   bool verbose;
   bool stop_on_fail;
-  // Static storage for test errors to avoid compound literal scope issues
-  nu_error_t last_error;
+  int32_t jobs;                // Worker processes (-j); 0 or 1 runs tests in-process
+  double timeout;              // Per-test limit in seconds (--timeout), 0 for none
+  int32_t slowest;             // Slowest tests to list (--slowest)
+  const char* current;         // Test running in this process
+  int32_t shard;               // --shard i/n: run every nth test from the ith
+  int32_t shards;
+  const char* suite;           // Name of the suite in reports
+  const char* junit;           // Report paths (--junit, --json)
+  const char* json;
+  double ns;                   // Wall time of the whole run
 } nu_test_state = {0};
 
+// Static storage for test errors to avoid compound literal scope issues;
+// one per thread so stress test bodies can fail concurrently
+static _Thread_local nu_error_t nu_test_last_error;
+
+// The calling thread's test error. This replaces nu_test_state.last_error,
+// which was shared by all threads and no longer exists: code that filled
+// or returned &nu_test_state.last_error should use nu_test_error().
+static inline nu_error_t*
+nu_test_error (void)
+{
+  return &nu_test_last_error;
+}
+
 // Test registration - called by constructor attribute
 static inline void
 nu_test_register_impl (
@@ -69,15 +158,24 @@ nu_test_register_impl (
   const char* file,
   int32_t line)
 {
-  if (nu_test_state.count >= 512) {
-    fprintf(stderr, "ERROR: Too many tests registered (max 512)\n");
-    exit(1);
+  if (nu_test_state.count == nu_test_state.capacity) {
+    int32_t capacity       = nu_test_state.capacity > 0 ? nu_test_state.capacity * 2 : 64;
+    nu_test_entry_t* tests = realloc(nu_test_state.tests, (size_t)capacity * sizeof(*tests));
+    if (!tests) {
+      fprintf(stderr, "ERROR: Out of memory registering test %s\n", name);
+      exit(1);
+    }
+    nu_test_state.tests    = tests;
+    nu_test_state.capacity = capacity;
   }
-  nu_test_state.tests[nu_test_state.count].name = name;
-  nu_test_state.tests[nu_test_state.count].fn   = fn;
-  nu_test_state.tests[nu_test_state.count].file = file;
-  nu_test_state.tests[nu_test_state.count].line = line;
+  nu_test_state.tests[nu_test_state.count] = (nu_test_entry_t){
+    .name = name,
+    .fn   = fn,
+    .file = file,
+    .line = line,
+  };
   nu_test_state.count++;
+  nu_test_state.registered = nu_test_state.count;
 }
 
 // Test definition macro - creates function and registers it
@@ -91,14 +189,14 @@ nu_test_register_impl (
 
 // Helper macro to create persistent test errors
 #define NU_TEST_ERROR(errcode, errmsg) \
-        (nu_test_state.last_error = (nu_error_t){ \
+        (nu_test_last_error = (nu_error_t){ \
     .code = (errcode), \
     .file = __FILE__, \
     .line = __LINE__ \
   }, \
-  strncpy(nu_test_state.last_error.message, (errmsg), sizeof(nu_test_state.last_error.message) - 1), \
-  nu_test_state.last_error.message[sizeof(nu_test_state.last_error.message) - 1] = '\0', \
-  &nu_test_state.last_error)
+  strncpy(nu_test_last_error.message, (errmsg), sizeof(nu_test_last_error.message) - 1), \
+  nu_test_last_error.message[sizeof(nu_test_last_error.message) - 1] = '\0', \
+  &nu_test_last_error)
 
 // Test-specific failure macro that uses persistent storage
 #define NU_TEST_FAIL(code, msg) \
@@ -180,40 +278,1292 @@ nu_test_register_impl (
 #define NU_TEST_RED   "\033[31m"
 #define NU_TEST_RESET "\033[0m"
 
-// Test runner - returns exit code
-static inline int
-nu_test_run_all (void)
+// Monotonic clock in nanoseconds (wall clock without POSIX)
+static inline double
+nu_test_now_ns (void)
+{
+  struct timespec ts;
+#ifdef NU_TEST_POSIX
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+  timespec_get(&ts, TIME_UTC);
+#endif
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+// CPU time of the calling thread in nanoseconds, so time other processes
+// and threads take from it is not counted (wall clock without POSIX)
+static inline double
+nu_test_cpu_ns (void)
+{
+#ifdef NU_TEST_POSIX
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+#else
+  return nu_test_now_ns();
+#endif
+}
+
+// Fill nu_test_last_error with a formatted message
+__attribute__((format(printf, 3, 4)))
+static inline nu_error_t*
+nu_test_failure (
+  const char* file,
+  int32_t line,
+  const char* fmt,
+  ...)
+{
+  nu_error_t* err = &nu_test_last_error;
+  err->code = NU_ERR_GENERIC;
+  err->file = file;
+  err->line = line;
+  va_list args;
+  va_start(args, fmt);
+  vsnprintf(err->message, sizeof(err->message), fmt, args);
+  va_end(args);
+  return err;
+}
+
+// Performance contracts
+//
+// NU_ASSERT_COMPLEXITY(fn, sizes, bound) calls `double fn(size_t n)` at each
+// size and fails when the cost it returns grows faster than the bound.
+// Costs are counts of operations the test observes (comparator calls,
+// allocations, bytes), so the check is deterministic:
+//
+//   NU_ASSERT_COMPLEXITY(count_comparisons, NU_TEST_SIZES(1024, 4096, 16384), O_N_LOG_N);
+//
+// NU_ASSERT_COMPLEXITY_NS(fn, sizes, bound) does the same with the time of
+// `void fn(size_t n)`, measured as the CPU time of the calling thread so
+// that a loaded or oversubscribed machine does not slow the larger sizes
+// more than the smaller ones. Growth is the exponent k of the
+// least-squares fit of cost / bound(n) ~ n^k; it fails above
+// NU_TEST_COMPLEXITY_SLACK (counts) or NU_TEST_COMPLEXITY_SLACK_NS (times).
+// The slack absorbs constant factors, lower-order terms and, for times,
+// cache effects; exceeding an O(n log n) bound by a factor of n gives k
+// near 1. A timed fit over the slack is measured again, and fails only if
+// NU_TEST_TIMER_ATTEMPTS fits in a row are.
+//
+// NU_ASSERT_MAX_NS(expr, budget) fails when one evaluation of expr takes
+// longer than budget nanoseconds. expr runs in batches calibrated to be
+// long enough for the clock, and the fastest batch of NU_TEST_TIMER_SAMPLES
+// is compared against the budget, so interference from other processes
+// only fails the assertion if it persists for NU_TEST_TIMER_ATTEMPTS
+// attempts. Budgets should allow for unoptimized and sanitizer builds;
+// under ThreadSanitizer, whose slowdown is an order of magnitude larger,
+// they are multiplied by NU_TEST_TIME_SCALE.
+
+#ifndef NU_TEST_TIME_SCALE
+#ifdef __SANITIZE_THREAD__
+#define NU_TEST_TIME_SCALE 10.0
+#else
+#define NU_TEST_TIME_SCALE 1.0
+#endif
+#endif
+
+#define NU_TEST_COMPLEXITY_SLACK 0.2
+#define NU_TEST_COMPLEXITY_SLACK_NS 0.35
+#define NU_TEST_TIMER_MIN_NS 1e6
+#define NU_TEST_TIMER_SAMPLES 7
+#define NU_TEST_TIMER_ATTEMPTS 3
+
+typedef enum {
+  NU_TEST_O_1,
+  NU_TEST_O_LOG_N,
+  NU_TEST_O_N,
+  NU_TEST_O_N_LOG_N,
+  NU_TEST_O_N2,
+  NU_TEST_O_N3,
+} nu_test_complexity_t;
+
+// Sizes for NU_ASSERT_COMPLEXITY, expanding to an array and its length
+#define NU_TEST_SIZES(...) \
+        (const size_t[]){__VA_ARGS__}, sizeof((const size_t[]){__VA_ARGS__}) / sizeof(size_t)
+
+// Times repeated runs of a piece of code; see NU_ASSERT_MAX_NS
+typedef struct {
+  double budget;               // Per-run limit in ns; HUGE_VAL to just measure
+  uint64_t batch;              // Runs per sample, doubled until a sample is long enough
+  uint64_t remaining;          // Runs left in the current sample
+  double start;
+  bool cpu;                    // Time the calling thread's CPU time, not wall time
+  bool calibrated;
+  int32_t samples;
+  int32_t attempt;
+  double best;                 // Fastest per-run time of the current attempt
+} nu_test_timer_t;
+
+static inline void
+nu_test_timer_init (
+  nu_test_timer_t* timer,
+  double budget)
+{
+  memset(timer, 0, sizeof(*timer));
+  timer->budget    = budget * NU_TEST_TIME_SCALE;
+  timer->batch     = 1;
+  timer->remaining = 0;
+  timer->best      = HUGE_VAL;
+}
+
+// Returns true while the timed code should run once more
+static inline bool
+nu_test_timer_next (nu_test_timer_t* timer)
+{
+  if (timer->remaining > 0) {
+    timer->remaining--;
+    return true;
+  }
+
+  double now = timer->cpu ? nu_test_cpu_ns() : nu_test_now_ns();
+  if (timer->start > 0) {
+    double elapsed = now - timer->start;
+    if (!timer->calibrated && elapsed < NU_TEST_TIMER_MIN_NS && timer->batch < ((uint64_t)1 << 40)) {
+      timer->batch *= 2;
+    } else {
+      timer->calibrated = true;
+      timer->best       = fmin(timer->best, elapsed / (double)timer->batch);
+      timer->samples++;
+      if (timer->samples >= NU_TEST_TIMER_SAMPLES) {
+        if (timer->best <= timer->budget || ++timer->attempt >= NU_TEST_TIMER_ATTEMPTS) {
+          return false;
+        }
+        timer->samples = 0;
+        timer->best    = HUGE_VAL;
+      }
+    }
+  }
+
+  timer->remaining = timer->batch - 1;
+  timer->start     = timer->cpu ? nu_test_cpu_ns() : nu_test_now_ns();
+  return true;
+}
+
+static inline const char*
+nu_test_complexity_name (nu_test_complexity_t bound)
+{
+  switch (bound) {
+    case NU_TEST_O_1:       return "O(1)";
+    case NU_TEST_O_LOG_N:   return "O(log n)";
+    case NU_TEST_O_N:       return "O(n)";
+    case NU_TEST_O_N_LOG_N: return "O(n log n)";
+    case NU_TEST_O_N2:      return "O(n^2)";
+    case NU_TEST_O_N3:      return "O(n^3)";
+    default:                return "O(?)";
+  }
+}
+
+static inline double
+nu_test_complexity_value (
+  nu_test_complexity_t bound,
+  double n)
+{
+  switch (bound) {
+    case NU_TEST_O_1:       return 1.0;
+    case NU_TEST_O_LOG_N:   return log2(n);
+    case NU_TEST_O_N:       return n;
+    case NU_TEST_O_N_LOG_N: return n * log2(n);
+    case NU_TEST_O_N2:      return n * n;
+    case NU_TEST_O_N3:      return n * n * n;
+    default:                return 1.0;
+  }
+}
+
+// Least-squares slope of log(cost / bound) against log(n), measuring fn
+// (counted) or timed_fn (timed) at each size; one is added to costs so
+// zero counts are allowed
+static inline double
+nu_test_complexity_slope (
+  double (* fn)(size_t n),
+  void (* timed_fn)(size_t n),
+  const size_t* sizes,
+  size_t count,
+  nu_test_complexity_t bound)
+{
+  double sx = 0.0, sy = 0.0, sxx = 0.0, sxy = 0.0;
+  for (size_t i = 0; i < count; i++) {
+    double n    = (double)(sizes[i] < 2 ? 2 : sizes[i]);
+    double cost = 0.0;
+    if (timed_fn) {
+      nu_test_timer_t timer;
+      nu_test_timer_init(&timer, HUGE_VAL);
+      timer.cpu = true;
+      while (nu_test_timer_next(&timer)) {
+        timed_fn(sizes[i]);
+      }
+      cost = timer.best;
+    } else {
+      cost = fn(sizes[i]);
+    }
+    double x = log(n);
+    double y = log((cost + 1.0) / nu_test_complexity_value(bound, n));
+    sx  += x;
+    sy  += y;
+    sxx += x * x;
+    sxy += x * y;
+  }
+  double c = (double)count;
+  return (c * sxy - sx * sy) / (c * sxx - sx * sx);
+}
+
+// Check the growth of fn (counted) or timed_fn (timed) against the bound;
+// on failure, fills nu_test_last_error
+static inline bool
+nu_test_complexity (
+  double (* fn)(size_t n),
+  void (* timed_fn)(size_t n),
+  const size_t* sizes,
+  size_t count,
+  nu_test_complexity_t bound,
+  const char* file,
+  int32_t line)
+{
+  if (count < 2) {
+    nu_test_failure(file, line, "Complexity needs at least two sizes");
+    return false;
+  }
+  // Sizes below two are measured at two, as log(1) would divide by zero
+  size_t first  = sizes[0] < 2 ? 2 : sizes[0];
+  bool distinct = false;
+  for (size_t i = 1; i < count; i++) {
+    distinct = distinct || (sizes[i] < 2 ? 2 : sizes[i]) != first;
+  }
+  if (!distinct) {
+    nu_test_failure(file, line, "Complexity needs at least two different sizes");
+    return false;
+  }
+
+  // Counts are deterministic; times are measured again while over the slack
+  double slack     = timed_fn ? NU_TEST_COMPLEXITY_SLACK_NS : NU_TEST_COMPLEXITY_SLACK;
+  int32_t attempts = timed_fn ? NU_TEST_TIMER_ATTEMPTS : 1;
+  double slope     = 0.0;
+  for (int32_t attempt = 0; attempt < attempts; attempt++) {
+    slope = nu_test_complexity_slope(fn, timed_fn, sizes, count, bound);
+    if (slope <= slack) {
+      return true;
+    }
+  }
+  nu_test_failure(file, line, "Growth exceeds %s: %s grows as %s * n^%.2f",
+    nu_test_complexity_name(bound), timed_fn ? "time" : "cost",
+    nu_test_complexity_name(bound), slope);
+  return false;
+}
+
+// Check a finished timer against its budget
+static inline bool
+nu_test_timer_check (
+  const nu_test_timer_t* timer,
+  const char* expr,
+  const char* file,
+  int32_t line)
 {
-  printf("Running %d test%s...\n",
-    nu_test_state.count,
-    nu_test_state.count == 1 ? "" : "s");
+  if (timer->best <= timer->budget) {
+    return true;
+  }
+  nu_test_failure(file, line, "Took %.0f ns, over budget of %.0f ns: %s",
+    timer->best, timer->budget, expr);
+  return false;
+}
+
+#define NU_ASSERT_COMPLEXITY(fn, sizes, bound) \
+        do { \
+          if (!nu_test_complexity((fn), NULL, sizes, NU_TEST_ ## bound, __FILE__, __LINE__)) { \
+            return nu_err(&nu_test_last_error); \
+          } \
+        } while (0)
+
+#define NU_ASSERT_COMPLEXITY_NS(fn, sizes, bound) \
+        do { \
+          if (!nu_test_complexity(NULL, (fn), sizes, NU_TEST_ ## bound, __FILE__, __LINE__)) { \
+            return nu_err(&nu_test_last_error); \
+          } \
+        } while (0)
+
+#define NU_ASSERT_MAX_NS(expr, budget) \
+        do { \
+          nu_test_timer_t _timer; \
+          nu_test_timer_init(&_timer, (double)(budget)); \
+          while (nu_test_timer_next(&_timer)) { \
+            expr; \
+          } \
+          if (!nu_test_timer_check(&_timer, #expr, __FILE__, __LINE__)) { \
+            return nu_err(&nu_test_last_error); \
+          } \
+        } while (0)
+
+// Stress tests
+//
+// NU_STRESS_TEST(name, threads, iterations) runs its body `iterations`
+// times on each of `threads` threads at once. The threads are pinned to
+// different CPUs where possible and released together from a barrier, and
+// before every call each thread randomly yields, spins or goes straight on,
+// so each run tries a different interleaving. The body sees `thread`
+// (0 to threads - 1), `threads` and `iteration`, and fails like any test;
+// the first failure stops all threads and is reported with the thread and
+// iteration it happened on. Calling nu_test_stress_jitter() inside the body
+// perturbs the interleaving at that point too.
+//
+//   NU_STRESS_TEST(test_counter, 8, 10000) {
+//     NU_ASSERT(atomic_fetch_add(&counter, 1) >= 0);
+//     return nu_ok(NULL);
+//   }
+//
+// nu_test_stress(fn, threads, iterations) runs such a body from an ordinary
+// test, so shared state can be set up before and checked after. Build with
+// -pthread, and with -fsanitize=thread to report the races a run provokes.
+// Without POSIX threads the body runs on one thread, round-robin.
+
+#define NU_TEST_MAX_THREADS 256
 
+typedef nu_result_t (* nu_test_stress_fn)(int32_t thread, int32_t threads, size_t iteration);
+
+#ifdef NU_TEST_POSIX
+// Per-thread random state for jitter
+static _Thread_local uint64_t nu_test_stress_rng;
+
+// Shared by the threads of the running stress test. Threads wait on `gate`
+// until the main thread has started them all; the first failure is copied
+// out under `mutex` and `failed` stops the rest.
+static struct {
+  pthread_mutex_t mutex;
+  pthread_cond_t gate;
+  int32_t ready;
+  bool go;
+  atomic_bool failed;
+  nu_test_stress_fn fn;
+  int32_t threads;
+  size_t iterations;
+  uint64_t seed;
+  nu_error_t error;
+  int32_t failed_thread;
+  size_t failed_iteration;
+  pthread_t handles[NU_TEST_MAX_THREADS];
+} nu_test_stress_state = {
+  .mutex = PTHREAD_MUTEX_INITIALIZER,
+  .gate  = PTHREAD_COND_INITIALIZER,
+};
+
+// Pin the calling thread to one CPU; a no-op where affinity is unsupported
+static inline void
+nu_test_pin_thread (int32_t cpu)
+{
+#ifdef __linux__
+  unsigned long mask[16] = {0};
+  int32_t bits = (int32_t)(8 * sizeof(unsigned long));
+  if (cpu >= 0 && cpu < (int32_t)sizeof(mask) * 8) {
+    mask[cpu / bits] |= 1UL << (cpu % bits);
+    (void)syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask);
+  }
+#else
+  (void)cpu;
+#endif
+}
+#endif
+
+// Randomly yield the CPU, spin for up to ~1000 iterations, or do nothing
+static inline void
+nu_test_stress_jitter (void)
+{
+#ifdef NU_TEST_POSIX
+  uint64_t x = nu_test_stress_rng;
+  x                 ^= x << 13;
+  x                 ^= x >> 7;
+  x                 ^= x << 17;
+  nu_test_stress_rng = x;
+  switch (x >> 62) {
+  case 0:
+    sched_yield();
+    break;
+  case 1:
+    for (volatile uint64_t spin = (x >> 32) & 1023; spin > 0; spin--) {
+    }
+    break;
+  default:
+    break;
+  }
+#endif
+}
+
+#ifdef NU_TEST_POSIX
+static inline void*
+nu_test_stress_worker (void* arg)
+{
+  int32_t thread = (int32_t)(intptr_t)arg;
+  long cpus      = sysconf(_SC_NPROCESSORS_ONLN);
+  nu_test_pin_thread(thread % (int32_t)(cpus > 0 ? cpus : 1));
+
+  pthread_mutex_lock(&nu_test_stress_state.mutex);
+  nu_test_stress_rng = nu_test_stress_state.seed ^ ((uint64_t)thread + 1) * UINT64_C(0x9E3779B97F4A7C15);
+  nu_test_stress_state.ready++;
+  pthread_cond_broadcast(&nu_test_stress_state.gate);
+  while (!nu_test_stress_state.go) {
+    pthread_cond_wait(&nu_test_stress_state.gate, &nu_test_stress_state.mutex);
+  }
+  pthread_mutex_unlock(&nu_test_stress_state.mutex);
+
+  for (size_t i = 0; i < nu_test_stress_state.iterations; i++) {
+    if (atomic_load_explicit(&nu_test_stress_state.failed, memory_order_relaxed)) {
+      break;
+    }
+    nu_test_stress_jitter();
+    nu_result_t result = nu_test_stress_state.fn(thread, nu_test_stress_state.threads, i);
+    if (nu_is_err(&result)) {
+      pthread_mutex_lock(&nu_test_stress_state.mutex);
+      if (!atomic_exchange(&nu_test_stress_state.failed, true)) {
+        nu_test_stress_state.error            = *result.err;
+        nu_test_stress_state.failed_thread    = thread;
+        nu_test_stress_state.failed_iteration = i;
+      }
+      pthread_mutex_unlock(&nu_test_stress_state.mutex);
+      break;
+    }
+  }
+  return NULL;
+}
+#endif
+
+// Run fn on `threads` threads for `iterations` calls each
+static inline nu_result_t
+nu_test_stress (
+  nu_test_stress_fn fn,
+  int32_t threads,
+  size_t iterations)
+{
+  if (threads < 1 || threads > NU_TEST_MAX_THREADS) {
+    return nu_err(nu_test_failure(__FILE__, __LINE__, "Stress tests need 1 to %d threads, got %d",
+                                  NU_TEST_MAX_THREADS, threads));
+  }
+#ifdef NU_TEST_POSIX
+  nu_test_stress_state.fn         = fn;
+  nu_test_stress_state.threads    = threads;
+  nu_test_stress_state.iterations = iterations;
+  nu_test_stress_state.seed       = (uint64_t)nu_test_now_ns() | 1;
+  nu_test_stress_state.ready      = 0;
+  nu_test_stress_state.go         = false;
+  atomic_store(&nu_test_stress_state.failed, false);
+
+  int32_t started = 0;
+  while (started < threads &&
+         pthread_create(&nu_test_stress_state.handles[started], NULL, nu_test_stress_worker,
+                        (void*)(intptr_t)started) == 0) {
+    started++;
+  }
+
+  // Release them together once all are waiting
+  pthread_mutex_lock(&nu_test_stress_state.mutex);
+  while (nu_test_stress_state.ready < started) {
+    pthread_cond_wait(&nu_test_stress_state.gate, &nu_test_stress_state.mutex);
+  }
+  if (started < threads) {
+    atomic_store(&nu_test_stress_state.failed, true);
+  }
+  nu_test_stress_state.go = true;
+  pthread_cond_broadcast(&nu_test_stress_state.gate);
+  pthread_mutex_unlock(&nu_test_stress_state.mutex);
+
+  for (int32_t t = 0; t < started; t++) {
+    pthread_join(nu_test_stress_state.handles[t], NULL);
+  }
+  if (started < threads) {
+    return nu_err(nu_test_failure(__FILE__, __LINE__, "Could only start %d of %d threads",
+                                  started, threads));
+  }
+  if (atomic_load(&nu_test_stress_state.failed)) {
+    const nu_error_t* error = &nu_test_stress_state.error;
+    return nu_err(nu_test_failure(error->file, error->line, "Thread %d, iteration %zu: %s",
+                                  nu_test_stress_state.failed_thread,
+                                  nu_test_stress_state.failed_iteration, nu_error_message(error)));
+  }
+#else
+  for (size_t i = 0; i < iterations; i++) {
+    for (int32_t t = 0; t < threads; t++) {
+      nu_result_t result = fn(t, threads, i);
+      if (nu_is_err(&result)) {
+        nu_error_t error = *result.err;
+        return nu_err(nu_test_failure(error.file, error.line, "Thread %d, iteration %zu: %s",
+                                      t, i, nu_error_message(&error)));
+      }
+    }
+  }
+#endif
+  return nu_ok(NULL);
+}
+
+// Stress test definition; the body runs concurrently on every thread
+#define NU_STRESS_TEST(name, thread_count, iteration_count) \
+        static nu_result_t name ## _stress(__attribute__((unused)) int32_t thread, \
+                                           __attribute__((unused)) int32_t threads, \
+                                           __attribute__((unused)) size_t iteration); \
+        NU_TEST(name) { \
+          return nu_test_stress(name ## _stress, (thread_count), (iteration_count)); \
+        } \
+        static nu_result_t name ## _stress(__attribute__((unused)) int32_t thread, \
+                                           __attribute__((unused)) int32_t threads, \
+                                           __attribute__((unused)) size_t iteration)
+
+// Count and print one test's result; returns true if it passed
+static inline bool
+nu_test_record (
+  nu_test_entry_t* test,
+  nu_result_t result)
+{
+  test->status = nu_is_ok(&result) ? NU_TEST_PASSED : NU_TEST_FAILED;
+  if (nu_is_ok(&result)) {
+    nu_test_state.passed++;
+    printf("  %sPASS%s %s", NU_TEST_GREEN, NU_TEST_RESET, test->name);
+  } else {
+    nu_test_state.failed++;
+    printf("  %sFAIL%s %s", NU_TEST_RED, NU_TEST_RESET, test->name);
+
+    // Print error details on same line
+    if (result.err) {
+      test->error = *result.err;
+      printf(" → %s", nu_error_message(result.err));
+      if (result.err->file) {
+        printf(" [%s:%d]", result.err->file, result.err->line);
+      }
+    }
+  }
+  if (nu_test_state.verbose) {
+    printf(" (%.3f ms)", test->ns / 1e6);
+  }
+  printf("\n");
+  fflush(stdout);
+  return nu_is_ok(&result);
+}
+
+#ifdef NU_TEST_POSIX
+// SIGALRM handler for timeouts of in-process tests: report and exit, using
+// only async-signal-safe calls
+static inline void
+nu_test_alarm (int sig)
+{
+  static const char fail[]    = "  " NU_TEST_RED "FAIL" NU_TEST_RESET " ";
+  static const char timeout[] = " → Timed out\n";
+  (void)sig;
+  if (write(STDOUT_FILENO, fail, sizeof(fail) - 1) < 0 ||
+      write(STDOUT_FILENO, nu_test_state.current, strlen(nu_test_state.current)) < 0 ||
+      write(STDOUT_FILENO, timeout, sizeof(timeout) - 1) < 0) {
+    _exit(1);
+  }
+  _exit(1);
+}
+#endif
+
+// Run every test in this process, in registration order
+static inline int
+nu_test_run_serial (void)
+{
+#ifdef NU_TEST_POSIX
+  if (nu_test_state.timeout > 0) {
+    signal(SIGALRM, nu_test_alarm);
+  }
+#endif
   for (int32_t i = 0; i < nu_test_state.count; i++) {
     nu_test_entry_t* test = &nu_test_state.tests[i];
-    nu_result_t result    = test->fn();
+    nu_test_state.current = test->name;
+#ifdef NU_TEST_POSIX
+    if (nu_test_state.timeout > 0) {
+      unsigned seconds = (unsigned)nu_test_state.timeout;
+      alarm(seconds + ((double)seconds < nu_test_state.timeout ? 1 : 0));
+    }
+#endif
+    double start       = nu_test_now_ns();
+    nu_result_t result = test->fn();
+    test->ns = nu_test_now_ns() - start;
+#ifdef NU_TEST_POSIX
+    alarm(0);
+#endif
 
-    if (nu_is_ok(&result)) {
-      nu_test_state.passed++;
-      printf("  %sPASS%s %s\n", NU_TEST_GREEN, NU_TEST_RESET, test->name);
+    if (!nu_test_record(test, result) && nu_test_state.stop_on_fail) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+#ifdef NU_TEST_POSIX
+// The most captured output a worker sends back per test
+#define NU_TEST_MAX_OUTPUT (64 * 1024)
+
+// What a worker sends back for each test, followed by output_size bytes of
+// captured output. error.file points into the executable image, which the
+// workers share with the parent.
+typedef struct {
+  int32_t index;
+  bool ok;
+  double ns;
+  nu_error_t error;
+  uint32_t output_size;
+} nu_test_outcome_t;
+
+// A -j worker process and the test it is running
+typedef struct {
+  pid_t pid;                   // -1 when there is no worker
+  int command;                 // Write end: indices of tests to run
+  int results;                 // Read end: outcomes
+  int32_t test;                // Running test, -1 when idle
+  double started;
+} nu_test_worker_t;
+
+// Parallel run state; outcomes are held until every earlier test has
+// been reported. The per-test arrays are allocated for the run.
+static struct {
+  nu_test_worker_t workers[NU_TEST_MAX_JOBS];
+  int32_t count;
+  nu_test_outcome_t* outcomes;
+  char** outputs;
+  bool* done;
+} nu_test_parallel;
+
+static inline bool
+nu_test_read_full (
+  int fd,
+  void* data,
+  size_t size)
+{
+  char* p = data;
+  while (size > 0) {
+    ssize_t n = read(fd, p, size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    p    += n;
+    size -= (size_t)n;
+  }
+  return true;
+}
+
+static inline bool
+nu_test_write_full (
+  int fd,
+  const void* data,
+  size_t size)
+{
+  const char* p = data;
+  while (size > 0) {
+    ssize_t n = write(fd, p, size);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    p    += n;
+    size -= (size_t)n;
+  }
+  return true;
+}
+
+// Worker loop: run the tests named on `command` with stdout and stderr
+// captured in a temporary file, and send each outcome and its output on
+// `results`. Exits when the command pipe is closed.
+static inline void
+nu_test_worker_main (
+  int command,
+  int results)
+{
+  static char output[NU_TEST_MAX_OUTPUT];
+  FILE* capture = tmpfile();
+  if (capture) {
+    dup2(fileno(capture), STDOUT_FILENO);
+    dup2(fileno(capture), STDERR_FILENO);
+  }
+
+  int32_t index;
+  while (nu_test_read_full(command, &index, sizeof(index))) {
+    nu_test_entry_t* test = &nu_test_state.tests[index];
+    if (capture) {
+      if (ftruncate(STDOUT_FILENO, 0) != 0 || lseek(STDOUT_FILENO, 0, SEEK_SET) < 0) {
+        capture = NULL;
+      }
+    }
+
+    double start       = nu_test_now_ns();
+    nu_result_t result = test->fn();
+    nu_test_outcome_t outcome;
+    memset(&outcome, 0, sizeof(outcome));
+    outcome.ns    = nu_test_now_ns() - start;
+    outcome.index = index;
+    outcome.ok    = nu_is_ok(&result);
+    if (!outcome.ok && result.err) {
+      outcome.error = *result.err;
+    } else if (!outcome.ok) {
+      outcome.error.code = NU_ERR_GENERIC;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    if (capture) {
+      off_t size = lseek(STDOUT_FILENO, 0, SEEK_CUR);
+      if (size > 0) {
+        size_t wanted = (size_t)size < sizeof(output) ? (size_t)size : sizeof(output);
+        ssize_t got   = pread(STDOUT_FILENO, output, wanted, 0);
+        outcome.output_size = got > 0 ? (uint32_t)got : 0;
+      }
+    }
+
+    if (!nu_test_write_full(results, &outcome, sizeof(outcome)) ||
+        !nu_test_write_full(results, output, outcome.output_size)) {
+      break;
+    }
+  }
+  fflush(stdout);
+  fflush(stderr);
+  exit(0);
+}
+
+// Fork worker w; the child never returns
+static inline bool
+nu_test_spawn (int32_t w)
+{
+  int command[2], results[2];
+  if (pipe(command) != 0) {
+    return false;
+  }
+  if (pipe(results) != 0) {
+    close(command[0]);
+    close(command[1]);
+    return false;
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(command[0]);
+    close(command[1]);
+    close(results[0]);
+    close(results[1]);
+    return false;
+  }
+  if (pid == 0) {
+    // Only the parent may hold the other workers' pipes, or they would
+    // never see their command pipe close
+    for (int32_t o = 0; o < nu_test_parallel.count; o++) {
+      if (o != w && nu_test_parallel.workers[o].pid > 0) {
+        close(nu_test_parallel.workers[o].command);
+        close(nu_test_parallel.workers[o].results);
+      }
+    }
+    close(command[1]);
+    close(results[0]);
+    nu_test_worker_main(command[0], results[1]);
+  }
+
+  close(command[0]);
+  close(results[1]);
+  nu_test_worker_t* worker = &nu_test_parallel.workers[w];
+  worker->pid     = pid;
+  worker->command = command[1];
+  worker->results = results[0];
+  worker->test    = -1;
+  return true;
+}
+
+// Stop worker w (killing it first if `kill_it`) and return its wait status
+static inline int
+nu_test_retire (
+  int32_t w,
+  bool kill_it)
+{
+  nu_test_worker_t* worker = &nu_test_parallel.workers[w];
+  int status               = 0;
+  if (kill_it) {
+    kill(worker->pid, SIGKILL);
+  }
+  close(worker->command);
+  close(worker->results);
+  while (waitpid(worker->pid, &status, 0) < 0 && errno == EINTR) {
+  }
+  worker->pid  = -1;
+  worker->test = -1;
+  return status;
+}
+
+// Record a test that did not report back: it timed out or its worker died
+static inline void
+nu_test_lost (
+  int32_t index,
+  double ns,
+  const char* message)
+{
+  nu_test_outcome_t* outcome = &nu_test_parallel.outcomes[index];
+  memset(outcome, 0, sizeof(*outcome));
+  outcome->index      = index;
+  outcome->ns         = ns;
+  outcome->error.code = NU_ERR_GENERIC;
+  outcome->error.file = nu_test_state.tests[index].file;
+  outcome->error.line = nu_test_state.tests[index].line;
+  snprintf(outcome->error.message, sizeof(outcome->error.message), "%s", message);
+  nu_test_parallel.done[index] = true;
+}
+
+// Collect the outcome of the test worker w is running; replaces the worker
+// if it died
+static inline void
+nu_test_collect (
+  int32_t w,
+  bool replace)
+{
+  nu_test_worker_t* worker = &nu_test_parallel.workers[w];
+  int32_t index            = worker->test;
+  nu_test_outcome_t outcome;
+
+  if (nu_test_read_full(worker->results, &outcome, sizeof(outcome)) && outcome.index == index) {
+    char* output = outcome.output_size > 0 ? malloc(outcome.output_size) : NULL;
+    if (output) {
+      if (!nu_test_read_full(worker->results, output, outcome.output_size)) {
+        free(output);
+        output              = NULL;
+        outcome.output_size = 0;
+      }
     } else {
-      nu_test_state.failed++;
-      printf("  %sFAIL%s %s", NU_TEST_RED, NU_TEST_RESET, test->name);
-
-      // Print error details on same line
-      if (result.err) {
-        printf(" → %s", nu_error_message(result.err));
-        if (result.err->file) {
-          printf(" [%s:%d]", result.err->file, result.err->line);
+      // Drop the output rather than lose sync with the worker
+      char discard[4096];
+      for (uint32_t left = outcome.output_size; left > 0;) {
+        size_t chunk = left < sizeof(discard) ? left : sizeof(discard);
+        if (!nu_test_read_full(worker->results, discard, chunk))break;
+        left -= (uint32_t)chunk;
+      }
+      outcome.output_size = 0;
+    }
+    nu_test_parallel.outcomes[index] = outcome;
+    nu_test_parallel.outputs[index]  = output;
+    nu_test_parallel.done[index]     = true;
+    worker->test                     = -1;
+    return;
+  }
+
+  char message[128];
+  int status = nu_test_retire(w, true);
+  if (WIFSIGNALED(status)) {
+    snprintf(message, sizeof(message), "Crashed: %s", strsignal(WTERMSIG(status)));
+  } else {
+    snprintf(message, sizeof(message), "Worker exited with status %d", WEXITSTATUS(status));
+  }
+  nu_test_lost(index, nu_test_now_ns() - worker->started, message);
+  if (replace && !nu_test_spawn(w)) {
+    fprintf(stderr, "ERROR: Cannot restart test worker\n");
+  }
+}
+
+// Print every finished test that has no unfinished test before it; returns
+// false to stop on a failure
+static inline bool
+nu_test_flush (int32_t* printed)
+{
+  while (*printed < nu_test_state.count && nu_test_parallel.done[*printed]) {
+    int32_t index              = *printed;
+    nu_test_outcome_t* outcome = &nu_test_parallel.outcomes[index];
+    nu_test_entry_t* test      = &nu_test_state.tests[index];
+    test->ns = outcome->ns;
+    if (nu_test_parallel.outputs[index]) {
+      fwrite(nu_test_parallel.outputs[index], 1, outcome->output_size, stdout);
+      free(nu_test_parallel.outputs[index]);
+      nu_test_parallel.outputs[index] = NULL;
+    }
+    (*printed)++;
+    if (!nu_test_record(test, outcome->ok ? nu_ok(NULL) : nu_err(&outcome->error)) &&
+        nu_test_state.stop_on_fail) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Run the tests in nu_test_state.jobs forked workers
+static inline int
+nu_test_run_parallel (void)
+{
+  int32_t jobs = nu_test_state.jobs;
+  if (jobs > NU_TEST_MAX_JOBS)jobs = NU_TEST_MAX_JOBS;
+  if (jobs > nu_test_state.count)jobs = nu_test_state.count;
+
+  size_t count = (size_t)nu_test_state.count;
+  nu_test_parallel.outcomes = calloc(count, sizeof(*nu_test_parallel.outcomes));
+  nu_test_parallel.outputs  = calloc(count, sizeof(*nu_test_parallel.outputs));
+  nu_test_parallel.done     = calloc(count, sizeof(*nu_test_parallel.done));
+  if (!nu_test_parallel.outcomes || !nu_test_parallel.outputs || !nu_test_parallel.done) {
+    fprintf(stderr, "ERROR: Out of memory for %d tests\n", nu_test_state.count);
+    jobs = 0;
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+  nu_test_parallel.count = jobs;
+  for (int32_t w = 0; w < jobs; w++) {
+    nu_test_parallel.workers[w].pid = -1;
+  }
+  int32_t next    = 0;
+  int32_t printed = 0;
+  bool stopped    = jobs == 0;
+  for (int32_t w = 0; w < jobs && !stopped; w++) {
+    if (!nu_test_spawn(w)) {
+      fprintf(stderr, "ERROR: Cannot start test worker: %s\n", strerror(errno));
+      stopped = true;
+    }
+  }
+
+  while (printed < nu_test_state.count && !stopped) {
+    // Hand out tests to idle workers
+    for (int32_t w = 0; w < jobs && next < nu_test_state.count; w++) {
+      nu_test_worker_t* worker = &nu_test_parallel.workers[w];
+      if (worker->pid < 0 || worker->test >= 0) {
+        continue;
+      }
+      worker->test    = next;
+      worker->started = nu_test_now_ns();
+      if (!nu_test_write_full(worker->command, &next, sizeof(next))) {
+        nu_test_collect(w, true);
+      }
+      next++;
+    }
+
+    // Wait for an outcome or the earliest timeout
+    struct pollfd fds[NU_TEST_MAX_JOBS];
+    int32_t busy[NU_TEST_MAX_JOBS];
+    nfds_t nfds = 0;
+    double wait = -1.0;
+    double now  = nu_test_now_ns();
+    for (int32_t w = 0; w < jobs; w++) {
+      nu_test_worker_t* worker = &nu_test_parallel.workers[w];
+      if (worker->pid < 0 || worker->test < 0) {
+        continue;
+      }
+      fds[nfds].fd      = worker->results;
+      fds[nfds].events  = POLLIN;
+      fds[nfds].revents = 0;
+      busy[nfds++]      = w;
+      if (nu_test_state.timeout > 0) {
+        double left = worker->started + nu_test_state.timeout * 1e9 - now;
+        if (wait < 0 || left < wait) {
+          wait = left > 0 ? left : 0;
         }
       }
-      printf("\n");
+    }
+    if (nfds == 0) {
+      // Nothing is running, so every worker is gone
+      if (!nu_test_flush(&printed)) {
+        stopped = true;
+      } else if (printed < nu_test_state.count) {
+        fprintf(stderr, "ERROR: No test workers left\n");
+        stopped = true;
+      }
+      continue;
+    }
+    int ready = poll(fds, nfds, wait < 0 ? -1 : (int)(wait / 1e6) + 1);
+    if (ready < 0 && errno != EINTR) {
+      fprintf(stderr, "ERROR: poll failed: %s\n", strerror(errno));
+      break;
+    }
+
+    now = nu_test_now_ns();
+    for (nfds_t i = 0; i < nfds; i++) {
+      int32_t w                = busy[i];
+      nu_test_worker_t* worker = &nu_test_parallel.workers[w];
+      if (ready > 0 && fds[i].revents) {
+        nu_test_collect(w, next < nu_test_state.count);
+      } else if (nu_test_state.timeout > 0 &&
+                 now - worker->started >= nu_test_state.timeout * 1e9) {
+        char message[128];
+        int32_t index = worker->test;
+        snprintf(message, sizeof(message), "Timed out after %.1fs", nu_test_state.timeout);
+        nu_test_retire(w, true);
+        nu_test_lost(index, now - worker->started, message);
+        if (next < nu_test_state.count && !nu_test_spawn(w)) {
+          fprintf(stderr, "ERROR: Cannot restart test worker\n");
+        }
+      }
+    }
+
+    if (!nu_test_flush(&printed)) {
+      stopped = true;
+    }
+  }
+
+  // Closing the command pipes lets idle workers exit; busy ones are only
+  // left when stopping early, and are killed
+  for (int32_t w = 0; w < jobs; w++) {
+    if (nu_test_parallel.workers[w].pid > 0) {
+      nu_test_retire(w, nu_test_parallel.workers[w].test >= 0);
+    }
+  }
+  for (int32_t i = 0; nu_test_parallel.outputs && i < nu_test_state.count; i++) {
+    free(nu_test_parallel.outputs[i]);
+  }
+  free(nu_test_parallel.outcomes);
+  free(nu_test_parallel.outputs);
+  free(nu_test_parallel.done);
+  nu_test_parallel.outcomes = NULL;
+  nu_test_parallel.outputs  = NULL;
+  nu_test_parallel.done     = NULL;
+  return stopped ? 1 : 0;
+}
+#endif
+
+// Order tests by decreasing wall time
+static inline int
+nu_test_compare_slower (
+  const void* a,
+  const void* b)
+{
+  double x = (*(const nu_test_entry_t* const*)a)->ns;
+  double y = (*(const nu_test_entry_t* const*)b)->ns;
+  return (x < y) - (x > y);
+}
+
+// List the n slowest tests that ran
+static inline void
+nu_test_report_slowest (int32_t n)
+{
+  if (n <= 0 || nu_test_state.count == 0) {
+    return;
+  }
+  const nu_test_entry_t** order = malloc((size_t)nu_test_state.count * sizeof(*order));
+  if (!order) {
+    return;
+  }
+  int32_t ran = 0;
+  for (int32_t i = 0; i < nu_test_state.count; i++) {
+    if (nu_test_state.tests[i].status != NU_TEST_NOT_RUN) {
+      order[ran++] = &nu_test_state.tests[i];
+    }
+  }
+  qsort(order, (size_t)ran, sizeof(*order), nu_test_compare_slower);
+  if (n > ran)n = ran;
+
+  if (n > 0) {
+    printf("\nSlowest tests:\n");
+  }
+  for (int32_t k = 0; k < n; k++) {
+    printf("  %10.3f ms  %s\n", order[k]->ns / 1e6, order[k]->name);
+  }
+  free(order);
+}
+
+// Write s as a JSON string literal
+static inline void
+nu_test_json_string (
+  FILE* out,
+  const char* s)
+{
+  fputc('"', out);
+  for (; *s; s++) {
+    unsigned char ch = (unsigned char)*s;
+    if (ch == '"' || ch == '\\') {
+      fprintf(out, "\\%c", ch);
+    } else if (ch < 0x20) {
+      fprintf(out, "\\u%04x", ch);
+    } else {
+      fputc(ch, out);
+    }
+  }
+  fputc('"', out);
+}
+
+// Write s escaped for an XML attribute or text
+static inline void
+nu_test_xml_string (
+  FILE* out,
+  const char* s)
+{
+  for (; *s; s++) {
+    unsigned char ch = (unsigned char)*s;
+    switch (ch) {
+    case '&':  fputs("&amp;", out);  break;
+    case '<':  fputs("&lt;", out);   break;
+    case '>':  fputs("&gt;", out);   break;
+    case '"':  fputs("&quot;", out); break;
+    case '\'': fputs("&apos;", out); break;
+    default:
+      if (ch < 0x20 && ch != '\t' && ch != '\n') {
+        fprintf(out, "&#%u;", (unsigned)ch);
+      } else {
+        fputc(ch, out);
+      }
+    }
+  }
+}
+
+static inline const char*
+nu_test_status_name (nu_test_status_t status)
+{
+  switch (status) {
+  case NU_TEST_PASSED: return "passed";
+  case NU_TEST_FAILED: return "failed";
+  default:             return "not_run";
+  }
+}
+
+// JUnit XML report: one testsuite, each test a testcase whose time is its
+// wall time in seconds; tests a stopped run never reached are skipped
+static inline void
+nu_test_write_junit (FILE* out)
+{
+  int32_t skipped = nu_test_state.count - nu_test_state.passed - nu_test_state.failed;
+  fprintf(out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+  fprintf(out, "<testsuites tests=\"%d\" failures=\"%d\" skipped=\"%d\" time=\"%.6f\">\n",
+    nu_test_state.count, nu_test_state.failed, skipped, nu_test_state.ns / 1e9);
+  fprintf(out, "  <testsuite name=\"");
+  nu_test_xml_string(out, nu_test_state.suite);
+  fprintf(out, "\" tests=\"%d\" failures=\"%d\" errors=\"0\" skipped=\"%d\" time=\"%.6f\">\n",
+    nu_test_state.count, nu_test_state.failed, skipped, nu_test_state.ns / 1e9);
+  if (nu_test_state.shards > 1) {
+    fprintf(out, "    <properties>\n");
+    fprintf(out, "      <property name=\"shard\" value=\"%d/%d\"/>\n", nu_test_state.shard, nu_test_state.shards);
+    fprintf(out, "    </properties>\n");
+  }
+  for (int32_t i = 0; i < nu_test_state.count; i++) {
+    const nu_test_entry_t* test = &nu_test_state.tests[i];
+    fprintf(out, "    <testcase name=\"");
+    nu_test_xml_string(out, test->name);
+    fprintf(out, "\" classname=\"");
+    nu_test_xml_string(out, nu_test_state.suite);
+    fprintf(out, "\" file=\"");
+    nu_test_xml_string(out, test->file);
+    fprintf(out, "\" line=\"%d\" time=\"%.6f\"", test->line, test->ns / 1e9);
+    if (test->status == NU_TEST_PASSED) {
+      fprintf(out, "/>\n");
+      continue;
+    }
+    fprintf(out, ">\n");
+    if (test->status == NU_TEST_FAILED) {
+      fprintf(out, "      <failure message=\"");
+      nu_test_xml_string(out, nu_error_message(&test->error));
+      fprintf(out, "\">");
+      if (test->error.file) {
+        nu_test_xml_string(out, test->error.file);
+        fprintf(out, ":%d", test->error.line);
+      }
+      fprintf(out, "</failure>\n");
+    } else {
+      fprintf(out, "      <skipped message=\"not run\"/>\n");
+    }
+    fprintf(out, "    </testcase>\n");
+  }
+  fprintf(out, "  </testsuite>\n");
+  fprintf(out, "</testsuites>\n");
+}
 
-      if (nu_test_state.stop_on_fail) {
-        printf("\nStopping on first failure.\n");
-        return 1;
+// JSON report with each test's status and wall time in nanoseconds
+static inline void
+nu_test_write_json (FILE* out)
+{
+  fprintf(out, "{\n  \"suite\": ");
+  nu_test_json_string(out, nu_test_state.suite);
+  fprintf(out, ",\n  \"shard\": %d,\n  \"shards\": %d,\n", nu_test_state.shard, nu_test_state.shards);
+  fprintf(out, "  \"registered\": %d,\n  \"tests\": %d,\n", nu_test_state.registered, nu_test_state.count);
+  fprintf(out, "  \"passed\": %d,\n  \"failed\": %d,\n", nu_test_state.passed, nu_test_state.failed);
+  fprintf(out, "  \"jobs\": %d,\n  \"ns\": %.0f,\n", nu_test_state.jobs, nu_test_state.ns);
+  fprintf(out, "  \"results\": [");
+  for (int32_t i = 0; i < nu_test_state.count; i++) {
+    const nu_test_entry_t* test = &nu_test_state.tests[i];
+    fprintf(out, "%s\n    {\"name\": ", i > 0 ? "," : "");
+    nu_test_json_string(out, test->name);
+    fprintf(out, ", \"file\": ");
+    nu_test_json_string(out, test->file);
+    fprintf(out, ", \"line\": %d, \"status\": \"%s\", \"ns\": %.0f",
+      test->line, nu_test_status_name(test->status), test->ns);
+    if (test->status == NU_TEST_FAILED) {
+      fprintf(out, ", \"message\": ");
+      nu_test_json_string(out, nu_error_message(&test->error));
+      if (test->error.file) {
+        fprintf(out, ", \"at\": {\"file\": ");
+        nu_test_json_string(out, test->error.file);
+        fprintf(out, ", \"line\": %d}", test->error.line);
       }
     }
+    fprintf(out, "}");
   }
+  fprintf(out, "\n  ]\n}\n");
+}
+
+// Write a report to path; returns false if it could not be written
+static inline bool
+nu_test_write_report (
+  const char* path,
+  void (* write_fn)(FILE* out))
+{
+  FILE* out = fopen(path, "w");
+  if (!out) {
+    fprintf(stderr, "ERROR: Cannot write report '%s': %s\n", path, strerror(errno));
+    return false;
+  }
+  write_fn(out);
+  if (fclose(out) != 0) {
+    fprintf(stderr, "ERROR: Cannot write report '%s': %s\n", path, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+// Keep the tests of shard i of n: every nth test in registration order,
+// starting from the ith, so each shard's tests are the same on every run
+static inline void
+nu_test_select_shard (void)
+{
+  int32_t kept = 0;
+  for (int32_t i = 0; i < nu_test_state.count; i++) {
+    if (i % nu_test_state.shards == nu_test_state.shard - 1) {
+      nu_test_state.tests[kept++] = nu_test_state.tests[i];
+    }
+  }
+  nu_test_state.count = kept;
+}
+
+// Test runner - returns exit code
+static inline int
+nu_test_run_all (void)
+{
+  bool parallel = nu_test_state.jobs > 1 && nu_test_state.count > 1;
+#ifndef NU_TEST_POSIX
+  if (parallel) {
+    fprintf(stderr, "Note: built without POSIX support; running tests serially\n");
+    parallel = false;
+  }
+#endif
+
+  printf("Running %d test%s", nu_test_state.count, nu_test_state.count == 1 ? "" : "s");
+  if (nu_test_state.shards > 1) {
+    printf(" (shard %d/%d of %d)", nu_test_state.shard, nu_test_state.shards, nu_test_state.registered);
+  }
+  if (parallel) {
+    printf(" in %d workers",
+      nu_test_state.jobs < nu_test_state.count ? nu_test_state.jobs : nu_test_state.count);
+  }
+  printf("...\n");
+  fflush(stdout);
+
+  int stopped  = 0;
+  double start = nu_test_now_ns();
+#ifdef NU_TEST_POSIX
+  if (parallel) {
+    stopped = nu_test_run_parallel();
+  } else {
+    stopped = nu_test_run_serial();
+  }
+#else
+  stopped = nu_test_run_serial();
+#endif
+  nu_test_state.ns = nu_test_now_ns() - start;
+
+  bool reported = true;
+  if (nu_test_state.junit) {
+    reported = nu_test_write_report(nu_test_state.junit, nu_test_write_junit) && reported;
+  }
+  if (nu_test_state.json) {
+    reported = nu_test_write_report(nu_test_state.json, nu_test_write_json) && reported;
+  }
+
+  if (stopped && nu_test_state.stop_on_fail && nu_test_state.failed > 0) {
+    printf("\nStopping on first failure.\n");
+    return 1;
+  }
+
+  nu_test_report_slowest(nu_test_state.slowest);
 
   printf("\n");
   printf("%s%d Passed%s, %s%d Failed%s, %d Total\n",
@@ -224,7 +1574,7 @@ nu_test_run_all (void)
     nu_test_state.count);
   printf("\n");
 
-  return nu_test_state.failed > 0 ? 1 : 0;
+  return nu_test_state.failed > 0 || stopped || !reported ? 1 : 0;
 }
 
 // Configuration functions
@@ -240,11 +1590,131 @@ nu_test_set_stop_on_fail (bool stop)
   nu_test_state.stop_on_fail = stop;
 }
 
+static inline void
+nu_test_usage (const char* prog)
+{
+  printf("Usage: %s [options]\n", prog);
+  printf("Options:\n");
+  printf("  -j, --jobs <n>       Run tests in n worker processes (default: 1, in-process)\n");
+  printf("  --timeout <s>        Fail tests running longer than s seconds (default: 300 with -j, else none; 0: none)\n");
+  printf("  --slowest <n>        List the n slowest tests (default: 5 with -j, else 0)\n");
+  printf("  --shard <i/n>        Run only shard i of n (every nth test from the ith)\n");
+  printf("  --junit <file>       Write a JUnit XML report with each test's time\n");
+  printf("  --json <file>        Write a JSON report with each test's time\n");
+  printf("  -x, --stop-on-fail   Stop at the first failure\n");
+  printf("  -v, --verbose        Print each test's time\n");
+  printf("  -h, --help           Show this help\n");
+}
+
+// Parse the command line and run all tests - returns exit code
+static inline int
+nu_test_main (
+  int argc,
+  char** argv)
+{
+  nu_test_state.jobs    = 1;
+  nu_test_state.timeout = -1.0;
+  nu_test_state.slowest = -1;
+  nu_test_state.shard   = 1;
+  nu_test_state.shards  = 1;
+  nu_test_state.suite   = argc > 0 && argv[0] ? argv[0] : "tests";
+  if (strrchr(nu_test_state.suite, '/')) {
+    nu_test_state.suite = strrchr(nu_test_state.suite, '/') + 1;
+  }
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg   = argv[i];
+    const char* value = "";
+    char* end         = NULL;
+    if (strncmp(arg, "-j", 2) == 0 && arg[2] != '\0') {
+      value = arg + 2;
+      arg   = "-j";
+    } else if ((strcmp(arg, "-j") == 0 || strcmp(arg, "--jobs") == 0 ||
+                strcmp(arg, "--timeout") == 0 || strcmp(arg, "--slowest") == 0 ||
+                strcmp(arg, "--shard") == 0 || strcmp(arg, "--junit") == 0 ||
+                strcmp(arg, "--json") == 0)) {
+      if (i + 1 >= argc) {
+        fprintf(stderr, "ERROR: %s requires a value\n", arg);
+        return 2;
+      }
+      value = argv[++i];
+    }
+
+    if (strcmp(arg, "-j") == 0 || strcmp(arg, "--jobs") == 0) {
+      long jobs = strtol(value, &end, 10);
+      if (end == value || *end || jobs < 1) {
+        fprintf(stderr, "ERROR: Invalid job count '%s'\n", value);
+        return 2;
+      }
+      nu_test_state.jobs = jobs > NU_TEST_MAX_JOBS ? NU_TEST_MAX_JOBS : (int32_t)jobs;
+    } else if (strcmp(arg, "--timeout") == 0) {
+      nu_test_state.timeout = strtod(value, &end);
+      if (end == value || *end || !(nu_test_state.timeout >= 0)) {
+        fprintf(stderr, "ERROR: Invalid timeout '%s'\n", value);
+        return 2;
+      }
+    } else if (strcmp(arg, "--slowest") == 0) {
+      long slowest = strtol(value, &end, 10);
+      if (end == value || *end || slowest < 0 || slowest > INT32_MAX) {
+        fprintf(stderr, "ERROR: Invalid count '%s'\n", value);
+        return 2;
+      }
+      nu_test_state.slowest = (int32_t)slowest;
+    } else if (strcmp(arg, "--shard") == 0) {
+      long shard  = strtol(value, &end, 10);
+      long shards = 0;
+      if (end != value && *end == '/') {
+        const char* count = end + 1;
+        shards = strtol(count, &end, 10);
+        if (end == count) {
+          shards = 0;
+        }
+      }
+      if (*end || shards < 1 || shards > INT32_MAX || shard < 1 || shard > shards) {
+        fprintf(stderr, "ERROR: Invalid shard '%s' (expected i/n with 1 <= i <= n)\n", value);
+        return 2;
+      }
+      nu_test_state.shard  = (int32_t)shard;
+      nu_test_state.shards = (int32_t)shards;
+    } else if (strcmp(arg, "--junit") == 0) {
+      nu_test_state.junit = value;
+    } else if (strcmp(arg, "--json") == 0) {
+      nu_test_state.json = value;
+    } else if (strcmp(arg, "-x") == 0 || strcmp(arg, "--stop-on-fail") == 0) {
+      nu_test_set_stop_on_fail(true);
+    } else if (strcmp(arg, "-v") == 0 || strcmp(arg, "--verbose") == 0) {
+      nu_test_set_verbose(true);
+    } else if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+      nu_test_usage(argv[0]);
+      return 0;
+    } else {
+      fprintf(stderr, "ERROR: Unknown option '%s'\n", arg);
+      nu_test_usage(argv[0]);
+      return 2;
+    }
+  }
+
+  if (nu_test_state.slowest < 0) {
+    nu_test_state.slowest = nu_test_state.jobs > 1 ? 5 : 0;
+  }
+  // A worker that hangs is replaced, but an in-process timeout ends the
+  // whole run, so only -j has a default
+  if (nu_test_state.timeout < 0) {
+    nu_test_state.timeout = nu_test_state.jobs > 1 ? 300.0 : 0.0;
+  }
+  nu_test_select_shard();
+  int status = nu_test_run_all();
+  free(nu_test_state.tests);
+  nu_test_state.tests    = NULL;
+  nu_test_state.count    = 0;
+  nu_test_state.capacity = 0;
+  return status;
+}
+
 // Main macro for test programs
 #define NU_TEST_MAIN() \
         int main(int argc, char** argv) { \
-          (void)argc; (void)argv; \
-          return nu_test_run_all(); \
+          return nu_test_main(argc, argv); \
         }
 
 // Manual test registration for when constructors aren't available
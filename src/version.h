@@ -0,0 +1,40 @@
+#ifndef NU_VERSION_H
+#define NU_VERSION_H
+
+#include <stdint.h>
+
+#define NU_VERSION_MAJOR 0
+#define NU_VERSION_MINOR 1
+#define NU_VERSION_PATCH 0
+
+#define NU_VERSION_STRING "0.1.0"
+
+#define NU_MAKE_VERSION(major, minor, patch) ((major) * 10000 + (minor) * 100 + (patch))
+
+#define NU_VERSION NU_MAKE_VERSION(NU_VERSION_MAJOR, NU_VERSION_MINOR, NU_VERSION_PATCH)
+
+/**
+ * @brief Get the version string of the nu library
+ * @return Version string in the format "major.minor.patch"
+ */
+const char* nu_version(void);
+
+/**
+ * @brief Get the major version number
+ * @return Major version number
+ */
+uint32_t nu_version_major(void);
+
+/**
+ * @brief Get the minor version number
+ * @return Minor version number
+ */
+uint32_t nu_version_minor(void);
+
+/**
+ * @brief Get the patch version number
+ * @return Patch version number
+ */
+uint32_t nu_version_patch(void);
+
+#endif
@@ -0,0 +1,272 @@
+/* Test suite for datagen module using nu test framework */
+
+/* Include test framework directly */
+#include "../src/error.h"
+#include "../src/test.h"
+
+/* Standard headers */
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* Test utilities - include implementation directly */
+#include "test_utils.c"
+
+/* NU_MALLOC will be defined by the compiler for test builds (-DNU_MALLOC=test_malloc) */
+extern void* NU_MALLOC(size_t size);
+extern void NU_FREE(void* ptr);
+
+/* Module under test */
+#include "../src/datagen.h"
+#include "../src/sort.h"
+
+#define N 1000
+
+/* Comparisons made by the sorts below */
+static size_t comparisons;
+static nu_datagen_compare_fn counted_compare;
+
+static int
+count_compare (
+  const void* a,
+  const void* b)
+{
+  comparisons++;
+  return counted_compare(a, b);
+}
+
+/* Textbook quicksort: Lomuto partition around the middle element, no
+ * depth limit, so the adversary can make it quadratic */
+static void
+plain_quicksort (
+  void* base,
+  size_t nmemb,
+  size_t size,
+  nu_datagen_compare_fn compar)
+{
+  char* a = base;
+  char tmp[256];
+  if (nmemb < 2) {
+    return;
+  }
+  size_t mid = nmemb / 2, last = nmemb - 1, store = 0;
+  memcpy(tmp, a + mid * size, size);
+  memcpy(a + mid * size, a + last * size, size);
+  memcpy(a + last * size, tmp, size);
+  for (size_t i = 0; i < last; i++) {
+    if (compar(a + i * size, a + last * size) < 0) {
+      memcpy(tmp, a + i * size, size);
+      memcpy(a + i * size, a + store * size, size);
+      memcpy(a + store * size, tmp, size);
+      store++;
+    }
+  }
+  memcpy(tmp, a + store * size, size);
+  memcpy(a + store * size, a + last * size, size);
+  memcpy(a + last * size, tmp, size);
+  plain_quicksort(a, store, size, compar);
+  plain_quicksort(a + (store + 1) * size, last - store, size, compar);
+}
+
+static size_t
+count_key (
+  const int64_t* keys,
+  size_t n,
+  int64_t key)
+{
+  size_t count = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (keys[i] == key)count++;
+  }
+  return count;
+}
+
+NU_TEST(test_datagen_deterministic) {
+  int64_t a[N], b[N];
+
+  for (int32_t d = 0; d < NU_DATAGEN_DIST_COUNT; d++) {
+    NU_ASSERT(nu_datagen_keys(a, N, (nu_datagen_dist_t)d, 8, 42));
+    NU_ASSERT(nu_datagen_keys(b, N, (nu_datagen_dist_t)d, 8, 42));
+    NU_ASSERT_MEM_EQ(a, b, sizeof(a));
+  }
+
+  /* A different seed gives a different random input */
+  NU_ASSERT(nu_datagen_keys(a, N, NU_DATAGEN_RANDOM, 8, 42));
+  NU_ASSERT(nu_datagen_keys(b, N, NU_DATAGEN_RANDOM, 8, 43));
+  NU_ASSERT(memcmp(a, b, sizeof(a)) != 0);
+
+  return nu_ok(NULL);
+}
+
+NU_TEST(test_datagen_keys_in_range) {
+  int64_t keys[N];
+
+  for (int32_t d = 0; d < NU_DATAGEN_DIST_COUNT; d++) {
+    NU_ASSERT(nu_datagen_keys(keys, N, (nu_datagen_dist_t)d, 4, 7));
+    for (size_t i = 0; i < N; i++) {
+      NU_ASSERT_GE(keys[i], 0);
+      NU_ASSERT_LT(keys[i], N);
+    }
+  }
+
+  /* Empty and invalid requests */
+  NU_ASSERT(nu_datagen_keys(keys, 0, NU_DATAGEN_ZIPF, 4, 7));
+  NU_ASSERT(!nu_datagen_keys(NULL, N, NU_DATAGEN_RANDOM, 4, 7));
+  NU_ASSERT(!nu_datagen_keys(keys, N, NU_DATAGEN_DIST_COUNT, 4, 7));
+  NU_ASSERT(!nu_datagen_keys(keys, N, NU_DATAGEN_ANTIQSORT, 2, 7));
+
+  return nu_ok(NULL);
+}
+
+NU_TEST(test_datagen_shapes) {
+  int64_t keys[N];
+
+  nu_datagen_sorted(keys, N);
+  NU_ASSERT_EQ(keys[0], 0);
+  NU_ASSERT_EQ(keys[N - 1], N - 1);
+
+  nu_datagen_reversed(keys, N);
+  NU_ASSERT_EQ(keys[0], N - 1);
+  NU_ASSERT_EQ(keys[N - 1], 0);
+
+  /* Organ pipe rises to the middle and falls back */
+  nu_datagen_organ_pipe(keys, N);
+  for (size_t i = 1; i <= N / 2; i++) {
+    NU_ASSERT_EQ(keys[i], keys[i - 1] + 1);
+  }
+  for (size_t i = N / 2 + 1; i < N; i++) {
+    NU_ASSERT_EQ(keys[i], keys[i - 1] - 1);
+  }
+
+  /* Each swap displaces at most two positions */
+  uint64_t seed = 1;
+  nu_datagen_sorted_swaps(keys, N, 10, &seed);
+  size_t displaced = 0;
+  for (size_t i = 0; i < N; i++) {
+    if (keys[i] != (int64_t)i)displaced++;
+  }
+  NU_ASSERT_GT(displaced, 0u);
+  NU_ASSERT_LE(displaced, 20u);
+
+  /* Runs: descents only between runs of mean length 25 */
+  nu_datagen_runs(keys, N, 25, &seed);
+  size_t descents = 0;
+  for (size_t i = 1; i < N; i++) {
+    if (keys[i] < keys[i - 1])descents++;
+  }
+  NU_ASSERT_GT(descents, 10u);
+  NU_ASSERT_LT(descents, 80u);
+
+  /* Equal with outliers */
+  nu_datagen_equal_outliers(keys, N, 5, &seed);
+  NU_ASSERT_GE(count_key(keys, N, N / 2), N - 5u);
+
+  return nu_ok(NULL);
+}
+
+NU_TEST(test_datagen_zipf) {
+  static int64_t keys[100000];
+  uint64_t seed = 3;
+  nu_datagen_zipf(keys, 100000, 1.0, &seed);
+
+  /* With exponent 1 over 100000 ranks, rank 1 has probability 1/H(100000)
+   * (about 8.3%) and rank k 1/k of that */
+  size_t first  = count_key(keys, 100000, 0);
+  size_t second = count_key(keys, 100000, 1);
+  size_t tenth  = count_key(keys, 100000, 9);
+  NU_ASSERT_GT(first, 7500u);
+  NU_ASSERT_LT(first, 9100u);
+  NU_ASSERT_GT(second, first * 4 / 10);
+  NU_ASSERT_LT(second, first * 6 / 10);
+  NU_ASSERT_LT(tenth, first / 5);
+
+  return nu_ok(NULL);
+}
+
+NU_TEST(test_datagen_antiqsort) {
+  int64_t keys[N];
+  int32_t values[N];
+
+  /* Built against the textbook quicksort, it makes that sort quadratic */
+  NU_ASSERT(nu_datagen_antiqsort(keys, N, sizeof(int32_t), plain_quicksort));
+  nu_datagen_fill(values, keys, N, NU_DATAGEN_INT32);
+  counted_compare = nu_datagen_comparator(NU_DATAGEN_INT32);
+  comparisons     = 0;
+  plain_quicksort(values, N, sizeof(int32_t), count_compare);
+  NU_ASSERT_GT(comparisons, (size_t)N * N / 4);
+
+  /* Random input takes O(n log n) comparisons */
+  NU_ASSERT(nu_datagen_keys(keys, N, NU_DATAGEN_RANDOM, 4, 9));
+  nu_datagen_fill(values, keys, N, NU_DATAGEN_INT32);
+  comparisons = 0;
+  plain_quicksort(values, N, sizeof(int32_t), count_compare);
+  NU_ASSERT_LT(comparisons, (size_t)N * 30);
+
+  /* nu_sort's depth limit bounds the damage against its own adversary */
+  NU_ASSERT(nu_datagen_keys(keys, N, NU_DATAGEN_ANTIQSORT, sizeof(int32_t), 0));
+  nu_datagen_fill(values, keys, N, NU_DATAGEN_INT32);
+  comparisons = 0;
+  nu_sort(values, N, sizeof(int32_t), count_compare);
+  NU_ASSERT_LT(comparisons, (size_t)N * 100);
+
+  /* Invalid arguments */
+  NU_ASSERT(!nu_datagen_antiqsort(keys, N, 2, plain_quicksort));
+  NU_ASSERT(!nu_datagen_antiqsort(keys, N, 4, NULL));
+
+  return nu_ok(NULL);
+}
+
+NU_TEST(test_datagen_types_preserve_order) {
+  static unsigned char elements[N * 256];
+  int64_t keys[N];
+
+  NU_ASSERT_EQ(nu_datagen_type_size(NU_DATAGEN_INT32), 4u);
+  NU_ASSERT_EQ(nu_datagen_type_size(NU_DATAGEN_INT64), 8u);
+  NU_ASSERT_EQ(nu_datagen_type_size(NU_DATAGEN_DOUBLE), 8u);
+  NU_ASSERT_EQ(nu_datagen_type_size(NU_DATAGEN_STRING16), 16u);
+  NU_ASSERT_EQ(nu_datagen_type_size(NU_DATAGEN_RECORD64), 64u);
+  NU_ASSERT_EQ(nu_datagen_type_size(NU_DATAGEN_RECORD256), 256u);
+  NU_ASSERT_EQ(nu_datagen_type_size(NU_DATAGEN_TYPE_COUNT), 0u);
+  NU_ASSERT_NULL(nu_datagen_comparator(NU_DATAGEN_TYPE_COUNT));
+
+  /* Elements compare exactly as their keys do, including negatives */
+  NU_ASSERT(nu_datagen_keys(keys, N, NU_DATAGEN_RANDOM, 4, 11));
+  for (int32_t t = 0; t < NU_DATAGEN_TYPE_COUNT; t++) {
+    size_t size = nu_datagen_type_size((nu_datagen_type_t)t);
+    nu_datagen_compare_fn compare = nu_datagen_comparator((nu_datagen_type_t)t);
+    nu_datagen_fill(elements, keys, N, (nu_datagen_type_t)t);
+    for (size_t i = 1; i < N; i++) {
+      int expected = (keys[i - 1] > keys[i]) - (keys[i - 1] < keys[i]);
+      int actual   = compare(elements + (i - 1) * size, elements + i * size);
+      NU_ASSERT_EQ((actual > 0) - (actual < 0), expected);
+    }
+  }
+
+  /* Records carry their original index */
+  nu_datagen_fill(elements, keys, N, NU_DATAGEN_RECORD64);
+  NU_ASSERT_EQ(((nu_datagen_record64_t*)elements)[17].payload[0], 17u);
+
+  NU_ASSERT_STR_EQ(nu_datagen_dist_name(NU_DATAGEN_ORGAN_PIPE), "organ_pipe");
+  NU_ASSERT_STR_EQ(nu_datagen_type_name(NU_DATAGEN_RECORD256), "record256");
+  NU_ASSERT_STR_EQ(nu_datagen_type_name(NU_DATAGEN_TYPE_COUNT), "unknown");
+
+  return nu_ok(NULL);
+}
+
+NU_TEST(test_datagen_malloc_failure) {
+  int64_t keys[N];
+  int32_t values[N];
+
+  test_malloc_set_fail_after(0);
+  NU_ASSERT(!nu_datagen_antiqsort(keys, N, 4, plain_quicksort));
+  NU_ASSERT(!nu_datagen_generate(values, N, NU_DATAGEN_RANDOM, NU_DATAGEN_INT32, 1));
+  test_malloc_reset();
+
+  NU_ASSERT(nu_datagen_generate(values, N, NU_DATAGEN_SORTED, NU_DATAGEN_INT32, 1));
+  NU_ASSERT_EQ(values[0], -(N / 2));
+
+  return nu_ok(NULL);
+}
+
+// Main test runner
+NU_TEST_MAIN()
@@ -0,0 +1,406 @@
+/* Test suite for histogram module using nu test framework */
+
+/* Include test framework directly */
+#include "../src/error.h"
+#include "../src/test.h"
+
+/* Standard headers */
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/* Test utilities - include implementation directly */
+#include "test_utils.c"
+
+/* NU_MALLOC will be defined by the compiler for test builds (-DNU_MALLOC=test_malloc) */
+extern void* NU_MALLOC(size_t size);
+extern void NU_FREE(void* ptr);
+
+/* Module under test */
+#include "../src/histogram.h"
+
+#define HOUR_NS (3600LL * 1000000000LL)
+
+NU_TEST(test_histogram_init) {
+  nu_histogram h;
+
+  NU_ASSERT(nu_histogram_init(&h, 1, HOUR_NS, 3));
+  NU_ASSERT_EQ(nu_histogram_count(&h), 0u);
+  NU_ASSERT_EQ(nu_histogram_min(&h), 0);
+  NU_ASSERT_EQ(nu_histogram_max(&h), 0);
+  NU_ASSERT_EQ(nu_histogram_value_at_percentile(&h, 50.0), 0);
+  /* Memory is fixed and small for a 1ns..1h range at 3 digits */
+  NU_ASSERT_LT(h.counts_len * sizeof(uint64_t), 512u * 1024u);
+  nu_histogram_free(&h);
+
+  /* Invalid parameters */
+  NU_ASSERT(!nu_histogram_init(NULL, 1, 1000, 3));
+  NU_ASSERT(!nu_histogram_init(&h, 0, 1000, 3));
+  NU_ASSERT(!nu_histogram_init(&h, 1, 1, 3));
+  NU_ASSERT(!nu_histogram_init(&h, 1, 1000, 0));
+  NU_ASSERT(!nu_histogram_init(&h, 1, 1000, 6));
+
+  /* Free is safe on NULL */
+  nu_histogram_free(NULL);
+
+  return nu_ok(NULL);
+}
+
+NU_TEST(test_histogram_record) {
+  nu_histogram h;
+  NU_ASSERT(nu_histogram_init(&h, 1, HOUR_NS, 3));
+
+  NU_ASSERT(nu_histogram_record(&h, 1000));
+  NU_ASSERT(nu_histogram_record(&h, 5));
+  NU_ASSERT(nu_histogram_record_n(&h, 123456789, 3));
+  NU_ASSERT_EQ(nu_histogram_count(&h), 5u);
+
+  /* Min and max are exact, not bucketed */
+  NU_ASSERT_EQ(nu_histogram_min(&h), 5);
+  NU_ASSERT_EQ(nu_histogram_max(&h), 123456789);
+
+  /* Out of range values are rejected and not counted */
+  NU_ASSERT(!nu_histogram_record(&h, -1));
+  NU_ASSERT(!nu_histogram_record(&h, HOUR_NS + 1));
+  NU_ASSERT(!nu_histogram_record_atomic(&h, -1));
+  NU_ASSERT_EQ(nu_histogram_count(&h), 5u);
+
+  /* Zero and the upper bound are both recordable */
+  NU_ASSERT(nu_histogram_record(&h, 0));
+  NU_ASSERT(nu_histogram_record(&h, HOUR_NS));
+  NU_ASSERT_EQ(nu_histogram_min(&h), 0);
+  NU_ASSERT_EQ(nu_histogram_max(&h), HOUR_NS);
+
+  nu_histogram_free(&h);
+  return nu_ok(NULL);
+}
+
+NU_TEST(test_histogram_percentiles) {
+  nu_histogram h;
+  NU_ASSERT(nu_histogram_init(&h, 1, 10000000, 3));
+
+  /* 1..10000: the value at p is p*100 within 0.1% */
+  for (int64_t v = 1; v <= 10000; v++) {
+    NU_ASSERT(nu_histogram_record(&h, v));
+  }
+
+  NU_ASSERT_EQ(nu_histogram_value_at_percentile(&h, 0.0), 1);
+  NU_ASSERT_EQ(nu_histogram_value_at_percentile(&h, 100.0), 10000);
+
+  const double percentiles[] = {1.0, 25.0, 50.0, 90.0, 99.0, 99.9};
+  for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); i++) {
+    int64_t expected = (int64_t)(percentiles[i] * 100.0);
+    int64_t actual   = nu_histogram_value_at_percentile(&h, percentiles[i]);
+    NU_ASSERT_GE(actual, expected);
+    NU_ASSERT_LE(actual, expected + expected / 1000 + 1);
+  }
+
+  /* Mean and stddev of the uniform distribution, to bucket precision */
+  double mean = nu_histogram_mean(&h);
+  NU_ASSERT(mean > 5000.5 * 0.999 && mean < 5000.5 * 1.001);
+  double stddev = nu_histogram_stddev(&h);
+  NU_ASSERT(stddev > 2886.75 * 0.999 && stddev < 2886.75 * 1.001);
+
+  nu_histogram_free(&h);
+  return nu_ok(NULL);
+}
+
+NU_TEST(test_histogram_precision) {
+  const int32_t figures[] = {1, 2, 3, 4, 5};
+  for (size_t f = 0; f < sizeof(figures) / sizeof(figures[0]); f++) {
+    nu_histogram h;
+    NU_ASSERT(nu_histogram_init(&h, 1, HOUR_NS, figures[f]));
+
+    int64_t resolution = 1;
+    for (int32_t i = 0; i < figures[f]; i++) {
+      resolution *= 10;
+    }
+
+    /* Values that differ by more than 1/10^figures are distinguishable */
+    for (int64_t v = 1000; v < HOUR_NS / 4; v *= 7) {
+      int64_t next = v + v / resolution + 1;
+      NU_ASSERT(!nu_histogram_values_are_equivalent(&h, v, next));
+    }
+
+    /* Small integers are exact */
+    NU_ASSERT(!nu_histogram_values_are_equivalent(&h, 1, 2));
+    NU_ASSERT(nu_histogram_values_are_equivalent(&h, 7, 7));
+
+    nu_histogram_free(&h);
+  }
+
+  /* With a coarse lowest value, nearby small values collapse */
+  nu_histogram h;
+  NU_ASSERT(nu_histogram_init(&h, 1000, HOUR_NS, 3));
+  NU_ASSERT(nu_histogram_values_are_equivalent(&h, 1, 2));
+  NU_ASSERT(!nu_histogram_values_are_equivalent(&h, 1000, 2000));
+  nu_histogram_free(&h);
+
+  return nu_ok(NULL);
+}
+
+NU_TEST(test_histogram_reset) {
+  nu_histogram h;
+  NU_ASSERT(nu_histogram_init(&h, 1, 1000000, 3));
+
+  NU_ASSERT(nu_histogram_record(&h, 42));
+  NU_ASSERT(nu_histogram_record(&h, 4200));
+  nu_histogram_reset(&h);
+
+  NU_ASSERT_EQ(nu_histogram_count(&h), 0u);
+  NU_ASSERT_EQ(nu_histogram_max(&h), 0);
+  NU_ASSERT_EQ(nu_histogram_value_at_percentile(&h, 99.0), 0);
+
+  NU_ASSERT(nu_histogram_record(&h, 7));
+  NU_ASSERT_EQ(nu_histogram_min(&h), 7);
+  NU_ASSERT_EQ(nu_histogram_max(&h), 7);
+
+  nu_histogram_free(&h);
+  return nu_ok(NULL);
+}
+
+NU_TEST(test_histogram_add) {
+  nu_histogram a, b, c;
+  NU_ASSERT(nu_histogram_init(&a, 1, 1000000, 3));
+  NU_ASSERT(nu_histogram_init(&b, 1, 1000000, 3));
+  NU_ASSERT(nu_histogram_init(&c, 1, 1000, 2));
+
+  for (int64_t v = 1; v <= 500; v++) {
+    NU_ASSERT(nu_histogram_record(&a, v));
+    NU_ASSERT(nu_histogram_record(&b, v + 500));
+  }
+
+  /* Same configuration: exact merge */
+  NU_ASSERT(nu_histogram_add(&a, &b));
+  NU_ASSERT_EQ(nu_histogram_count(&a), 1000u);
+  NU_ASSERT_EQ(nu_histogram_min(&a), 1);
+  NU_ASSERT_EQ(nu_histogram_max(&a), 1000);
+  NU_ASSERT_EQ(nu_histogram_value_at_percentile(&a, 50.0), 500);
+
+  /* Different configuration: re-recorded at bucket precision */
+  NU_ASSERT(nu_histogram_add(&c, &b));
+  NU_ASSERT_EQ(nu_histogram_count(&c), 500u);
+  NU_ASSERT(nu_histogram_values_are_equivalent(&c, nu_histogram_value_at_percentile(&c, 50.0), 750));
+
+  /* Values beyond the destination range are dropped and reported */
+  NU_ASSERT(nu_histogram_record(&b, 999999));
+  nu_histogram_reset(&c);
+  NU_ASSERT(!nu_histogram_add(&c, &b));
+  NU_ASSERT_EQ(nu_histogram_count(&c), 500u);
+
+  NU_ASSERT(!nu_histogram_add(NULL, &b));
+  NU_ASSERT(!nu_histogram_add(&a, NULL));
+
+  nu_histogram_free(&a);
+  nu_histogram_free(&b);
+  nu_histogram_free(&c);
+  return nu_ok(NULL);
+}
+
+#define THREADS 4
+#define PER_THREAD 100000
+
+typedef struct {
+  nu_histogram* shared;
+  nu_histogram local;
+  int32_t id;
+} recorder_t;
+
+static void*
+recorder_thread (void* arg)
+{
+  recorder_t* r = arg;
+  for (int64_t i = 0; i < PER_THREAD; i++) {
+    int64_t value = 1 + (i * THREADS + r->id) % 10000;
+    nu_histogram_record_atomic(r->shared, value);
+    nu_histogram_record(&r->local, value);
+  }
+  return NULL;
+}
+
+NU_TEST(test_histogram_concurrent) {
+  nu_histogram shared, merged;
+  recorder_t recorders[THREADS];
+  pthread_t threads[THREADS];
+
+  NU_ASSERT(nu_histogram_init(&shared, 1, 1000000, 3));
+  NU_ASSERT(nu_histogram_init(&merged, 1, 1000000, 3));
+  for (int32_t i = 0; i < THREADS; i++) {
+    recorders[i].shared = &shared;
+    recorders[i].id     = i;
+    NU_ASSERT(nu_histogram_init(&recorders[i].local, 1, 1000000, 3));
+  }
+
+  for (int32_t i = 0; i < THREADS; i++) {
+    NU_ASSERT_EQ(pthread_create(&threads[i], NULL, recorder_thread, &recorders[i]), 0);
+  }
+  for (int32_t i = 0; i < THREADS; i++) {
+    pthread_join(threads[i], NULL);
+    NU_ASSERT(nu_histogram_add(&merged, &recorders[i].local));
+    nu_histogram_free(&recorders[i].local);
+  }
+
+  /* Lock-free shared recording and per-thread merging agree exactly */
+  NU_ASSERT_EQ(nu_histogram_count(&shared), (uint64_t)THREADS * PER_THREAD);
+  NU_ASSERT_EQ(nu_histogram_count(&merged), (uint64_t)THREADS * PER_THREAD);
+  NU_ASSERT_EQ(nu_histogram_min(&shared), 1);
+  NU_ASSERT_EQ(nu_histogram_max(&shared), 10000);
+  for (size_t i = 0; i < shared.counts_len; i++) {
+    NU_ASSERT_EQ(atomic_load(&shared.counts[i]), atomic_load(&merged.counts[i]));
+  }
+
+  nu_histogram_free(&shared);
+  nu_histogram_free(&merged);
+  return nu_ok(NULL);
+}
+
+/* Shared histogram of the stress test below */
+static nu_histogram stress_shared;
+
+#define STRESS_THREADS 8
+#define STRESS_ITERATIONS 20000
+
+static nu_result_t
+record_atomic_stress (
+  int32_t thread,
+  int32_t threads,
+  size_t iteration)
+{
+  int64_t value = 1 + (int64_t)((iteration * (size_t)threads + (size_t)thread) % 10000);
+  NU_ASSERT(nu_histogram_record_atomic(&stress_shared, value));
+  nu_test_stress_jitter();
+
+  /* Once recorded, a value stays within the shared min and max */
+  NU_ASSERT_LE(nu_histogram_min(&stress_shared), value);
+  NU_ASSERT_GE(nu_histogram_max(&stress_shared), value);
+  return nu_ok(NULL);
+}
+
+NU_TEST(test_histogram_record_atomic_stress) {
+  NU_ASSERT(nu_histogram_init(&stress_shared, 1, 1000000, 3));
+  nu_result_t result = nu_test_stress(record_atomic_stress, STRESS_THREADS, STRESS_ITERATIONS);
+  uint64_t count     = nu_histogram_count(&stress_shared);
+  int64_t min        = nu_histogram_min(&stress_shared);
+  int64_t max        = nu_histogram_max(&stress_shared);
+  nu_histogram_free(&stress_shared);
+
+  NU_ASSERT_OK(result);
+  NU_ASSERT_EQ(count, (uint64_t)STRESS_THREADS * STRESS_ITERATIONS);
+  NU_ASSERT_EQ(min, 1);
+  NU_ASSERT_EQ(max, 10000);
+  return nu_ok(NULL);
+}
+
+NU_TEST(test_histogram_encode_decode) {
+  nu_histogram h, copy;
+  NU_ASSERT(nu_histogram_init(&h, 1, HOUR_NS, 3));
+
+  for (int64_t v = 1; v <= 100000; v += 7) {
+    NU_ASSERT(nu_histogram_record(&h, v * 1000));
+  }
+  NU_ASSERT(nu_histogram_record_n(&h, 3, 1000000));
+
+  /* Size query, then encode */
+  size_t needed = nu_histogram_encode(&h, NULL, 0);
+  NU_ASSERT_GT(needed, 0u);
+  uint8_t* buffer = malloc(needed);
+  NU_ASSERT_NOT_NULL(buffer);
+  NU_ASSERT_EQ(nu_histogram_encode(&h, buffer, needed), needed);
+
+  /* Compact: far smaller than the raw counts array */
+  NU_ASSERT_LT(needed, h.counts_len * sizeof(uint64_t) / 4);
+
+  NU_ASSERT(nu_histogram_decode(&copy, buffer, needed));
+  NU_ASSERT_EQ(nu_histogram_count(&copy), nu_histogram_count(&h));
+  NU_ASSERT_EQ(nu_histogram_min(&copy), nu_histogram_min(&h));
+  NU_ASSERT_EQ(nu_histogram_max(&copy), nu_histogram_max(&h));
+  NU_ASSERT_EQ(copy.counts_len, h.counts_len);
+  for (size_t i = 0; i < h.counts_len; i++) {
+    NU_ASSERT_EQ(atomic_load(&copy.counts[i]), atomic_load(&h.counts[i]));
+  }
+  NU_ASSERT_EQ(nu_histogram_value_at_percentile(&copy, 99.0),
+               nu_histogram_value_at_percentile(&h, 99.0));
+
+  free(buffer);
+  nu_histogram_free(&copy);
+  nu_histogram_free(&h);
+  return nu_ok(NULL);
+}
+
+NU_TEST(test_histogram_encode_small_buffer) {
+  nu_histogram h;
+  NU_ASSERT(nu_histogram_init(&h, 1, 1000000, 3));
+  NU_ASSERT(nu_histogram_record(&h, 12345));
+
+  uint8_t buffer[64];
+  memset(buffer, 0xAA, sizeof(buffer));
+  size_t needed = nu_histogram_encode(&h, buffer, 4);
+  NU_ASSERT_GT(needed, 4u);
+  NU_ASSERT_LE(needed, sizeof(buffer));
+
+  /* Nothing written when the buffer is too small */
+  NU_ASSERT_EQ(buffer[0], 0xAA);
+
+  NU_ASSERT_EQ(nu_histogram_encode(&h, buffer, sizeof(buffer)), needed);
+  NU_ASSERT_EQ(buffer[0], 'N');
+
+  nu_histogram_free(&h);
+  return nu_ok(NULL);
+}
+
+NU_TEST(test_histogram_decode_malformed) {
+  nu_histogram h, copy;
+  NU_ASSERT(nu_histogram_init(&h, 1, 1000000, 3));
+  NU_ASSERT(nu_histogram_record(&h, 500));
+  NU_ASSERT(nu_histogram_record(&h, 900000));
+
+  uint8_t buffer[64];
+  size_t size = nu_histogram_encode(&h, buffer, sizeof(buffer));
+  NU_ASSERT_LE(size, sizeof(buffer));
+
+  /* Bad magic, truncation, NULL */
+  uint8_t bad[64];
+  memcpy(bad, buffer, size);
+  bad[0] = 'X';
+  NU_ASSERT(!nu_histogram_decode(&copy, bad, size));
+  NU_ASSERT(!nu_histogram_decode(&copy, buffer, 3));
+  NU_ASSERT(!nu_histogram_decode(&copy, buffer, 6));
+  NU_ASSERT(!nu_histogram_decode(&copy, NULL, size));
+
+  /* A dangling continuation byte */
+  memcpy(bad, buffer, size);
+  bad[size] = 0x80;
+  NU_ASSERT(!nu_histogram_decode(&copy, bad, size + 1));
+
+  /* A zero run past the end of the counts */
+  memcpy(bad, buffer, size);
+  bad[size]     = 0xFF;
+  bad[size + 1] = 0xFF;
+  bad[size + 2] = 0x7F;
+  NU_ASSERT(!nu_histogram_decode(&copy, bad, size + 3));
+
+  nu_histogram_free(&h);
+  return nu_ok(NULL);
+}
+
+NU_TEST(test_histogram_malloc_failure) {
+  nu_histogram h;
+
+  test_malloc_set_fail_after(0);
+  NU_ASSERT(!nu_histogram_init(&h, 1, 1000000, 3));
+  test_malloc_reset();
+
+  NU_ASSERT(nu_histogram_init(&h, 1, 1000000, 3));
+  uint8_t buffer[64];
+  size_t size = nu_histogram_encode(&h, buffer, sizeof(buffer));
+
+  nu_histogram copy;
+  test_malloc_set_fail_after(0);
+  NU_ASSERT(!nu_histogram_decode(&copy, buffer, size));
+  test_malloc_reset();
+
+  nu_histogram_free(&h);
+  return nu_ok(NULL);
+}
+
+NU_TEST_MAIN()
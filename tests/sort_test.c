@@ -21,6 +21,7 @@ extern void NU_FREE(void* ptr);
 
 /* Module under test */
 #include "../src/sort.h"
+#include "../src/datagen.h"
 
 /* Test utilities */
 static int
@@ -33,6 +34,48 @@ compare_ints (
   return (ia > ib) - (ia < ib);
 }
 
+/* Comparisons made through counting_compare_ints */
+static size_t comparisons;
+
+static int
+counting_compare_ints (
+  const void* a,
+  const void* b)
+{
+  comparisons++;
+  return compare_ints(a, b);
+}
+
+/* Comparisons nu_sort makes on n ints arranged by McIlroy's adversary,
+ * which drives quicksort towards its worst case */
+static double
+adversary_comparisons (size_t n)
+{
+  int64_t* keys  = NU_MALLOC(n * sizeof(int64_t));
+  int32_t* items = NU_MALLOC(n * sizeof(int32_t));
+  double count   = HUGE_VAL;
+  if (keys && items && nu_datagen_keys(keys, n, NU_DATAGEN_ANTIQSORT, sizeof(int32_t), 0)) {
+    nu_datagen_fill(items, keys, n, NU_DATAGEN_INT32);
+    comparisons = 0;
+    nu_sort(items, n, sizeof(int32_t), counting_compare_ints);
+    count = (double)comparisons;
+  }
+  NU_FREE(keys);
+  NU_FREE(items);
+  return count;
+}
+
+/* Sort n random ints; timed by NU_ASSERT_COMPLEXITY_NS */
+static int32_t timed_input[1 << 14];
+static int32_t timed_work[1 << 14];
+
+static void
+sort_random (size_t n)
+{
+  memcpy(timed_work, timed_input, n * sizeof(int32_t));
+  nu_sort(timed_work, n, sizeof(int32_t), compare_ints);
+}
+
 static int
 compare_strings (
   const void* a,
@@ -280,6 +323,23 @@ NU_TEST(test_depth_limit_protection) {
   NU_ASSERT_TRUE(is_sorted_int(arr, n));
 
   NU_FREE(arr);
+
+  // The depth limit keeps even the adversary's input O(n log n)
+  NU_ASSERT_COMPLEXITY(adversary_comparisons, NU_TEST_SIZES(1 << 10, 1 << 11, 1 << 12, 1 << 13), O_N_LOG_N);
+  return nu_ok(NULL);
+}
+
+NU_TEST(test_performance_contracts) {
+  uint64_t seed = 7;
+  for (size_t i = 0; i < 1 << 14; i++) {
+    seed           = seed * 6364136223846793005u + 1442695040888963407u;
+    timed_input[i] = (int32_t)(seed >> 33);
+  }
+
+  NU_ASSERT_COMPLEXITY_NS(sort_random, NU_TEST_SIZES(1 << 10, 1 << 12, 1 << 14), O_N_LOG_N);
+
+  // Generous enough for unoptimized and sanitizer builds
+  NU_ASSERT_MAX_NS(sort_random(1 << 14), 100e6);
   return nu_ok(NULL);
 }
 
@@ -310,49 +370,70 @@ NU_TEST(test_invalid_params_coverage) {
   return nu_ok(NULL);
 }
 
-// Test malloc failure in insertion_sort
+// Test every input distribution in every element type
+NU_TEST(test_datagen_matrix) {
+  static unsigned char elements[2000 * 256];
+  const size_t n = 2000;
+
+  for (int32_t d = 0; d < NU_DATAGEN_DIST_COUNT; d++) {
+    for (int32_t t = 0; t < NU_DATAGEN_TYPE_COUNT; t++) {
+      size_t size = nu_datagen_type_size((nu_datagen_type_t)t);
+      nu_datagen_compare_fn compare = nu_datagen_comparator((nu_datagen_type_t)t);
+      NU_ASSERT(nu_datagen_generate(elements, n, (nu_datagen_dist_t)d, (nu_datagen_type_t)t, 42));
+
+      nu_sort(elements, n, size, compare);
+      for (size_t i = 1; i < n; i++) {
+        NU_ASSERT_LE(compare(elements + (i - 1) * size, elements + i * size), 0);
+      }
+    }
+  }
+
+  return nu_ok(NULL);
+}
+
+// Test sorting while every allocation fails
 NU_TEST(test_malloc_failure) {
-#if !defined(__SANITIZE_ADDRESS__) && !defined(__has_feature)
-  // Only run this test when NOT using AddressSanitizer
-  // Create array that will trigger insertion_sort (needs < 16 elements)
   int arr[] = {15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1};
-  int original[15];
-  memcpy(original, arr, sizeof(arr));
 
-  // Configure allocator to fail on first malloc call
-  test_malloc_set_fail_after(0);
+  // Elements larger than insertion sort's key buffer are swapped instead
+  static struct {
+    int32_t key;
+    char payload[508];
+  } big[12];
+  for (int32_t i = 0; i < 12; i++) {
+    big[i].key = 12 - i;
+  }
 
-  // This should trigger insertion_sort which will fail at malloc
+  // nu_sort never allocates, so failing allocations cannot stop it
+  test_malloc_set_fail_after(0);
   nu_sort(arr, 15, sizeof(int), compare_ints);
-
-  // Reset allocator to normal
+  nu_sort(big, 12, sizeof(big[0]), compare_ints);
   test_malloc_reset();
 
-  // Array should be unchanged since insertion_sort returned early
-  NU_ASSERT_TRUE(arrays_equal_int(arr, original, 15));
-#elif defined(__has_feature)
-#if !__has_feature(address_sanitizer)
-  // Create array that will trigger insertion_sort (needs < 16 elements)
-  int arr[] = {15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1};
-  int original[15];
-  memcpy(original, arr, sizeof(arr));
-
-  // Configure allocator to fail on first malloc call
-  test_malloc_set_fail_after(0);
+  NU_ASSERT_TRUE(is_sorted_int(arr, 15));
+  for (int32_t i = 0; i < 12; i++) {
+    NU_ASSERT_EQ(big[i].key, i + 1);
+  }
 
-  // This should trigger insertion_sort which will fail at malloc
-  nu_sort(arr, 15, sizeof(int), compare_ints);
+  return nu_ok(NULL);
+}
 
-  // Reset allocator to normal
-  test_malloc_reset();
+#ifdef TEST_WRAP_MALLOC
+// Needs the wrapped system allocator: nu_sort does not use NU_MALLOC, so
+// only the wrappers would see it allocate
+NU_TEST(test_sort_allocates_nothing) {
+  static int32_t arr[1000000];
+  size_t n = sizeof(arr) / sizeof(arr[0]);
+  NU_ASSERT(nu_datagen_generate(arr, n, NU_DATAGEN_RANDOM, NU_DATAGEN_INT32, 42));
 
-  // Array should be unchanged since insertion_sort returned early
-  NU_ASSERT_TRUE(arrays_equal_int(arr, original, 15));
-#endif
-#endif
+  NU_ASSERT_NO_ALLOC {
+    nu_sort(arr, n, sizeof(int32_t), compare_ints);
+  }
+  NU_ASSERT_TRUE(is_sorted_int(arr, n));
 
   return nu_ok(NULL);
 }
+#endif
 
 // Main test runner
 NU_TEST_MAIN()
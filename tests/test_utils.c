@@ -1,4 +1,5 @@
 #include "test_utils.h"
+#include "../src/test.h"
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -7,6 +8,138 @@ static int32_t malloc_fail_after = -1;
 static int32_t malloc_call_count = 0;
 static bool malloc_enabled       = true;
 
+// Live allocations of the open scope, in an open-addressed table keyed by
+// address. Freed slots become tombstones so probe chains stay intact; the
+// table is cleared when the next scope begins.
+#define TEST_ALLOC_SLOTS (1u << 16)
+#define TEST_ALLOC_TOMBSTONE ((void*)&test_alloc)
+
+static struct {
+  bool active;
+  bool overflow;
+  size_t max_allocs;
+  size_t max_bytes;
+  size_t allocs;
+  size_t bytes;
+  size_t live;
+  size_t peak;
+  size_t used;
+  struct {
+    void* ptr;
+    size_t size;
+  } slots[TEST_ALLOC_SLOTS];
+} test_alloc;
+
+static size_t
+test_alloc_slot (void* ptr)
+{
+  return (size_t)(((uintptr_t)ptr >> 4) * UINT64_C(0x9E3779B97F4A7C15) >> 16) & (TEST_ALLOC_SLOTS - 1);
+}
+
+static void
+test_alloc_track (
+  void* ptr,
+  size_t size)
+{
+  test_alloc.allocs++;
+  test_alloc.bytes += size;
+  test_alloc.live  += size;
+  if (test_alloc.live > test_alloc.peak) {
+    test_alloc.peak = test_alloc.live;
+  }
+
+  // Keep a slot free so lookups of untracked pointers terminate
+  if (test_alloc.used >= TEST_ALLOC_SLOTS - 1) {
+    test_alloc.overflow = true;
+    return;
+  }
+  size_t i = test_alloc_slot(ptr);
+  while (test_alloc.slots[i].ptr && test_alloc.slots[i].ptr != TEST_ALLOC_TOMBSTONE) {
+    i = (i + 1) & (TEST_ALLOC_SLOTS - 1);
+  }
+  if (!test_alloc.slots[i].ptr) {
+    test_alloc.used++;
+  }
+  test_alloc.slots[i].ptr  = ptr;
+  test_alloc.slots[i].size = size;
+}
+
+static void
+test_alloc_untrack (void* ptr)
+{
+  // Memory allocated before the scope began is not tracked
+  for (size_t i = test_alloc_slot(ptr); test_alloc.slots[i].ptr; i = (i + 1) & (TEST_ALLOC_SLOTS - 1)) {
+    if (test_alloc.slots[i].ptr == ptr) {
+      test_alloc.live         -= test_alloc.slots[i].size;
+      test_alloc.slots[i].ptr  = TEST_ALLOC_TOMBSTONE;
+      return;
+    }
+  }
+}
+
+#ifdef TEST_WRAP_MALLOC
+// System allocator wrappers, for tests linked with
+// -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free. Scopes then
+// see every allocation made by the objects under test, not only those
+// through NU_MALLOC, so they can show that code never calls the allocator.
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+void* __wrap_malloc(size_t size);
+void* __wrap_calloc(size_t count, size_t size);
+void* __wrap_realloc(void* ptr, size_t size);
+void __wrap_free(void* ptr);
+
+void*
+__wrap_malloc (size_t size)
+{
+  void* ptr = __real_malloc(size);
+  if (ptr && test_alloc.active) {
+    test_alloc_track(ptr, size);
+  }
+  return ptr;
+}
+
+void*
+__wrap_calloc (
+  size_t count,
+  size_t size)
+{
+  void* ptr = __real_calloc(count, size);
+  if (ptr && test_alloc.active) {
+    test_alloc_track(ptr, count * size);
+  }
+  return ptr;
+}
+
+void*
+__wrap_realloc (
+  void* ptr,
+  size_t size)
+{
+  void* resized = __real_realloc(ptr, size);
+  if (test_alloc.active && (resized || size == 0)) {
+    if (ptr) {
+      test_alloc_untrack(ptr);
+    }
+    if (resized) {
+      test_alloc_track(resized, size);
+    }
+  }
+  return resized;
+}
+
+void
+__wrap_free (void* ptr)
+{
+  if (ptr && test_alloc.active) {
+    test_alloc_untrack(ptr);
+  }
+  __real_free(ptr);
+}
+#endif
+
 void*
 test_malloc (size_t size)
 {
@@ -22,7 +155,25 @@ test_malloc (size_t size)
     malloc_call_count++;
   }
 
-  return malloc(size);
+  // When malloc is wrapped the wrappers do the accounting
+  void* ptr = malloc(size);
+#ifndef TEST_WRAP_MALLOC
+  if (ptr && test_alloc.active) {
+    test_alloc_track(ptr, size);
+  }
+#endif
+  return ptr;
+}
+
+void
+test_free (void* ptr)
+{
+#ifndef TEST_WRAP_MALLOC
+  if (ptr && test_alloc.active) {
+    test_alloc_untrack(ptr);
+  }
+#endif
+  free(ptr);
 }
 
 void
@@ -38,4 +189,81 @@ test_malloc_reset (void)
   malloc_fail_after = -1;
   malloc_call_count = 0;
   malloc_enabled    = true;
+  // Close a scope left early by a failed assertion, break or return
+  test_alloc.active = false;
+}
+
+void
+test_alloc_begin (
+  size_t max_allocs,
+  size_t max_bytes)
+{
+  memset(test_alloc.slots, 0, sizeof(test_alloc.slots));
+  test_alloc.active     = true;
+  test_alloc.overflow   = false;
+  test_alloc.max_allocs = max_allocs;
+  test_alloc.max_bytes  = max_bytes;
+  test_alloc.allocs     = 0;
+  test_alloc.bytes      = 0;
+  test_alloc.live       = 0;
+  test_alloc.peak       = 0;
+  test_alloc.used       = 0;
+}
+
+bool
+test_alloc_end (
+  const char* file,
+  int32_t line)
+{
+  test_alloc.active = false;
+
+  if (test_alloc.allocs > test_alloc.max_allocs) {
+    if (test_alloc.max_allocs == 0) {
+      nu_test_failure(file, line, "Expected no allocations, got %zu (%zu bytes)",
+        test_alloc.allocs, test_alloc.bytes);
+    } else {
+      nu_test_failure(file, line, "Made %zu allocations, limit %zu",
+        test_alloc.allocs, test_alloc.max_allocs);
+    }
+    return false;
+  }
+  if (test_alloc.peak > test_alloc.max_bytes) {
+    nu_test_failure(file, line, "Peak of %zu live bytes, limit %zu",
+      test_alloc.peak, test_alloc.max_bytes);
+    return false;
+  }
+  if (test_alloc.overflow) {
+    nu_test_failure(file, line, "More than %u live allocations, cannot check for leaks",
+      TEST_ALLOC_SLOTS - 1);
+    return false;
+  }
+  size_t leaks = 0;
+  for (size_t i = 0; i < TEST_ALLOC_SLOTS; i++) {
+    if (test_alloc.slots[i].ptr && test_alloc.slots[i].ptr != TEST_ALLOC_TOMBSTONE) {
+      leaks++;
+    }
+  }
+  if (leaks > 0) {
+    nu_test_failure(file, line, "Leaked %zu bytes in %zu allocations", test_alloc.live, leaks);
+    return false;
+  }
+  return true;
+}
+
+size_t
+test_alloc_count (void)
+{
+  return test_alloc.allocs;
+}
+
+size_t
+test_alloc_bytes (void)
+{
+  return test_alloc.bytes;
+}
+
+size_t
+test_alloc_peak (void)
+{
+  return test_alloc.peak;
 }
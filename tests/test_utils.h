@@ -1,14 +1,52 @@
 #ifndef TEST_UTILS_H
 #define TEST_UTILS_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
 // Test malloc that can simulate failures
 void* test_malloc(size_t size);
 
+// Test free; frees through it are subtracted from the live bytes
+void test_free(void* ptr);
+
 // Control test malloc behavior
 void test_malloc_set_fail_after(int32_t count);
 void test_malloc_reset(void);
 
+// Allocation accounting: between begin and end, every test_malloc is
+// counted and its size tracked until test_free releases it (every malloc,
+// calloc and realloc when built with TEST_WRAP_MALLOC, see test_utils.c). End fails the
+// current test when the scope made more than max_allocs allocations, had
+// more than max_bytes live at once, or left anything allocated.
+void test_alloc_begin(size_t max_allocs, size_t max_bytes);
+bool test_alloc_end(const char* file, int32_t line);
+
+// Allocations, bytes and peak live bytes of the current or last scope
+size_t test_alloc_count(void);
+size_t test_alloc_bytes(void);
+size_t test_alloc_peak(void);
+
+// Run the following block as an allocation scope, returning the failure
+// from the enclosing test if it breaks its budget. Leaving the block with
+// break, return or a failed assertion skips the check and leaves the scope
+// open until test_malloc_reset or the next scope begins.
+#define TEST_ALLOC_SCOPE(max_allocs, max_bytes) \
+        for (int32_t _alloc_pass = (test_alloc_begin((max_allocs), (max_bytes)), 0); _alloc_pass < 2; _alloc_pass++) \
+          if (_alloc_pass == 1) { \
+            if (!test_alloc_end(__FILE__, __LINE__)) { \
+              return nu_err(&nu_test_last_error); \
+            } \
+          } else
+
+// The block allocates nothing
+#define NU_ASSERT_NO_ALLOC TEST_ALLOC_SCOPE(0, 0)
+
+// The block makes at most n allocations and frees them all
+#define NU_ASSERT_MAX_ALLOCS(n) TEST_ALLOC_SCOPE((size_t)(n), SIZE_MAX)
+
+// The block never has more than b bytes live and frees them all
+#define NU_ASSERT_MAX_BYTES(b) TEST_ALLOC_SCOPE(SIZE_MAX, (size_t)(b))
+
 #endif // TEST_UTILS_H